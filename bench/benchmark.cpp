@@ -0,0 +1,363 @@
+/**
+ *	@file benchmark.cpp
+ *	@brief Throughput benchmarks for %SithCodec.
+ *	@details Builds from the sources in src/, without main.cpp, with src/ on
+ *			 the include path, and corpus.cpp. Every case runs on a generated corpus in a
+ *			 scratch directory, so results only depend on the machine and the
+ *			 code under test. Caches are warm: each case is repeated and the
+ *			 median time is reported.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "codec.h"
+#include "corpus.h"
+#include "options.h"
+#include "results.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+
+/**
+ *	@brief Settings given on the command line.
+ */
+struct Settings {
+	fs::path directory;				///< scratch directory, empty for a temporary one
+	fs::path output;				///< results file, empty for cout
+	fs::path baseline;				///< results to compare against, or empty
+	double threshold = 10.0;		///< slowdown in percent reported as a regression
+	unsigned repeat = 3;
+	size_t maxFiles = 2000;			///< files per size distribution, at most
+	uintmax_t megabytes = 256;		///< bytes per size distribution, roughly
+	unsigned jobs = 0;
+	string filter;					///< only run cases whose name contains this
+	bool keep = false;				///< leave the scratch directory behind
+};
+
+/**
+ *	@brief Named distribution of file sizes in a corpus.
+ */
+struct Distribution {
+	const char* name;
+	SizeDistribution sizes;
+};
+
+/**
+ *	@brief Stream buffer that discards everything, for timing printFormats().
+ */
+class NullBuffer : public streambuf {
+protected:
+	int overflow(int ch) override { return ch; }
+	streamsize xsputn(const char*, streamsize count) override { return count; }
+};
+
+const Distribution distributions[]{
+	{ "small", { SizeDistribution::Kind::Fixed, 4 * 1024, 4 * 1024 } },
+	{ "medium", { SizeDistribution::Kind::Fixed, 256 * 1024, 256 * 1024 } },
+	{ "large", { SizeDistribution::Kind::Fixed, 8 * 1024 * 1024, 8 * 1024 * 1024 } },
+	{ "mixed", { SizeDistribution::Kind::LogUniform, 1024, 4 * 1024 * 1024 } },
+};
+
+const IoEngine engines[]{
+	IoEngine::Stream,
+	IoEngine::Block,
+	IoEngine::Mmap,
+	IoEngine::CopyFileRange,
+	IoEngine::Sendfile,
+	IoEngine::Uring,
+};
+
+/**
+ *	@brief Parses the command line.
+ *
+ *	@param args	    command line arguments
+ *	@param settings settings to fill in
+ *
+ *	@return false if an argument is not recognised
+ */
+bool parseSettings(const vector<string>& args, Settings& settings);
+
+/**
+ *	@brief Writes a corpus of KOTOR audio files.
+ *
+ *	@param directory	directory to create
+ *	@param distribution file sizes
+ *	@param settings		benchmark settings
+ *
+ *	@return total number of bytes written
+ */
+uintmax_t writeCorpus(const fs::path& directory, const Distribution& distribution, const Settings& settings);
+
+/**
+ *	@brief Times a case, repeating it and keeping the median.
+ *
+ *	@param name		name of case
+ *	@param files	number of files the case handles
+ *	@param bytes	number of bytes the case handles
+ *	@param settings benchmark settings
+ *	@param prepare	function run before every repetition, not timed
+ *	@param run		function to time, returning the number of errors
+ *	@param results	results to append to
+ */
+void measure(const string& name, size_t files, uintmax_t bytes, const Settings& settings,
+	const function<void()>& prepare, const function<size_t()>& run, vector<BenchmarkResult>& results);
+
+/**
+ *	@brief Counts the operations that ended in an error.
+ */
+size_t countErrors(const OperationTable& operations);
+
+int main(int argc, const char* argv[]) {
+	Settings settings;
+
+	if( !parseSettings(vector<string>(argv, argv + argc), settings) ) {
+		cerr
+			<< "Usage: benchmark [--dir=path] [--output=file.json] [--baseline=file.json]\n"
+			<< "                 [--threshold=percent] [--repeat=n] [--files=n]\n"
+			<< "                 [--megabytes=n] [--jobs=n] [--filter=text] [--keep]\n";
+		return 2;
+	}
+
+	const bool temporary = settings.directory.empty();
+	const auto root = temporary ? getTempPath() : settings.directory;
+	vector<BenchmarkResult> results;
+
+	try {
+		const auto selected = [&](const string& name) {
+			return name.find(settings.filter) != string::npos;
+		};
+
+		// formatOf() on a header already in memory, independent of storage
+		if( selected("formatOf/memory") ) {
+			const size_t count = 1000000;
+			vector<char> header(Header::sfx, Header::sfx + Header::sfxSize);
+
+			measure("formatOf/memory", count, count * header.size(), settings, [] {}, [&] {
+				size_t found = 0;
+
+				for( size_t i = 0; i < count; ++i ) {
+					header[0] ^= static_cast<char>(i & 1);	// keep the loop from being folded
+					found += formatOf(header.data(), header.size()) != AudioFormat::None;
+				}
+				return found == 0 ? size_t(1) : size_t(0);
+			}, results);
+		}
+
+		for( const auto& distribution : distributions ) {
+			const string prefix = distribution.name;
+			const auto input = root / prefix / "in";
+			const auto output = root / prefix / "out";
+
+			if( !any_of(begin(engines), end(engines), [&](IoEngine engine) {
+				return selected("encode/" + prefix + '/' + toString(engine)) || selected("decode/" + prefix + '/' + toString(engine));
+			}) && !selected("probe/" + prefix) && !selected("list/" + prefix) )
+				continue;
+
+			cerr << "Writing " << prefix << " corpus\n";
+
+			const auto bytes = writeCorpus(input, distribution, settings);
+			const auto paths = loadOperations(input);
+			const auto clear = [&] { remove_all(output); create_directories(output); };
+
+			if( selected("probe/" + prefix) ) {
+				const auto headerBytes = static_cast<uintmax_t>(Header::maxSize) * paths.size();
+
+				measure("probe/" + prefix, paths.size(), headerBytes, settings, [] {}, [&] {
+					size_t errors = 0;
+
+					for( size_t i = 0; i < paths.size(); ++i )
+						errors += !probeFormat(paths.path(i));
+					return errors;
+				}, results);
+			}
+
+			if( selected("list/" + prefix) ) {
+				measure("list/" + prefix, paths.size(), 0, settings, [] {}, [&] {
+					NullBuffer buffer;
+					ostream sink(&buffer);
+					ListOptions options;
+
+					options.jobs = settings.jobs;
+					printFormats(input, sink, options);
+					return size_t(0);
+				}, results);
+			}
+
+			for( const auto engine : engines ) {
+				BatchOptions options;
+
+				options.jobs = settings.jobs;
+				options.engine = engine;
+
+				const auto encodeName = "encode/" + prefix + '/' + toString(engine);
+				const auto decodeName = "decode/" + prefix + '/' + toString(engine);
+
+				if( selected(encodeName) )
+					measure(encodeName, paths.size(), bytes, settings, clear, [&] {
+						return countErrors(encodeAll(input, AudioFormat::SFX, output, options));
+					}, results);
+
+				if( selected(decodeName) )
+					measure(decodeName, paths.size(), bytes, settings, clear, [&] {
+						return countErrors(decodeAll(input, output, options));
+					}, results);
+			}
+
+			remove_all(root / prefix);
+		}
+	}
+	catch( const exception& ex ) {
+		cerr << ex.what() << '\n';
+		if( temporary && !settings.keep )
+			remove_all(root);
+		return 2;
+	}
+
+	if( temporary && !settings.keep )
+		remove_all(root);
+
+	if( settings.output.empty() ) {
+		writeResults(results, cout);
+	}
+	else {
+		ofstream file(settings.output);
+
+		if( !file ) {
+			cerr << writeErrorMsg(settings.output) << '\n';
+			return 2;
+		}
+		writeResults(results, file);
+	}
+
+	if( !settings.baseline.empty() && compareResults(results, readBaseline(settings.baseline), settings.threshold, cerr) > 0 )
+		return 1;
+
+	return 0;
+}
+
+bool parseSettings(const vector<string>& args, Settings& settings) {
+	for( size_t i = 1; i < args.size(); ++i ) {
+		const auto& arg = args[i];
+		const auto equals = arg.find('=');
+		const auto name = arg.substr(0, equals);
+		const auto value = equals == string::npos ? string() : arg.substr(equals + 1);
+
+		try {
+			if( name == "--keep" && equals == string::npos )
+				settings.keep = true;
+			else if( value.empty() )
+				return false;
+			else if( name == "--dir" )
+				settings.directory = value;
+			else if( name == "--output" )
+				settings.output = value;
+			else if( name == "--baseline" )
+				settings.baseline = value;
+			else if( name == "--threshold" ) {
+				size_t end = 0;
+
+				settings.threshold = stod(value, &end);
+				if( end != value.size() || !(settings.threshold >= 0) )
+					return false;
+			}
+			else if( name == "--repeat" )
+				settings.repeat = max(1U, parseCount<unsigned>(value));
+			else if( name == "--files" )
+				settings.maxFiles = max<size_t>(1, parseCount<size_t>(value));
+			else if( name == "--megabytes" )
+				settings.megabytes = max<uintmax_t>(1, parseCount<uintmax_t>(value));
+			else if( name == "--jobs" )
+				settings.jobs = parseCount<unsigned>(value);
+			else if( name == "--filter" )
+				settings.filter = value;
+			else
+				return false;
+		}
+		catch( const exception& ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+uintmax_t writeCorpus(const fs::path& directory, const Distribution& distribution, const Settings& settings) {
+	CorpusSpec spec;
+
+	// Fixed seed, so every run and every machine benchmarks the same files
+	spec.seed = 0x5174c0dec;
+	spec.sizes = distribution.sizes;
+	spec.files = min(settings.maxFiles, max<size_t>(1, static_cast<size_t>(settings.megabytes * 1e6 / distribution.sizes.mean())));
+	// 64 files per directory, like the game's stream folders
+	spec.depth = 1;
+	spec.fanOut = static_cast<unsigned>((spec.files + 63) / 64);
+	spec.jobs = settings.jobs;
+
+	remove_all(directory);
+
+	return generateCorpus(directory, spec).bytes;
+}
+
+void measure(const string& name, size_t files, uintmax_t bytes, const Settings& settings,
+	const function<void()>& prepare, const function<size_t()>& run, vector<BenchmarkResult>& results) {
+	vector<double> times;
+	BenchmarkResult result;
+
+	result.name = name;
+	result.files = files;
+	result.bytes = bytes;
+
+	for( unsigned i = 0; i < settings.repeat; ++i ) {
+		prepare();
+
+		const auto start = chrono::steady_clock::now();
+
+		result.errors = max(result.errors, run());
+		times.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+	}
+
+	sort(times.begin(), times.end());
+	result.seconds = times[times.size() / 2];
+	results.push_back(result);
+
+	cerr << left << setw(36) << name << right << fixed << setprecision(1)
+		<< setw(10) << result.megabytesPerSecond() << " MB/s"
+		<< setw(12) << result.filesPerSecond() << " files/s";
+	if( result.errors )
+		cerr << "  " << result.errors << " errors";
+	cerr << '\n';
+}
+
+size_t countErrors(const OperationTable& operations) {
+	return operations.count(FileStatus::Failed);
+}
@@ -0,0 +1,315 @@
+/**
+ *	@file corpus.cpp
+ *	@brief Generator of synthetic KOTOR audio trees for benchmarks and
+ *		   scale tests.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "corpus.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "codec.h"
+
+namespace SithCodec {
+	namespace fs = std::filesystem;
+	using namespace std;
+
+	namespace {
+		/**
+		 *	@brief Number of files one task writes.
+		 */
+		constexpr size_t corpusChunkSize = 256;
+
+		/**
+		 *	@brief SplitMix64 generator: small, fast, and good enough for
+		 *		   synthetic payloads.
+		 */
+		class Random {
+		public:
+			explicit Random(uint64_t seed) : state(seed) {}
+
+			uint64_t next() {
+				uint64_t z = (state += 0x9e3779b97f4a7c15);
+
+				z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+				z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+				return z ^ (z >> 31);
+			}
+
+			/**
+			 *	@brief Draws a number uniformly distributed in [0, 1).
+			 */
+			double unit() {
+				return static_cast<double>(next() >> 11) * 0x1.0p-53;
+			}
+
+		private:
+			uint64_t state;
+		};
+
+		optional<uintmax_t> parseSize(string_view str) {
+			uintmax_t multiplier = 1;
+
+			if( !str.empty() ) {
+				switch( str.back() ) {
+				case 'k': case 'K': multiplier = 1024; break;
+				case 'm': case 'M': multiplier = 1024 * 1024; break;
+				case 'g': case 'G': multiplier = 1024 * 1024 * 1024; break;
+				}
+				if( multiplier != 1 )
+					str.remove_suffix(1);
+			}
+
+			if( str.empty() || str.find_first_not_of("0123456789") != string_view::npos || str.size() > 12 )
+				return nullopt;
+
+			return stoull(string(str)) * multiplier;
+		}
+
+		/**
+		 *	@brief Formats a number with leading zeros.
+		 */
+		string padded(const char* prefix, size_t value, size_t width) {
+			auto digits = to_string(value);
+
+			if( digits.size() < width )
+				digits.insert(0, width - digits.size(), '0');
+			return prefix + digits;
+		}
+
+		size_t digitsOf(size_t value) {
+			return to_string(value).size();
+		}
+
+		/**
+		 *	@brief Raises a number to a power, saturating instead of overflowing.
+		 */
+		size_t power(size_t base, unsigned exponent) {
+			size_t result = 1;
+
+			for( unsigned i = 0; i < exponent; ++i ) {
+				if( base != 0 && result > SIZE_MAX / base )
+					return SIZE_MAX;
+				result *= base;
+			}
+
+			return result;
+		}
+	}
+
+	optional<SizeDistribution> SizeDistribution::parse(string_view str) {
+		const auto colon = str.find(':');
+
+		if( colon == string_view::npos )
+			return nullopt;
+
+		const auto kind = str.substr(0, colon);
+		const auto range = str.substr(colon + 1);
+		SizeDistribution distribution;
+
+		if( kind == "fixed" ) {
+			const auto size = parseSize(range);
+
+			if( !size )
+				return nullopt;
+			distribution.kind = Kind::Fixed;
+			distribution.min = distribution.max = size.value();
+			return distribution;
+		}
+
+		const auto dash = range.find('-');
+
+		if( dash == string_view::npos )
+			return nullopt;
+
+		const auto min = parseSize(range.substr(0, dash));
+		const auto max = parseSize(range.substr(dash + 1));
+
+		if( !min || !max || min.value() > max.value() )
+			return nullopt;
+
+		if( kind == "uniform" )
+			distribution.kind = Kind::Uniform;
+		else if( kind == "loguniform" && min.value() > 0 )
+			distribution.kind = Kind::LogUniform;
+		else
+			return nullopt;
+
+		distribution.min = min.value();
+		distribution.max = max.value();
+		return distribution;
+	}
+
+	uintmax_t SizeDistribution::sample(double unit) const {
+		const auto low = static_cast<double>(min), high = static_cast<double>(max);
+
+		switch( kind ) {
+		case Kind::Uniform:
+			return min + static_cast<uintmax_t>(unit * (high - low + 1));
+		case Kind::LogUniform:
+			// exp(log(x)) can come out just below x, so both ends are clamped
+			return clamp(static_cast<uintmax_t>(exp(log(low) + unit * (log(high + 1) - log(low)))), min, max);
+		default:
+			return min;
+		}
+	}
+
+	double SizeDistribution::mean() const {
+		const auto low = static_cast<double>(min), high = static_cast<double>(max);
+
+		if( kind == Kind::Fixed || min == max )
+			return low;
+		if( kind == Kind::Uniform )
+			return (low + high) / 2;
+		return (high - low) / (log(high) - log(low));
+	}
+
+	CorpusStats generateCorpus(const fs::path& root, const CorpusSpec& spec) {
+		const auto fanOut = max(1U, spec.fanOut);
+		const auto leaves = power(fanOut, spec.depth);
+		const auto perLeaf = max<size_t>(1, (spec.files + leaves - 1) / max<size_t>(1, leaves));
+		const auto directoryWidth = max<size_t>(2, digitsOf(fanOut - 1));
+		const auto fileWidth = max<size_t>(7, digitsOf(spec.files ? spec.files - 1 : 0));
+		const auto chunks = (spec.files + corpusChunkSize - 1) / corpusChunkSize;
+		CorpusStats stats;
+		mutex statsMutex;
+		exception_ptr error;
+
+		create_directories(root);
+
+		const auto leafPath = [&](size_t leaf) {
+			auto path = root;
+
+			for( unsigned level = spec.depth; level > 0; --level )
+				path /= padded("d", leaf / power(fanOut, level - 1) % fanOut, directoryWidth);
+			return path;
+		};
+
+		parallelFor(chunks, spec.jobs, [&](size_t chunk) {
+			CorpusStats local;
+			vector<char> buffer;
+			fs::path directory;
+			size_t currentLeaf = SIZE_MAX;
+
+			try {
+				for( size_t i = chunk * corpusChunkSize; i < min(spec.files, (chunk + 1) * corpusChunkSize); ++i ) {
+					// Everything about a file comes from the seed and its index
+					Random random(spec.seed ^ Random(i).next());
+					const auto leaf = i / perLeaf;
+
+					if( leaf != currentLeaf ) {
+						error_code ignored;
+
+						currentLeaf = leaf;
+						directory = leafPath(leaf);
+						create_directories(directory, ignored);
+					}
+
+					const double roll = random.unit();
+					const bool headerless = roll < spec.headerlessFraction;
+					const bool truncated = !headerless && roll < spec.headerlessFraction + spec.truncatedFraction;
+					const bool sfx = random.unit() < spec.sfxFraction;
+					const char* header = sfx ? Header::sfx : Header::vo;
+					const auto headerSize = static_cast<size_t>(sfx ? Header::sfxSize : Header::voSize);
+					auto payload = spec.sizes.sample(random.unit());
+					size_t prefix = headerless ? 0 : headerSize;
+
+					if( truncated ) {
+						prefix = 1 + static_cast<size_t>(random.unit() * (headerSize - 1));
+						payload = 0;
+					}
+
+					const auto path = directory / padded("f", i, fileWidth).append(wav);
+					ofstream file(path, ios::binary | ios::trunc);
+
+					file.write(header, static_cast<streamsize>(prefix));
+
+					for( uintmax_t written = 0; written < payload; ) {
+						const auto size = static_cast<size_t>(min<uintmax_t>(blockSize, payload - written));
+
+						buffer.resize(size);
+						for( size_t j = 0; j < size; j += sizeof(uint64_t) ) {
+							const auto word = random.next();
+
+							memcpy(buffer.data() + j, &word, min(sizeof(word), size - j));
+						}
+						file.write(buffer.data(), static_cast<streamsize>(size));
+						written += size;
+					}
+
+					file.close();
+					if( !file )
+						throw runtime_error(writeErrorMsg(path));
+
+					++local.files;
+					local.bytes += prefix + payload;
+					if( headerless )
+						++local.headerless;
+					else if( truncated )
+						++local.truncated;
+					else if( sfx )
+						++local.sfx;
+					else
+						++local.vo;
+				}
+			}
+			catch( ... ) {
+				lock_guard lock(statsMutex);
+
+				if( !error )
+					error = current_exception();
+			}
+
+			lock_guard lock(statsMutex);
+
+			stats.files += local.files;
+			stats.bytes += local.bytes;
+			stats.sfx += local.sfx;
+			stats.vo += local.vo;
+			stats.headerless += local.headerless;
+			stats.truncated += local.truncated;
+		});
+
+		if( error )
+			rethrow_exception(error);
+
+		// Every level holds as many directories as it takes to reach the leaves in use
+		const auto usedLeaves = (spec.files + perLeaf - 1) / perLeaf;
+
+		for( unsigned level = 1; level <= spec.depth; ++level ) {
+			const auto span = power(fanOut, spec.depth - level);
+
+			stats.directories += (usedLeaves + span - 1) / span;
+		}
+
+		return stats;
+	}
+}
@@ -0,0 +1,138 @@
+/**
+ *	@file corpus.h
+ *	@brief Generator of synthetic KOTOR audio trees for benchmarks and
+ *		   scale tests.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_CORPUS_H
+#define SITHCODEC_CORPUS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+namespace SithCodec {
+	/**
+	 *	@brief Distribution of payload sizes.
+	 */
+	struct SizeDistribution {
+		enum class Kind {
+			Fixed,		///< always min
+			Uniform,	///< uniform between min and max
+			LogUniform,	///< uniform in log space, so small files dominate
+		};
+
+		Kind kind = Kind::Fixed;
+		std::uintmax_t min = 64 * 1024;
+		std::uintmax_t max = 64 * 1024;
+
+		/**
+		 *	@brief Parses "fixed:SIZE", "uniform:MIN-MAX" or "loguniform:MIN-MAX",
+		 *		   where sizes take an optional k, m or g suffix.
+		 *
+		 *	@param str description
+		 *
+		 *	@return distribution, or nothing if str is malformed
+		 */
+		static std::optional<SizeDistribution> parse(std::string_view str);
+
+		/**
+		 *	@brief Draws a size.
+		 *
+		 *	@param unit number uniformly distributed in [0, 1)
+		 *
+		 *	@return size in bytes
+		 */
+		std::uintmax_t sample(double unit) const;
+
+		/**
+		 *	@brief Gets the expected size.
+		 *
+		 *	@return mean size in bytes
+		 */
+		double mean() const;
+	};
+
+	/**
+	 *	@brief Shape and contents of a generated tree.
+	 */
+	struct CorpusSpec {
+		std::size_t files = 1000;
+		SizeDistribution sizes;
+
+		/**
+		 *	@brief Number of directory levels above the files; 0 puts every
+		 *		   file in the root.
+		 */
+		unsigned depth = 2;
+
+		/**
+		 *	@brief Number of subdirectories of each directory.
+		 */
+		unsigned fanOut = 16;
+
+		double sfxFraction = 0.5;			///< share of headed files that are SFX rather than VO
+		double headerlessFraction = 0.0;	///< share of files with no KOTOR header
+		double truncatedFraction = 0.0;		///< share of files cut off inside the header
+		std::uint64_t seed = 1;
+
+		/**
+		 *	@brief Number of threads writing files, or 0 for defaultWorkerCount().
+		 */
+		unsigned jobs = 0;
+	};
+
+	/**
+	 *	@brief What a generated tree contains.
+	 */
+	struct CorpusStats {
+		std::size_t files = 0;
+		std::size_t directories = 0;
+		std::uintmax_t bytes = 0;
+		std::size_t sfx = 0;
+		std::size_t vo = 0;
+		std::size_t headerless = 0;
+		std::size_t truncated = 0;
+	};
+
+	/**
+	 *	@brief Writes a tree of SFX and VO files with synthetic payloads.
+	 *	@details Every file is derived from the seed and its index alone, so
+	 *			 the same spec gives byte-identical trees regardless of the
+	 *			 number of threads. Files are spread evenly over the leaf
+	 *			 directories, which are named d00, d01, ... at each level, and
+	 *			 are named f0000000.wav, f0000001.wav, ... in index order.
+	 *
+	 *	@param root directory to write into; existing files are overwritten
+	 *	@param spec shape and contents of the tree
+	 *
+	 *	@return what was written
+	 *
+	 *	@throws runtime_error
+	 */
+	CorpusStats generateCorpus(const std::filesystem::path& root, const CorpusSpec& spec);
+}
+
+#endif
@@ -0,0 +1,171 @@
+/**
+ *	@file gencorpus.cpp
+ *	@brief Command-line tool writing synthetic KOTOR audio trees.
+ *	@details Builds from corpus.cpp and the sources in src/, without
+ *			 main.cpp, with src/ on the include path.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "codec.h"
+#include "corpus.h"
+#include "options.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+
+/**
+ *	@brief Parses the command line.
+ *
+ *	@param args	  command line arguments
+ *	@param root	  directory to write
+ *	@param spec	  spec to fill in
+ *
+ *	@return false if an argument is not recognised or no directory is given
+ */
+bool parseSpec(const vector<string>& args, fs::path& root, CorpusSpec& spec);
+
+/**
+ *	@brief Parses a fraction between 0 and 1.
+ */
+bool parseFraction(const string& str, double& value);
+
+int main(int argc, const char* argv[]) {
+	fs::path root;
+	CorpusSpec spec;
+
+	if( !parseSpec(vector<string>(argv, argv + argc), root, spec) ) {
+		cerr
+			<< "Usage: gencorpus [options] directory\n"
+			<< "  --files=n             number of files (1000)\n"
+			<< "  --sizes=distribution  payload sizes: fixed:SIZE, uniform:MIN-MAX or\n"
+			<< "                        loguniform:MIN-MAX, with k, m or g suffixes (fixed:64k)\n"
+			<< "  --depth=n             directory levels above the files (2)\n"
+			<< "  --fan-out=n           subdirectories per directory (16)\n"
+			<< "  --sfx=fraction        share of headed files in SFX format (0.5)\n"
+			<< "  --headerless=fraction share of files without a header (0)\n"
+			<< "  --truncated=fraction  share of files cut off inside the header (0)\n"
+			<< "  --seed=n              seed (1)\n"
+			<< "  --jobs=n              writer threads (number of CPUs)\n";
+		return 2;
+	}
+
+	try {
+		const auto start = chrono::steady_clock::now();
+		const auto stats = generateCorpus(root, spec);
+		const auto seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		cout
+			<< root.string() << '\n'
+			<< indentLevel1 << stats.files << " files in " << stats.directories << " directories, "
+			<< stats.bytes << " bytes\n"
+			<< indentLevel1 << stats.sfx << " SFX, " << stats.vo << " VO, "
+			<< stats.headerless << " header-less, " << stats.truncated << " truncated\n"
+			<< indentLevel1 << seconds << " s\n";
+	}
+	catch( const exception& ex ) {
+		cerr << ex.what() << '\n';
+		return 1;
+	}
+
+	return 0;
+}
+
+bool parseSpec(const vector<string>& args, fs::path& root, CorpusSpec& spec) {
+	for( size_t i = 1; i < args.size(); ++i ) {
+		const auto& arg = args[i];
+
+		if( arg.find("--") != 0 ) {
+			if( !root.empty() )
+				return false;
+			root = arg;
+			continue;
+		}
+
+		const auto equals = arg.find('=');
+
+		if( equals == string::npos || equals + 1 == arg.size() )
+			return false;
+
+		const auto name = arg.substr(0, equals);
+		const auto value = arg.substr(equals + 1);
+
+		try {
+			if( name == "--files" ) {
+				spec.files = parseCount<size_t>(value);
+			}
+			else if( name == "--sizes" ) {
+				const auto sizes = SizeDistribution::parse(value);
+
+				if( !sizes )
+					return false;
+				spec.sizes = sizes.value();
+			}
+			else if( name == "--depth" ) {
+				spec.depth = parseCount<unsigned>(value);
+			}
+			else if( name == "--fan-out" ) {
+				spec.fanOut = parseCount<unsigned>(value);
+				if( spec.fanOut == 0 )
+					return false;
+			}
+			else if( name == "--sfx" ) {
+				if( !parseFraction(value, spec.sfxFraction) )
+					return false;
+			}
+			else if( name == "--headerless" ) {
+				if( !parseFraction(value, spec.headerlessFraction) )
+					return false;
+			}
+			else if( name == "--truncated" ) {
+				if( !parseFraction(value, spec.truncatedFraction) )
+					return false;
+			}
+			else if( name == "--seed" ) {
+				spec.seed = parseCount<uint64_t>(value);
+			}
+			else if( name == "--jobs" ) {
+				spec.jobs = parseCount<unsigned>(value);
+			}
+			else {
+				return false;
+			}
+		}
+		catch( const exception& ) {
+			return false;
+		}
+	}
+
+	return !root.empty() && spec.headerlessFraction + spec.truncatedFraction <= 1;
+}
+
+bool parseFraction(const string& str, double& value) {
+	size_t end = 0;
+
+	value = stod(str, &end);
+	return end == str.size() && value >= 0 && value <= 1;
+}
@@ -0,0 +1,364 @@
+/**
+ *	@file metabench.cpp
+ *	@brief Benchmark of the metadata paths: enumeration and listing of very
+ *		   large trees.
+ *	@details Builds from corpus.cpp and the sources in src/, without
+ *			 main.cpp, with src/ on the include path. Times
+ *			 loadOperationsFromFolder(), loadOperationsFromFile() and
+ *			 printFormats() on a tree of small files, with warm and with cold
+ *			 caches, and counts the system calls each one makes.
+ *
+ *			 Cold runs drop every file's cached pages with
+ *			 posix_fadvise(POSIX_FADV_DONTNEED). Directory entries and inodes
+ *			 stay cached unless the process may write /proc/sys/vm/drop_caches,
+ *			 which the results report. System calls are counted in a separate,
+ *			 untimed run of each case in a child process traced with ptrace.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "codec.h"
+#include "corpus.h"
+#include "options.h"
+#include "syscalls.h"
+
+#ifdef SITHCODEC_POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+
+/**
+ *	@brief Settings given on the command line.
+ */
+struct Settings {
+	fs::path directory;				///< tree to use, generated if missing
+	fs::path output;				///< results file, empty for cout
+	size_t files = 1000000;			///< files in a generated tree
+	unsigned depth = 3;				///< directory levels in a generated tree
+	unsigned fanOut = 16;			///< subdirectories per directory in a generated tree
+	unsigned repeat = 3;
+	unsigned jobs = 0;
+	bool cold = true;				///< also run with cold caches
+	bool countSyscalls = true;
+};
+
+/**
+ *	@brief Measurement of one benchmark case.
+ */
+struct Result {
+	string name;
+	const char* cache;
+	size_t files = 0;
+	double seconds = 0;
+	optional<uint64_t> syscalls;	///< nothing if they could not be counted
+};
+
+/**
+ *	@brief Stream buffer that discards everything, for timing printFormats().
+ */
+class NullBuffer : public streambuf {
+protected:
+	int overflow(int ch) override { return ch; }
+	streamsize xsputn(const char*, streamsize count) override { return count; }
+};
+
+/**
+ *	@brief Parses the command line.
+ *
+ *	@param args	    command line arguments
+ *	@param settings settings to fill in
+ *
+ *	@return false if an argument is not recognised or no directory is given
+ */
+bool parseSettings(const vector<string>& args, Settings& settings);
+
+/**
+ *	@brief Evicts a tree and a list file from the page cache.
+ *
+ *	@param paths files in the tree
+ *	@param list	 list file
+ *
+ *	@return true if directory entries and inodes were dropped as well
+ */
+bool dropCaches(const OperationTable& paths, const fs::path& list);
+
+/**
+ *	@brief Writes results as JSON, one case per line in a fixed order.
+ *
+ *	@param results		 results
+ *	@param metadataDropped whether cold runs dropped cached metadata too
+ *	@param output		 output stream
+ */
+void writeResults(const vector<Result>& results, bool metadataDropped, ostream& output);
+
+int main(int argc, const char* argv[]) {
+	Settings settings;
+
+	if( !parseSettings(vector<string>(argv, argv + argc), settings) ) {
+		cerr
+			<< "Usage: metabench [options] directory\n"
+			<< "  --files=n      files in a generated tree (1000000)\n"
+			<< "  --depth=n      directory levels in a generated tree (3)\n"
+			<< "  --fan-out=n    subdirectories per directory in a generated tree (16)\n"
+			<< "  --repeat=n     timed runs per case (3)\n"
+			<< "  --jobs=n       threads for listing, 0 for the default (0)\n"
+			<< "  --output=file  results file (standard output)\n"
+			<< "  --warm-only    skip cold-cache runs\n"
+			<< "  --no-syscalls  skip counting system calls\n"
+			<< "The tree is generated if the directory does not exist.\n";
+		return 2;
+	}
+
+	const auto& root = settings.directory;
+	const auto list = fs::path(root).concat(".list");
+	vector<Result> results;
+	bool metadataDropped = false;
+
+	try {
+		if( !exists(root) ) {
+			CorpusSpec spec;
+
+			spec.files = settings.files;
+			spec.sizes = { SizeDistribution::Kind::Fixed, 0, 0 };	// headers only
+			spec.depth = settings.depth;
+			spec.fanOut = settings.fanOut;
+			cerr << "Writing " << spec.files << " files to " << root.string() << '\n';
+			generateCorpus(root, spec);
+		}
+
+		const auto paths = loadOperationsFromFolder(root);
+
+		{
+			ofstream file(list);
+
+			for( size_t i = 0; i < paths.size(); ++i )
+				file << paths.path(i).string() << '\n';
+			if( !file )
+				throw runtime_error(writeErrorMsg(list));
+		}
+
+		ListOptions listOptions;
+
+		listOptions.jobs = settings.jobs;
+
+		const pair<string, function<size_t()>> cases[]{
+			{ "loadOperationsFromFolder", [&] { return loadOperationsFromFolder(root).size(); } },
+			{ "loadOperationsFromFile", [&] { return loadOperationsFromFile(list).size(); } },
+			{ "printFormats", [&] {
+				NullBuffer buffer;
+				ostream sink(&buffer);
+
+				printFormats(root, sink, listOptions);
+				return paths.size();
+			} },
+		};
+
+		for( const auto& [name, run] : cases ) {
+			for( const bool cold : { false, true } ) {
+				if( cold && !settings.cold )
+					continue;
+
+				Result result;
+				vector<double> times;
+
+				result.name = name;
+				result.cache = cold ? "cold" : "warm";
+
+				// One untimed run fills the caches for warm runs
+				if( !cold )
+					run();
+
+				for( unsigned i = 0; i < settings.repeat; ++i ) {
+					if( cold )
+						metadataDropped = dropCaches(paths, list);
+
+					const auto start = chrono::steady_clock::now();
+
+					result.files = run();
+					times.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+				}
+
+				sort(times.begin(), times.end());
+				result.seconds = times[times.size() / 2];
+
+				if( settings.countSyscalls ) {
+					if( cold )
+						dropCaches(paths, list);
+					result.syscalls = countSyscalls([&] { run(); });
+				}
+
+				cerr << left << setw(26) << name << ' ' << result.cache << right << fixed << setprecision(3)
+					<< setw(10) << result.seconds << " s" << setprecision(1)
+					<< setw(12) << (result.seconds > 0 ? result.files / result.seconds : 0) << " files/s";
+				if( result.syscalls && result.files )
+					cerr << setprecision(2) << setw(10) << double(result.syscalls.value()) / result.files << " syscalls/file";
+				cerr << '\n';
+
+				results.push_back(result);
+			}
+		}
+	}
+	catch( const exception& ex ) {
+		cerr << ex.what() << '\n';
+		return 1;
+	}
+
+	if( settings.output.empty() ) {
+		writeResults(results, metadataDropped, cout);
+	}
+	else {
+		ofstream file(settings.output);
+
+		if( !file ) {
+			cerr << writeErrorMsg(settings.output) << '\n';
+			return 1;
+		}
+		writeResults(results, metadataDropped, file);
+	}
+
+	return 0;
+}
+
+bool parseSettings(const vector<string>& args, Settings& settings) {
+	for( size_t i = 1; i < args.size(); ++i ) {
+		const auto& arg = args[i];
+
+		if( arg.find("--") != 0 ) {
+			if( !settings.directory.empty() )
+				return false;
+			settings.directory = arg;
+			continue;
+		}
+
+		if( arg == "--warm-only" ) {
+			settings.cold = false;
+			continue;
+		}
+		if( arg == "--no-syscalls" ) {
+			settings.countSyscalls = false;
+			continue;
+		}
+
+		const auto equals = arg.find('=');
+
+		if( equals == string::npos || equals + 1 == arg.size() )
+			return false;
+
+		const auto name = arg.substr(0, equals);
+		const auto value = arg.substr(equals + 1);
+
+		try {
+			if( name == "--files" )
+				settings.files = parseCount<size_t>(value);
+			else if( name == "--depth" )
+				settings.depth = parseCount<unsigned>(value);
+			else if( name == "--fan-out" )
+				settings.fanOut = max(1U, parseCount<unsigned>(value));
+			else if( name == "--repeat" )
+				settings.repeat = max(1U, parseCount<unsigned>(value));
+			else if( name == "--jobs" )
+				settings.jobs = parseCount<unsigned>(value);
+			else if( name == "--output" )
+				settings.output = value;
+			else
+				return false;
+		}
+		catch( const exception& ) {
+			return false;
+		}
+	}
+
+	return !settings.directory.empty();
+}
+
+bool dropCaches(const OperationTable& paths, const fs::path& list) {
+#ifdef SITHCODEC_POSIX
+	const auto evict = [](const fs::path& path) {
+		const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+		if( fd < 0 )
+			return;
+#ifdef POSIX_FADV_DONTNEED
+		::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+		::close(fd);
+	};
+
+	for( size_t i = 0; i < paths.size(); ++i )
+		evict(paths.path(i));
+	evict(list);
+
+	// Only root may drop dentries and inodes; "2" leaves the page cache alone
+	ofstream dropper("/proc/sys/vm/drop_caches");
+
+	if( !dropper )
+		return false;
+
+	::sync();
+	dropper << "2\n";
+	dropper.close();
+	return static_cast<bool>(dropper);
+#else
+	(void)paths;
+	(void)list;
+	return false;
+#endif
+}
+
+void writeResults(const vector<Result>& results, bool metadataDropped, ostream& output) {
+	output
+		<< "{\n  \"schema\": 1,\n"
+		<< "  \"cold_drops_metadata\": " << (metadataDropped ? "true" : "false") << ",\n"
+		<< "  \"results\": [\n";
+
+	for( size_t i = 0; i < results.size(); ++i ) {
+		const auto& result = results[i];
+
+		output
+			<< "    {\"name\": \"" << result.name << "\", \"cache\": \"" << result.cache << '"'
+			<< ", \"files\": " << result.files
+			<< fixed << setprecision(6) << ", \"seconds\": " << result.seconds
+			<< setprecision(3) << ", \"files_per_s\": " << (result.seconds > 0 ? result.files / result.seconds : 0)
+			<< ", \"syscalls\": ";
+		if( result.syscalls )
+			output << result.syscalls.value() << ", \"syscalls_per_file\": "
+				<< (result.files ? double(result.syscalls.value()) / result.files : 0);
+		else
+			output << "null, \"syscalls_per_file\": null";
+		output << '}' << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+
+	output << "  ]\n}\n";
+}
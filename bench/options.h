@@ -0,0 +1,66 @@
+/**
+ *	@file options.h
+ *	@brief Parsing of the numeric command-line options of the benchmark
+ *		   programs.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_OPTIONS_H
+#define SITHCODEC_OPTIONS_H
+
+#include <charconv>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+namespace SithCodec {
+	/**
+	 *	@brief Parses a count given on the command line.
+	 *	@details Unlike stoul(), which skips white space, takes a sign and
+	 *			 stops at the first stray character, only a whole decimal
+	 *			 number in the range of T is accepted, so "-1" is refused
+	 *			 rather than read as the largest count.
+	 *
+	 *	@param str text of the option value
+	 *
+	 *	@return count
+	 *
+	 *	@throws invalid_argument if str is not a decimal number
+	 *	@throws out_of_range if the number does not fit in T
+	 */
+	template<typename T>
+	T parseCount(std::string_view str) {
+		static_assert(std::is_unsigned_v<T>, "counts are unsigned");
+
+		T value = 0;
+		const auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), value);
+
+		if( error == std::errc::result_out_of_range )
+			throw std::out_of_range("count out of range");
+		if( error != std::errc() || str.empty() || end != str.data() + str.size() )
+			throw std::invalid_argument("not a count");
+		return value;
+	}
+}
+
+#endif
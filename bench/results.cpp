@@ -0,0 +1,136 @@
+/**
+ *	@file results.cpp
+ *	@brief Results of the throughput benchmark, written as JSON and
+ *		   compared against a baseline.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "results.h"
+
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include "codec.h"
+
+namespace SithCodec {
+	namespace fs = std::filesystem;
+	using namespace std;
+
+	namespace {
+		/**
+		 *	@brief Version of the JSON layout, bumped when fields change meaning.
+		 */
+		constexpr int schemaVersion = 1;
+	}
+
+	void writeResults(const vector<BenchmarkResult>& results, ostream& output) {
+		const auto flags = output.flags();
+		const auto precision = output.precision();
+
+		output << "{\n  \"schema\": " << schemaVersion << ",\n  \"results\": [\n";
+
+		for( size_t i = 0; i < results.size(); ++i ) {
+			const auto& result = results[i];
+
+			output
+				<< "    {\"name\": \"" << result.name << '"'
+				<< ", \"files\": " << result.files
+				<< ", \"bytes\": " << result.bytes
+				<< fixed << setprecision(6) << ", \"seconds\": " << result.seconds
+				<< setprecision(3)
+				<< ", \"mb_per_s\": " << result.megabytesPerSecond()
+				<< ", \"files_per_s\": " << result.filesPerSecond()
+				<< ", \"errors\": " << result.errors << '}'
+				<< (i + 1 < results.size() ? ",\n" : "\n");
+		}
+
+		output << "  ]\n}\n";
+		output.flags(flags);
+		output.precision(precision);
+	}
+
+	map<string, double> readBaseline(const fs::path& path) {
+		ifstream file(path);
+		map<string, double> baseline;
+		string line;
+
+		if( !file )
+			throw runtime_error(openErrorMsg(path));
+
+		// writeResults() puts each case on its own line, so no JSON parser is needed
+		while( getline(file, line) ) {
+			const string nameKey = "\"name\": \"", rateKey = "\"files_per_s\": ";
+			const auto name = line.find(nameKey);
+			const auto rate = line.find(rateKey);
+
+			if( name == string::npos || rate == string::npos )
+				continue;
+
+			const auto nameStart = name + nameKey.size();
+			const auto nameEnd = line.find('"', nameStart);
+
+			if( nameEnd == string::npos )
+				continue;
+
+			try {
+				baseline[line.substr(nameStart, nameEnd - nameStart)] = stod(line.substr(rate + rateKey.size()));
+			}
+			catch( const exception& ) {
+			}
+		}
+
+		if( file.bad() )
+			throw runtime_error(readErrorMsg(path));
+
+		return baseline;
+	}
+
+	size_t compareResults(const vector<BenchmarkResult>& results, const map<string, double>& baseline, double threshold, ostream& log) {
+		const auto flags = log.flags();
+		const auto precision = log.precision();
+		size_t regressions = 0;
+
+		log << "\nCompared with baseline (threshold " << fixed << setprecision(1) << threshold << "%):\n";
+
+		for( const auto& result : results ) {
+			const auto it = baseline.find(result.name);
+
+			if( it == baseline.end() || it->second <= 0 )
+				continue;
+
+			const double change = (result.filesPerSecond() - it->second) / it->second * 100;
+			const bool regressed = change < -threshold;
+
+			regressions += regressed;
+			log << indentLevel1 << left << setw(36) << result.name << right << showpos
+				<< setw(8) << change << noshowpos << '%'
+				<< (regressed ? "  REGRESSION" : "") << '\n';
+		}
+
+		log << indentLevel1 << regressions << " regression" << (regressions == 1 ? "" : "s") << '\n';
+		log.flags(flags);
+		log.precision(precision);
+
+		return regressions;
+	}
+}
@@ -0,0 +1,90 @@
+/**
+ *	@file results.h
+ *	@brief Results of the throughput benchmark, written as JSON and
+ *		   compared against a baseline.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_RESULTS_H
+#define SITHCODEC_RESULTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace SithCodec {
+	/**
+	 *	@brief Measurement of one benchmark case.
+	 */
+	struct BenchmarkResult {
+		std::string name;
+		std::size_t files = 0;
+		std::uintmax_t bytes = 0;
+		double seconds = 0;
+		std::size_t errors = 0;
+
+		double megabytesPerSecond() const { return seconds > 0 ? bytes / seconds / 1e6 : 0; }
+		double filesPerSecond() const { return seconds > 0 ? files / seconds : 0; }
+	};
+
+	/**
+	 *	@brief Writes results as JSON, one case per line in a fixed order.
+	 *
+	 *	@param results results
+	 *	@param output  output stream
+	 */
+	void writeResults(const std::vector<BenchmarkResult>& results, std::ostream& output);
+
+	/**
+	 *	@brief Reads the throughput of every case in a results file.
+	 *	@details Lines that are not cases written by writeResults() are
+	 *			 skipped.
+	 *
+	 *	@param path path of results file
+	 *
+	 *	@return files per second by case name
+	 *
+	 *	@throws runtime_error
+	 */
+	std::map<std::string, double> readBaseline(const std::filesystem::path& path);
+
+	/**
+	 *	@brief Compares results against a baseline and prints a report.
+	 *	@details Cases missing from the baseline, or with no throughput in
+	 *			 it, are left out.
+	 *
+	 *	@param results	 results
+	 *	@param baseline	 files per second by case name
+	 *	@param threshold slowdown in percent reported as a regression
+	 *	@param log		 output stream for the report
+	 *
+	 *	@return number of regressions
+	 */
+	std::size_t compareResults(const std::vector<BenchmarkResult>& results, const std::map<std::string, double>& baseline,
+		double threshold, std::ostream& log);
+}
+
+#endif
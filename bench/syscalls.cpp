@@ -0,0 +1,117 @@
+/**
+ *	@file syscalls.cpp
+ *	@brief Counting of the system calls made by a function, for the
+ *		   metadata benchmark.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "syscalls.h"
+
+#include <iostream>
+
+#include "iobackend.h"
+
+#ifdef SITHCODEC_LINUX
+#include <csignal>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace SithCodec {
+	using namespace std;
+
+	optional<uint64_t> countSyscalls(const function<void()>& body) {
+#ifdef SITHCODEC_LINUX
+		cout.flush();
+		cerr.flush();
+
+		const pid_t child = ::fork();
+
+		if( child < 0 )
+			return nullopt;
+
+		if( child == 0 ) {
+			::ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+			::raise(SIGSTOP);
+			try {
+				body();
+			}
+			catch( ... ) {
+				::_exit(1);
+			}
+			::_exit(0);
+		}
+
+		int status;
+
+		if( ::waitpid(child, &status, 0) != child || !WIFSTOPPED(status) ) {
+			::kill(child, SIGKILL);
+			::waitpid(child, &status, 0);
+			return nullopt;
+		}
+
+		::ptrace(PTRACE_SETOPTIONS, child, nullptr,
+			PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL);
+		::ptrace(PTRACE_SYSCALL, child, nullptr, nullptr);
+
+		// Every system call stops its thread twice, on entry and on exit,
+		// except the exit_group that ends the process
+		uint64_t stops = 0;
+		bool exited = false;
+		pid_t pid;
+
+		while( (pid = ::waitpid(-1, &status, __WALL)) > 0 ) {
+			if( WIFEXITED(status) || WIFSIGNALED(status) ) {
+				if( pid == child ) {
+					exited = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+					// Remaining threads are reaped by the kernel with the process
+					while( ::waitpid(-1, &status, __WALL) > 0 ) {}
+					break;
+				}
+				continue;
+			}
+
+			int signal = 0;
+
+			if( WIFSTOPPED(status) ) {
+				const int stop = WSTOPSIG(status);
+
+				if( stop == (SIGTRAP | 0x80) )
+					++stops;
+				else if( stop != SIGTRAP && stop != SIGSTOP )
+					signal = stop;	// pass real signals on
+			}
+
+			::ptrace(PTRACE_SYSCALL, pid, nullptr, reinterpret_cast<void*>(static_cast<intptr_t>(signal)));
+		}
+
+		if( !exited )
+			return nullopt;
+
+		return (stops + 1) / 2;
+#else
+		(void)body;
+		return nullopt;
+#endif
+	}
+}
@@ -0,0 +1,49 @@
+/**
+ *	@file syscalls.h
+ *	@brief Counting of the system calls made by a function, for the
+ *		   metadata benchmark.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_SYSCALLS_H
+#define SITHCODEC_SYSCALLS_H
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+
+namespace SithCodec {
+	/**
+	 *	@brief Counts the system calls a function makes, in all its threads.
+	 *	@details Runs the function in a forked child traced with ptrace, so its
+	 *			 work does not touch the caller's state. The caller must have
+	 *			 no other children, since any of them may be reaped.
+	 *
+	 *	@param body function to run
+	 *
+	 *	@return number of system calls, or nothing if tracing is not possible
+	 *			or the function throws
+	 */
+	std::optional<std::uint64_t> countSyscalls(const std::function<void()>& body);
+}
+
+#endif
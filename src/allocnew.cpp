@@ -0,0 +1,195 @@
+/**
+ *	@file allocnew.cpp
+ *	@brief Replacement of the global operator new and delete that feeds
+ *		   the allocation counts of allocstats.h.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include "allocstats.h"
+#include "iobackend.h"
+
+namespace SithCodec {
+	using namespace std;
+
+	namespace {
+		/**
+		 *	@brief Tells canCountAllocations() that the functions below
+		 *		   replace the global ones.
+		 */
+		const bool linked = (allocationCountingLinked = true);
+
+		void* allocate(size_t size) {
+			countAllocation(size);
+
+			for( ;; ) {
+				if( void* block = malloc(size ? size : 1) )
+					return block;
+
+				const auto handler = get_new_handler();
+
+				if( !handler )
+					throw bad_alloc();
+				handler();
+			}
+		}
+
+		void* allocateAligned(size_t size, align_val_t alignment) {
+			const auto align = max(static_cast<size_t>(alignment), sizeof(void*));
+
+			countAllocation(size);
+
+			for( ;; ) {
+				void* block = nullptr;
+
+#ifdef SITHCODEC_POSIX
+				if( ::posix_memalign(&block, align, size ? size : 1) == 0 )
+					return block;
+#else
+				if( (block = _aligned_malloc(size ? size : 1, align)) )
+					return block;
+#endif
+
+				const auto handler = get_new_handler();
+
+				if( !handler )
+					throw bad_alloc();
+				handler();
+			}
+		}
+
+		void deallocateAligned(void* block) noexcept {
+#ifdef SITHCODEC_POSIX
+			free(block);
+#else
+			_aligned_free(block);
+#endif
+		}
+	}
+}
+
+// Replacements of the global allocation functions. Every form of operator
+// new is replaced, and every operator delete with it, so that memory from
+// one is always released by its counterpart.
+
+void* operator new(std::size_t size) {
+	return SithCodec::allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+	return SithCodec::allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return SithCodec::allocate(size);
+	}
+	catch( ... ) {
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return SithCodec::allocate(size);
+	}
+	catch( ... ) {
+		return nullptr;
+	}
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	return SithCodec::allocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+	return SithCodec::allocateAligned(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	try {
+		return SithCodec::allocateAligned(size, alignment);
+	}
+	catch( ... ) {
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	try {
+		return SithCodec::allocateAligned(size, alignment);
+	}
+	catch( ... ) {
+		return nullptr;
+	}
+}
+
+void operator delete(void* block) noexcept {
+	std::free(block);
+}
+
+void operator delete[](void* block) noexcept {
+	std::free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept {
+	std::free(block);
+}
+
+void operator delete[](void* block, std::size_t) noexcept {
+	std::free(block);
+}
+
+void operator delete(void* block, const std::nothrow_t&) noexcept {
+	std::free(block);
+}
+
+void operator delete[](void* block, const std::nothrow_t&) noexcept {
+	std::free(block);
+}
+
+void operator delete(void* block, std::align_val_t) noexcept {
+	SithCodec::deallocateAligned(block);
+}
+
+void operator delete[](void* block, std::align_val_t) noexcept {
+	SithCodec::deallocateAligned(block);
+}
+
+void operator delete(void* block, std::size_t, std::align_val_t) noexcept {
+	SithCodec::deallocateAligned(block);
+}
+
+void operator delete[](void* block, std::size_t, std::align_val_t) noexcept {
+	SithCodec::deallocateAligned(block);
+}
+
+void operator delete(void* block, std::align_val_t, const std::nothrow_t&) noexcept {
+	SithCodec::deallocateAligned(block);
+}
+
+void operator delete[](void* block, std::align_val_t, const std::nothrow_t&) noexcept {
+	SithCodec::deallocateAligned(block);
+}
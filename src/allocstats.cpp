@@ -0,0 +1,290 @@
+/**
+ *	@file allocstats.cpp
+ *	@brief Counting of heap allocations, fed by the operator new of
+ *		   allocnew.cpp.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "allocstats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "codec.h"
+
+#ifdef SITHCODEC_POSIX
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace SithCodec {
+	using namespace std;
+
+	namespace {
+		/**
+		 *	@brief Allocations of the calling thread. Constant-initialized and
+		 *		   trivially destructible, so operator new can touch it on any
+		 *		   thread, at any time, without allocating itself.
+		 */
+		thread_local AllocationCounts threadCounts;
+
+		/**
+		 *	@brief Set while the thread updates its own bookkeeping, whose
+		 *		   allocations would otherwise land in an enclosing stage.
+		 */
+		thread_local bool bookkeeping = false;
+
+		atomic<uint64_t> processCount{ 0 };
+		atomic<uint64_t> processBytes{ 0 };
+
+		/**
+		 *	@brief Counts of one stage on one thread.
+		 */
+		struct StageTotals {
+			const char* name;
+			uint64_t calls = 0;
+			AllocationCounts counts{};
+			uint64_t peakGrowth = 0;
+		};
+
+		/**
+		 *	@brief Stages of one thread. Only the owning thread adds to it, so
+		 *		   no lock is needed until the counts are written.
+		 */
+		struct ThreadStages {
+			unsigned generation = 0;	///< run the counts belong to
+			vector<StageTotals> stages;
+		};
+
+		/**
+		 *	@brief Every thread's stages, kept after the thread exits.
+		 */
+		struct Registry {
+			mutex guard;
+			vector<shared_ptr<ThreadStages>> threads;
+			atomic<unsigned> generation{ 0 };
+		};
+
+		Registry& registry() {
+			static Registry instance;
+
+			return instance;
+		}
+
+		/**
+		 *	@brief Gets the calling thread's stages, registering them the
+		 *		   first time; the only step that takes a lock.
+		 */
+		ThreadStages& threadStages() {
+			thread_local shared_ptr<ThreadStages> stages;
+
+			if( !stages ) {
+				auto& reg = registry();
+				lock_guard lock(reg.guard);
+
+				stages = make_shared<ThreadStages>();
+				reg.threads.push_back(stages);
+			}
+
+			return *stages;
+		}
+
+		/**
+		 *	@brief Formats a byte count with a unit suited to its size.
+		 */
+		string formatBytes(double bytes) {
+			ostringstream str;
+
+			str << fixed << setprecision(1);
+			if( bytes < 1024 * 1024 )
+				str << bytes / 1024 << " KB";
+			else
+				str << bytes / (1024 * 1024) << " MB";
+			return str.str();
+		}
+	}
+
+	void countAllocation(size_t size) noexcept {
+		if( !isCountingAllocations() || bookkeeping )
+			return;
+
+		++threadCounts.allocations;
+		threadCounts.bytes += size;
+		processCount.fetch_add(1, memory_order_relaxed);
+		processBytes.fetch_add(size, memory_order_relaxed);
+	}
+
+	void startAllocationCounting() {
+		auto& reg = registry();
+
+		{
+			lock_guard lock(reg.guard);
+
+			++reg.generation;
+		}
+		processCount.store(0);
+		processBytes.store(0);
+		allocationCountingEnabled.store(true);
+	}
+
+	void stopAllocationCounting() noexcept {
+		allocationCountingEnabled.store(false);
+	}
+
+	AllocationCounts threadAllocations() noexcept {
+		return threadCounts;
+	}
+
+	AllocationCounts processAllocations() noexcept {
+		return { processCount.load(memory_order_relaxed), processBytes.load(memory_order_relaxed) };
+	}
+
+	uint64_t peakResidentBytes() noexcept {
+#ifdef SITHCODEC_POSIX
+		rusage usage;
+
+		if( ::getrusage(RUSAGE_SELF, &usage) != 0 )
+			return 0;
+#ifdef __APPLE__
+		return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+		// Linux and the BSDs report kilobytes
+		return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+		return 0;
+#endif
+	}
+
+	uint64_t currentResidentBytes() noexcept {
+#ifdef SITHCODEC_LINUX
+		// Opened once; procfs regenerates the contents on every read
+		static const int statm = ::open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+		static const auto pageSize = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+		char text[128];
+
+		if( statm < 0 )
+			return 0;
+
+		const auto n = ::pread(statm, text, sizeof(text) - 1, 0);
+
+		if( n <= 0 )
+			return 0;
+		text[n] = '\0';
+
+		// The second field is the resident size in pages
+		unsigned long long size = 0, resident = 0;
+
+		if( sscanf(text, "%llu %llu", &size, &resident) != 2 )
+			return 0;
+		return resident * pageSize;
+#else
+		return 0;
+#endif
+	}
+
+	void recordAllocationStage(const char* name, const AllocationCounts& start, const AllocationCounts& end,
+		uint64_t peakStart, uint64_t peakEnd) noexcept {
+		bookkeeping = true;
+
+		try {
+			auto& stages = threadStages();
+			const auto generation = registry().generation.load(memory_order_relaxed);
+
+			// Counts left over from an earlier run start afresh
+			if( stages.generation != generation ) {
+				stages.stages.clear();
+				stages.generation = generation;
+			}
+
+			auto it = find_if(stages.stages.begin(), stages.stages.end(), [&](const StageTotals& s) { return s.name == name; });
+
+			if( it == stages.stages.end() )
+				it = stages.stages.insert(stages.stages.end(), StageTotals{ name });
+			++it->calls;
+			it->counts.allocations += end.allocations - start.allocations;
+			it->counts.bytes += end.bytes - start.bytes;
+			it->peakGrowth += peakEnd > peakStart ? peakEnd - peakStart : 0;
+		}
+		catch( ... ) {
+			// A stage lost to memory exhaustion is not worth failing a conversion
+		}
+
+		bookkeeping = false;
+	}
+
+	void writeAllocationStages(ostream& output) {
+		auto& reg = registry();
+		lock_guard lock(reg.guard);
+		vector<StageTotals> stages;
+
+		// Equal names from different threads, or literals, are merged
+		for( const auto& thread : reg.threads ) {
+			if( thread->generation != reg.generation )
+				continue;
+
+			for( const auto& stage : thread->stages ) {
+				auto it = find_if(stages.begin(), stages.end(), [&](const StageTotals& s) { return strcmp(s.name, stage.name) == 0; });
+
+				if( it == stages.end() ) {
+					stages.push_back(stage);
+					continue;
+				}
+				it->calls += stage.calls;
+				it->counts.allocations += stage.counts.allocations;
+				it->counts.bytes += stage.counts.bytes;
+				it->peakGrowth += stage.peakGrowth;
+			}
+		}
+		sort(stages.begin(), stages.end(), [](const auto& a, const auto& b) { return a.counts.allocations > b.counts.allocations; });
+
+		if( stages.empty() )
+			return;
+
+		const auto flags = output.flags();
+		const auto precision = output.precision();
+
+		output
+			<< indentLevel1 << "allocations by stage\n"
+			<< indentLevel2 << left << setw(20) << "stage" << right << setw(10) << "calls" << setw(12) << "allocs"
+			<< setw(10) << "per call" << setw(12) << "bytes" << setw(14) << "peak RSS +" << '\n';
+
+		for( const auto& stage : stages )
+			output
+				<< indentLevel2 << left << setw(20) << stage.name << right << setw(10) << stage.calls
+				<< setw(12) << stage.counts.allocations
+				<< setw(10) << fixed << setprecision(1) << static_cast<double>(stage.counts.allocations) / stage.calls
+				<< setw(12) << formatBytes(static_cast<double>(stage.counts.bytes))
+				<< setw(14) << formatBytes(static_cast<double>(stage.peakGrowth)) << '\n';
+
+		output.flags(flags);
+		output.precision(precision);
+	}
+}
@@ -0,0 +1,147 @@
+/**
+ *	@file allocstats.h
+ *	@brief Counting of heap allocations through an interposed operator new.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_ALLOCSTATS_H
+#define SITHCODEC_ALLOCSTATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace SithCodec {
+	/**
+	 *	@brief Number and total size of heap allocations.
+	 */
+	struct AllocationCounts {
+		std::uint64_t allocations = 0;
+		std::uint64_t bytes = 0;
+	};
+
+	/**
+	 *	@brief Whether allocations are being counted; read through
+	 *		   isCountingAllocations().
+	 */
+	inline std::atomic<bool> allocationCountingEnabled{ false };
+
+	/**
+	 *	@brief Determines whether allocations are being counted.
+	 *
+	 *	@return true between startAllocationCounting() and
+	 *			stopAllocationCounting()
+	 */
+	inline bool isCountingAllocations() noexcept {
+		return allocationCountingEnabled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 *	@brief Whether allocnew.cpp is linked in; set by its static
+	 *		   initialization and read through canCountAllocations().
+	 */
+	inline bool allocationCountingLinked = false;
+
+	/**
+	 *	@brief Determines whether allocations can be counted at all.
+	 *
+	 *	@return true if the replacement operator new of allocnew.cpp is part
+	 *			of the program; without it the counts stay at zero
+	 */
+	inline bool canCountAllocations() noexcept {
+		return allocationCountingLinked;
+	}
+
+	/**
+	 *	@brief Counts one allocation of the calling thread, if counting.
+	 *	@details Called by the replacement operator new of allocnew.cpp.
+	 *			 That file replaces the global allocation functions in every
+	 *			 program it is linked into, so programs that never count
+	 *			 allocations, such as the benchmarks, can leave it out; they
+	 *			 then count none.
+	 *
+	 *	@param size bytes requested
+	 */
+	void countAllocation(std::size_t size) noexcept;
+
+	/**
+	 *	@brief Starts counting every operator new, and the allocations of
+	 *		   every TraceSpan stage, discarding any counts from before.
+	 */
+	void startAllocationCounting();
+
+	/**
+	 *	@brief Stops counting; the counts stay readable.
+	 */
+	void stopAllocationCounting() noexcept;
+
+	/**
+	 *	@brief Gets the allocations made by the calling thread while counting.
+	 *
+	 *	@return running totals; subtract two readings for a span of code
+	 */
+	AllocationCounts threadAllocations() noexcept;
+
+	/**
+	 *	@brief Gets the allocations made by every thread since
+	 *		   startAllocationCounting().
+	 */
+	AllocationCounts processAllocations() noexcept;
+
+	/**
+	 *	@brief Gets the largest resident set size of the process so far.
+	 *
+	 *	@return bytes, or 0 where the system does not report it
+	 */
+	std::uint64_t peakResidentBytes() noexcept;
+
+	/**
+	 *	@brief Gets the resident set size of the process now.
+	 *	@details Read from /proc/self/statm, kept open between calls.
+	 *
+	 *	@return bytes, or 0 where the system does not report it
+	 */
+	std::uint64_t currentResidentBytes() noexcept;
+
+	/**
+	 *	@brief Adds one pass through a stage to the calling thread's totals.
+	 *
+	 *	@param name		 name of the stage; must outlive the count
+	 *	@param start	 thread allocations at the start
+	 *	@param end		 thread allocations at the end
+	 *	@param peakStart peakResidentBytes() at the start
+	 *	@param peakEnd	 peakResidentBytes() at the end
+	 */
+	void recordAllocationStage(const char* name, const AllocationCounts& start, const AllocationCounts& end,
+		std::uint64_t peakStart, std::uint64_t peakEnd) noexcept;
+
+	/**
+	 *	@brief Writes a table of the allocations of each stage.
+	 *	@details Must not be called while other threads are still counting.
+	 *
+	 *	@param output output stream
+	 */
+	void writeAllocationStages(std::ostream& output);
+}
+
+#endif
@@ -0,0 +1,359 @@
+/**
+ *	@file asynclog.cpp
+ *	@brief Batch result log written by a dedicated thread.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "asynclog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "trace.h"
+
+namespace SithCodec {
+	using namespace std;
+	namespace fs = std::filesystem;
+
+	namespace {
+		/**
+		 *	@brief Amount of formatted text written to the output at once.
+		 */
+		constexpr size_t logBlockSize = 64 * 1024;
+
+		/**
+		 *	@brief Longest time formatted text waits for more to join it
+		 *		   before it is written anyway.
+		 */
+		constexpr int64_t logLatency = 100 * 1000 * 1000;
+
+		size_t roundUpToPowerOfTwo(size_t value) {
+			size_t result = 2;
+
+			while( result < value )
+				result <<= 1;
+			return result;
+		}
+
+		/**
+		 *	@brief Appends a string as a quoted JSON string.
+		 */
+		void appendJsonString(string& text, string_view str) {
+			const char* digits = "0123456789abcdef";
+
+			text += '"';
+			for( const char ch : str ) {
+				const auto byte = static_cast<unsigned char>(ch);
+
+				if( ch == '"' || ch == '\\' ) {
+					text += '\\';
+					text += ch;
+				}
+				else if( byte < 0x20 ) {
+					text += "\\u00";
+					text += digits[byte >> 4];
+					text += digits[byte & 0xf];
+				}
+				else {
+					text += ch;
+				}
+			}
+			text += '"';
+		}
+
+		/**
+		 *	@brief Gets a native path in the narrow encoding, without a copy
+		 *		   where that is the native one.
+		 */
+		template<typename Char>
+		string_view pathText(const basic_string<Char>& path, string& converted) {
+			if constexpr( is_same_v<Char, char> ) {
+				return path;
+			}
+			else {
+				converted = fs::path(path).string();
+				return converted;
+			}
+		}
+
+		/**
+		 *	@brief Renders the error of a record the way errorMessage() does
+		 *		   for a whole FileOperation, so write and delete failures
+		 *		   point at the output rather than the input.
+		 */
+		string errorText(const LogRecord& record, const fs::path::string_type& path) {
+			return errorMessage(FileOperation{ path, record.error });
+		}
+
+		const char* outcomeName(FileOutcome outcome) {
+			switch( outcome ) {
+			case FileOutcome::Failed:
+				return "failed";
+			case FileOutcome::UpToDate:
+				return "up_to_date";
+			default:
+				return "done";
+			}
+		}
+	}
+
+	AsyncLog::AsyncLog(ostream& output, LogFormat format, size_t capacity)
+		: output(output), format(format), mask(roundUpToPowerOfTwo(capacity) - 1), cells(new Cell[mask + 1]) {
+		for( size_t i = 0; i <= mask; ++i )
+			cells[i].sequence.store(i, memory_order_relaxed);
+		writer = thread([this] { run(); });
+	}
+
+	AsyncLog::~AsyncLog() {
+		{
+			lock_guard lock(mutex);
+
+			stopping = true;
+		}
+		wake.notify_one();
+		writer.join();
+	}
+
+	void AsyncLog::push(const LogRecord& record, const fs::path& path) {
+		const auto sequence = record.sequence;
+		auto& cell = cells[sequence & mask];
+
+		// A cell is free for a sequence number once the writer has passed the
+		// one a lap before; only its own record can claim it, so no
+		// compare-and-swap is needed
+		if( cell.sequence.load(memory_order_acquire) == sequence ) {
+			cell.record = record;
+			cell.path.assign(path.native());
+			cell.sequence.store(sequence + 1, memory_order_release);
+
+			// Pairs with the fence in run(): either the writer sees the record
+			// or this sees it parked
+			atomic_thread_fence(memory_order_seq_cst);
+			if( parked.load(memory_order_relaxed) && next.load(memory_order_relaxed) == sequence )
+				wakeWriter();
+			return;
+		}
+
+		// Still a lap behind: an earlier file is holding the writer up
+		{
+			lock_guard lock(mutex);
+
+			setAside.emplace(sequence, make_pair(record, path.native()));
+			setAsideCount.fetch_add(1, memory_order_relaxed);
+		}
+		wake.notify_one();
+	}
+
+	BatchSink AsyncLog::sink() {
+		return [this](const FileOperation& operation, FileOutcome outcome, const FileConversion& conversion, uint64_t nanoseconds) {
+			push({ operation.index, operation.error, outcome, conversion.format, conversion.bytesRead, conversion.bytesWritten, nanoseconds }, operation.path);
+		};
+	}
+
+	void AsyncLog::flush() {
+		unique_lock lock(mutex);
+		const auto request = ++flushRequests;
+
+		wake.notify_one();
+		flushed.wait(lock, [&] { return flushesDone >= request; });
+	}
+
+	void AsyncLog::wakeWriter() {
+		// Taking the lock orders this after the writer's last check
+		{
+			lock_guard lock(mutex);
+		}
+		wake.notify_one();
+	}
+
+	bool AsyncLog::take(string& text) {
+		const auto sequence = next.load(memory_order_relaxed);
+		auto& cell = cells[sequence & mask];
+
+		if( cell.sequence.load(memory_order_acquire) == sequence + 1 ) {
+			append(text, cell.record, cell.path);
+		}
+		else {
+			if( setAsideCount.load(memory_order_relaxed) == 0 )
+				return false;
+
+			lock_guard lock(mutex);
+			const auto found = setAside.find(sequence);
+
+			if( found == setAside.end() )
+				return false;
+			append(text, found->second.first, found->second.second);
+			setAside.erase(found);
+			setAsideCount.fetch_sub(1, memory_order_relaxed);
+		}
+
+		// Either way the cell moves on to the next lap
+		cell.sequence.store(sequence + mask + 1, memory_order_release);
+		next.store(sequence + 1, memory_order_relaxed);
+		return true;
+	}
+
+	void AsyncLog::writeRemaining(string& text) {
+		// The batch ended without some files, so the ones after them are
+		// written in order around the gaps
+		vector<pair<const LogRecord*, const PathString*>> remaining;
+
+		for( size_t i = 0; i <= mask; ++i ) {
+			const auto sequence = cells[i].sequence.load(memory_order_acquire);
+
+			if( ((sequence - 1) & mask) == i && sequence - 1 >= next.load(memory_order_relaxed) )
+				remaining.emplace_back(&cells[i].record, &cells[i].path);
+		}
+		for( const auto& [sequence, record] : setAside )
+			remaining.emplace_back(&record.first, &record.second);
+		sort(remaining.begin(), remaining.end(), [](const auto& a, const auto& b) { return a.first->sequence < b.first->sequence; });
+		for( const auto& [record, path] : remaining )
+			append(text, *record, *path);
+	}
+
+	void AsyncLog::run() {
+		string text;
+		int64_t pendingSince = 0;
+		size_t flushesTaken = 0;
+
+		text.reserve(logBlockSize * 2);
+
+		const auto writeText = [&] {
+			output.write(text.data(), static_cast<streamsize>(text.size()));
+			text.clear();
+		};
+
+		for( ;; ) {
+			// Take every record that is next in order, writing whenever a block fills
+			for( ;; ) {
+				const bool wasEmpty = text.empty();
+
+				if( !take(text) )
+					break;
+				if( wasEmpty )
+					pendingSince = traceClock();
+				if( text.size() >= logBlockSize )
+					writeText();
+			}
+
+			unique_lock lock(mutex);
+
+			parked.store(true, memory_order_relaxed);
+			atomic_thread_fence(memory_order_seq_cst);
+
+			const auto sequence = next.load(memory_order_relaxed);
+			const bool ready = cells[sequence & mask].sequence.load(memory_order_acquire) == sequence + 1
+				|| setAside.count(sequence) > 0;
+
+			if( !ready && stopping ) {
+				// push() is no longer called
+				writeRemaining(text);
+				writeText();
+				output.flush();
+				return;
+			}
+			if( !ready && flushRequests > flushesTaken ) {
+				const auto request = flushRequests;
+
+				lock.unlock();
+				writeText();
+				output.flush();
+				lock.lock();
+				flushesTaken = request;
+				flushesDone = request;
+				flushed.notify_all();
+			}
+			// Small amounts of text wait a little for company
+			else if( !ready && !text.empty() ) {
+				const auto waited = traceClock() - pendingSince;
+
+				if( waited < logLatency )
+					wake.wait_for(lock, chrono::nanoseconds(logLatency - waited));
+				else {
+					lock.unlock();
+					writeText();
+					output.flush();
+				}
+			}
+			else if( !ready ) {
+				wake.wait(lock);
+			}
+			parked.store(false, memory_order_relaxed);
+		}
+	}
+
+	void AsyncLog::append(string& text, const LogRecord& record, const PathString& path) const {
+		string converted;
+		const auto name = pathText(path, converted);
+
+		if( format == LogFormat::JsonLines ) {
+			text += "{\"path\":";
+			appendJsonString(text, name);
+			text += ",\"outcome\":\"";
+			text += outcomeName(record.outcome);
+			text += "\",\"format\":\"";
+			text += getFormatName(record.format);
+			text += "\",\"bytes_read\":";
+			text += to_string(record.bytesRead);
+			text += ",\"bytes_written\":";
+			text += to_string(record.bytesWritten);
+			text += ",\"duration_ns\":";
+			text += to_string(record.nanoseconds);
+			if( record.error ) {
+				text += ",\"code\":\"";
+				text += getErrorName(record.error.code);
+				text += '"';
+				if( record.error.systemError ) {
+					text += ",\"errno\":";
+					text += to_string(record.error.systemError);
+				}
+				text += ",\"error\":";
+				appendJsonString(text, errorText(record, path));
+			}
+			text += "}\n";
+			return;
+		}
+
+		text += indentLevel1;
+		text += name;
+		text += ' ';
+		switch( record.outcome ) {
+		case FileOutcome::Failed:
+			text += failMsg;
+			text += '\n';
+			text += indentLevel2;
+			text += errorText(record, path);
+			break;
+		case FileOutcome::UpToDate:
+			text += upToDateMsg;
+			break;
+		default:
+			text += successMsg;
+			break;
+		}
+		text += '\n';
+	}
+}
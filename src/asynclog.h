@@ -0,0 +1,164 @@
+/**
+ *	@file asynclog.h
+ *	@brief Batch result log written by a dedicated thread.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_ASYNCLOG_H
+#define SITHCODEC_ASYNCLOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "batchstats.h"
+#include "codec.h"
+
+namespace SithCodec {
+	/**
+	 *	@brief Enumerator of AsyncLog layouts.
+	 */
+	enum class LogFormat {
+		Text,		///< one "path done!" line per file, as printed by the console
+		JsonLines,	///< one JSON object per file, with sizes and duration
+	};
+
+	/**
+	 *	@brief Result of one file, as queued for the log.
+	 *	@details Plain data, so queuing it copies no heap memory; the path
+	 *			 goes with it separately. The error message is rendered only
+	 *			 when the record is written.
+	 */
+	struct LogRecord {
+		std::size_t sequence = 0;	///< FileOperation::index, which orders the log
+		FileError error;
+		FileOutcome outcome = FileOutcome::Done;
+		AudioFormat format = AudioFormat::None;
+		std::uint64_t bytesRead = 0;
+		std::uint64_t bytesWritten = 0;
+		std::uint64_t nanoseconds = 0;
+	};
+
+	/**
+	 *	@brief Log of batch results that workers append to without locking.
+	 *	@details Records go into a bounded lock-free ring, in the cell of
+	 *			 their sequence number. A dedicated thread takes them out in
+	 *			 that order, formats them, and writes the text in large
+	 *			 blocks, so slow consoles and log storage no longer hold up
+	 *			 the conversions, and the log lists files in the order
+	 *			 loadOperations() gives them whatever order they finish in.
+	 *
+	 *			 Workers never wait. A record more than the ring ahead of the
+	 *			 oldest one still missing, which happens only while one file
+	 *			 takes as long as thousands of others, is set aside under a
+	 *			 lock until the writer reaches it. The writer sleeps while the
+	 *			 next record has not arrived.
+	 *
+	 *			 Sequence numbers start at 0 and each is pushed once, so a log
+	 *			 serves a single batch.
+	 */
+	class AsyncLog {
+	public:
+		/**
+		 *	@brief Starts the writer thread.
+		 *
+		 *	@param output	output stream; must outlive this object
+		 *	@param format	layout of records
+		 *	@param capacity number of records the ring holds, rounded up to a
+		 *					power of two; bounds how far results can finish
+		 *					ahead of an earlier file before they are set aside
+		 */
+		AsyncLog(std::ostream& output, LogFormat format, std::size_t capacity = 4096);
+
+		/**
+		 *	@brief Writes every record still queued and stops the thread.
+		 */
+		~AsyncLog();
+
+		AsyncLog(const AsyncLog&) = delete;
+		AsyncLog& operator=(const AsyncLog&) = delete;
+
+		/**
+		 *	@brief Queues a record; safe to call from any number of threads.
+		 *
+		 *	@param record result of one file
+		 *	@param path	  path of the file
+		 */
+		void push(const LogRecord& record, const std::filesystem::path& path);
+
+		/**
+		 *	@brief Makes a sink for encodeAll() and decodeAll() that queues
+		 *		   every result here.
+		 *
+		 *	@return sink; must not be called after this object is destroyed
+		 */
+		BatchSink sink();
+
+		/**
+		 *	@brief Waits until every record queued so far has been written and
+		 *		   the output flushed, up to the first one still to arrive.
+		 */
+		void flush();
+
+	private:
+		using PathString = std::filesystem::path::string_type;
+
+		struct Cell {
+			std::atomic<std::size_t> sequence;	///< record number it is free for, or that number plus one once filled
+			LogRecord record;
+			PathString path;	///< keeps its capacity from lap to lap
+		};
+
+		void run();
+		bool take(std::string& text);
+		void writeRemaining(std::string& text);
+		void wakeWriter();
+		void append(std::string& text, const LogRecord& record, const PathString& path) const;
+
+		std::ostream& output;
+		const LogFormat format;
+		const std::size_t mask;
+		std::unique_ptr<Cell[]> cells;
+		alignas(64) std::atomic<std::size_t> next{ 0 };	///< sequence number the writer waits for
+		std::atomic<bool> parked{ false };	///< writer is asleep or about to be
+		std::atomic<std::size_t> setAsideCount{ 0 };
+		std::mutex mutex;	///< guards the members below
+		std::condition_variable wake;
+		std::condition_variable flushed;
+		std::map<std::size_t, std::pair<LogRecord, PathString>> setAside;	///< records that found their cell taken
+		std::size_t flushRequests = 0;
+		std::size_t flushesDone = 0;
+		bool stopping = false;
+		std::thread writer;
+	};
+}
+
+#endif
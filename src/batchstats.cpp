@@ -0,0 +1,384 @@
+/**
+ *	@file batchstats.cpp
+ *	@brief Counters and latency histograms collected during a batch.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "batchstats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+
+#include "trace.h"
+
+namespace SithCodec {
+	namespace fs = std::filesystem;
+	using namespace std;
+
+	namespace {
+		/**
+		 *	@brief Raises an atomic to a value if it is lower.
+		 */
+		void raise(atomic<uint64_t>& target, uint64_t value) noexcept {
+			auto current = target.load(memory_order_relaxed);
+
+			while( current < value && !target.compare_exchange_weak(current, value, memory_order_relaxed) ) {}
+		}
+
+		/**
+		 *	@brief Formats a duration with a unit suited to its size.
+		 */
+		string formatDuration(uint64_t nanoseconds) {
+			ostringstream str;
+
+			str << fixed << setprecision(nanoseconds < 1000 ? 0 : 1);
+			if( nanoseconds < 1000 )
+				str << nanoseconds << " ns";
+			else if( nanoseconds < 1000000 )
+				str << nanoseconds / 1e3 << " us";
+			else if( nanoseconds < 1000000000 )
+				str << nanoseconds / 1e6 << " ms";
+			else
+				str << nanoseconds / 1e9 << " s";
+			return str.str();
+		}
+
+		/**
+		 *	@brief Formats a byte count in megabytes.
+		 */
+		string formatBytes(uint64_t bytes) {
+			ostringstream str;
+
+			str << fixed << setprecision(1) << bytes / 1e6 << " MB";
+			return str.str();
+		}
+	}
+
+	size_t LatencyHistogram::indexOf(uint64_t value) noexcept {
+		if( value < subBuckets )
+			return static_cast<size_t>(value);
+
+		// Above the first linear range, each power of two gets half as many
+		// buckets as the first range, each one twice as wide as the last
+		unsigned exponent = 63;
+
+		while( !(value >> exponent) )
+			--exponent;
+
+		const unsigned shift = exponent - (subBucketBits - 1);
+		const auto top = static_cast<size_t>(value >> shift) - subBuckets / 2;
+
+		return subBuckets + (exponent - subBucketBits) * (subBuckets / 2) + top;
+	}
+
+	uint64_t LatencyHistogram::highestValueOf(size_t index) noexcept {
+		if( index < subBuckets )
+			return index;
+
+		const auto range = (index - subBuckets) / (subBuckets / 2);
+		const auto top = (index - subBuckets) % (subBuckets / 2) + subBuckets / 2;
+		const unsigned shift = static_cast<unsigned>(range) + 1;
+		const uint64_t lowest = static_cast<uint64_t>(top) << shift;
+
+		return lowest + ((uint64_t(1) << shift) - 1);
+	}
+
+	void LatencyHistogram::record(uint64_t nanoseconds) noexcept {
+		buckets[indexOf(nanoseconds)].fetch_add(1, memory_order_relaxed);
+		total.fetch_add(1, memory_order_relaxed);
+		raise(largest, nanoseconds);
+	}
+
+	uint64_t LatencyHistogram::count() const noexcept {
+		return total.load(memory_order_relaxed);
+	}
+
+	uint64_t LatencyHistogram::percentile(double percentile) const noexcept {
+		const auto values = count();
+
+		if( values == 0 )
+			return 0;
+
+		const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(ceil(percentile / 100 * values)));
+		uint64_t seen = 0;
+
+		for( size_t i = 0; i < bucketCount; ++i ) {
+			seen += buckets[i].load(memory_order_relaxed);
+			if( seen >= rank )
+				return min(highestValueOf(i), max());
+		}
+
+		return max();
+	}
+
+	uint64_t LatencyHistogram::max() const noexcept {
+		return largest.load(memory_order_relaxed);
+	}
+
+	BatchStats::BatchStats(size_t slowestCount) : slowestCount(slowestCount) {}
+
+	void BatchStats::begin() noexcept {
+		started.store(traceClock(), memory_order_relaxed);
+		finished.store(0, memory_order_relaxed);
+	}
+
+	void BatchStats::end() noexcept {
+		finished.store(traceClock(), memory_order_relaxed);
+	}
+
+	void BatchStats::fileQueued(uintmax_t bytes) noexcept {
+		queuedBytes.fetch_add(bytes, memory_order_relaxed);
+		queued.fetch_add(1, memory_order_relaxed);
+	}
+
+	void BatchStats::enumerationFinished() noexcept {
+		enumerated.store(true, memory_order_release);
+	}
+
+	void BatchStats::fileTaken() noexcept {
+		taken.fetch_add(1, memory_order_relaxed);
+	}
+
+	void BatchStats::addStageTime(BatchStage stage, uint64_t nanoseconds) noexcept {
+		stages[static_cast<size_t>(stage)].fetch_add(nanoseconds, memory_order_relaxed);
+	}
+
+	void BatchStats::recordFile(const FileOperation& operation, FileOutcome outcome, const FileConversion& conversion, uint64_t nanoseconds) {
+		auto& totals = formats[static_cast<size_t>(conversion.format)];
+
+		finishedBytes.fetch_add(operation.size, memory_order_relaxed);
+		if( outcome == FileOutcome::Done ) {
+			totals.bytesRead.fetch_add(conversion.bytesRead, memory_order_relaxed);
+			totals.bytesWritten.fetch_add(conversion.bytesWritten, memory_order_relaxed);
+		}
+		// Counted last, so that a reader never sees a file finished before its bytes
+		totals.files[static_cast<size_t>(outcome)].fetch_add(1, memory_order_relaxed);
+
+		if( outcome == FileOutcome::UpToDate )
+			return;
+
+		addStageTime(BatchStage::Convert, nanoseconds);
+		histogram.record(nanoseconds);
+
+		// Most files are faster than the slowest few and never take the lock
+		if( slowestCount == 0 || nanoseconds <= slowThreshold.load(memory_order_relaxed) )
+			return;
+
+		const auto faster = [](const auto& a, const auto& b) { return a.first > b.first; };
+		lock_guard lock(slowMutex);
+
+		if( slowFiles.size() == slowestCount ) {
+			if( nanoseconds <= slowFiles.front().first )
+				return;
+			pop_heap(slowFiles.begin(), slowFiles.end(), faster);
+			slowFiles.pop_back();
+		}
+
+		slowFiles.emplace_back(nanoseconds, operation.path.string());
+		push_heap(slowFiles.begin(), slowFiles.end(), faster);
+
+		if( slowFiles.size() == slowestCount )
+			slowThreshold.store(slowFiles.front().first, memory_order_relaxed);
+	}
+
+	void BatchStats::recordFileAllocations(const AllocationCounts& counts, uint64_t residentBefore, uint64_t residentAfter) noexcept {
+		const auto growth = residentAfter > residentBefore ? residentAfter - residentBefore : 0;
+
+		allocationFiles.fetch_add(1, memory_order_relaxed);
+		fileAllocations.fetch_add(counts.allocations, memory_order_relaxed);
+		fileAllocatedBytes.fetch_add(counts.bytes, memory_order_relaxed);
+		raise(maxFileAllocations, counts.allocations);
+		raise(maxFileAllocatedBytes, counts.bytes);
+		fileResidentGrowth.fetch_add(growth, memory_order_relaxed);
+		raise(maxFileResidentGrowth, growth);
+		raise(maxFileResident, max(residentBefore, residentAfter));
+	}
+
+	uint64_t BatchStats::files(FileOutcome outcome) const noexcept {
+		uint64_t count = 0;
+
+		for( const auto& totals : formats )
+			count += totals.files[static_cast<size_t>(outcome)].load(memory_order_relaxed);
+		return count;
+	}
+
+	uint64_t BatchStats::files(AudioFormat format) const noexcept {
+		return files(format, FileOutcome::Done);
+	}
+
+	uint64_t BatchStats::files(AudioFormat format, FileOutcome outcome) const noexcept {
+		return formats[static_cast<size_t>(format)].files[static_cast<size_t>(outcome)].load(memory_order_relaxed);
+	}
+
+	uint64_t BatchStats::filesFinished() const noexcept {
+		return files(FileOutcome::Done) + files(FileOutcome::Failed) + files(FileOutcome::UpToDate);
+	}
+
+	uint64_t BatchStats::filesQueued() const noexcept {
+		return queued.load(memory_order_relaxed);
+	}
+
+	uint64_t BatchStats::bytesQueued() const noexcept {
+		return queuedBytes.load(memory_order_relaxed);
+	}
+
+	uint64_t BatchStats::bytesFinished() const noexcept {
+		return finishedBytes.load(memory_order_relaxed);
+	}
+
+	bool BatchStats::isEnumerated() const noexcept {
+		return enumerated.load(memory_order_acquire);
+	}
+
+	uint64_t BatchStats::queueDepth() const noexcept {
+		// Taken first: both only grow, so a file taken meanwhile is never counted twice
+		const auto removed = taken.load(memory_order_relaxed);
+		const auto added = queued.load(memory_order_relaxed);
+
+		return added > removed ? added - removed : 0;
+	}
+
+	uint64_t BatchStats::activeFiles() const noexcept {
+		const auto finished = filesFinished();
+		const auto started = taken.load(memory_order_relaxed);
+
+		return started > finished ? started - finished : 0;
+	}
+
+	uint64_t BatchStats::stageTime(BatchStage stage) const noexcept {
+		return stages[static_cast<size_t>(stage)].load(memory_order_relaxed);
+	}
+
+	uint64_t BatchStats::bytesRead() const noexcept {
+		uint64_t bytes = 0;
+
+		for( const auto& totals : formats )
+			bytes += totals.bytesRead.load(memory_order_relaxed);
+		return bytes;
+	}
+
+	uint64_t BatchStats::bytesRead(AudioFormat format) const noexcept {
+		return formats[static_cast<size_t>(format)].bytesRead.load(memory_order_relaxed);
+	}
+
+	uint64_t BatchStats::bytesWritten() const noexcept {
+		uint64_t bytes = 0;
+
+		for( const auto& totals : formats )
+			bytes += totals.bytesWritten.load(memory_order_relaxed);
+		return bytes;
+	}
+
+	uint64_t BatchStats::bytesWritten(AudioFormat format) const noexcept {
+		return formats[static_cast<size_t>(format)].bytesWritten.load(memory_order_relaxed);
+	}
+
+	double BatchStats::elapsed() const noexcept {
+		const auto start = started.load(memory_order_relaxed);
+		const auto stop = finished.load(memory_order_relaxed);
+
+		if( start == 0 )
+			return 0;
+		return ((stop ? stop : traceClock()) - start) / 1e9;
+	}
+
+	vector<pair<uint64_t, string>> BatchStats::slowest() const {
+		lock_guard lock(slowMutex);
+		auto files = slowFiles;
+
+		sort(files.begin(), files.end(), greater<>());
+		return files;
+	}
+
+	void BatchStats::printSummary(ostream& output) const {
+		const auto seconds = elapsed();
+		const auto perSecond = [&](double value) { return seconds > 0 ? value / seconds : 0; };
+		const auto flags = output.flags();
+		const auto precision = output.precision();
+
+		output
+			<< "Summary\n"
+			<< indentLevel1 << files(FileOutcome::Done) << " done, " << files(FileOutcome::Failed) << " failed, "
+			<< files(FileOutcome::UpToDate) << ' ' << upToDateMsg << '\n';
+
+		for( const auto format : { AudioFormat::SFX, AudioFormat::VO, AudioFormat::None } ) {
+			if( files(format) == 0 )
+				continue;
+			output << indentLevel1 << getFormatName(format) << ": " << files(format) << " files, "
+				<< formatBytes(bytesRead(format)) << " read, " << formatBytes(bytesWritten(format)) << " written\n";
+		}
+
+		output
+			<< fixed << setprecision(1)
+			<< indentLevel1 << formatBytes(bytesRead()) << " read, " << formatBytes(bytesWritten()) << " written in "
+			<< setprecision(3) << seconds << " s\n" << setprecision(1)
+			<< indentLevel1 << perSecond(bytesRead() / 1e6) << " MB/s read, " << perSecond(bytesWritten() / 1e6)
+			<< " MB/s written, " << perSecond(static_cast<double>(files(FileOutcome::Done) + files(FileOutcome::Failed)))
+			<< " files/s\n";
+
+		if( histogram.count() > 0 )
+			output
+				<< indentLevel1 << "latency p50 " << formatDuration(histogram.percentile(50))
+				<< ", p90 " << formatDuration(histogram.percentile(90))
+				<< ", p99 " << formatDuration(histogram.percentile(99))
+				<< ", max " << formatDuration(histogram.max()) << '\n';
+
+		const auto slow = slowest();
+
+		if( !slow.empty() ) {
+			output << indentLevel1 << "slowest files\n";
+			for( const auto& [nanoseconds, path] : slow )
+				output << indentLevel2 << setw(10) << formatDuration(nanoseconds) << "  " << path << '\n';
+		}
+
+		const auto allocations = processAllocations();
+
+		// Only when allocations were counted during the batch
+		if( allocations.allocations > 0 ) {
+			const auto counted = allocationFiles.load(memory_order_relaxed);
+			const auto perFile = [&](uint64_t value) { return counted ? static_cast<double>(value) / counted : 0; };
+
+			output
+				<< indentLevel1 << allocations.allocations << " allocations, " << formatBytes(allocations.bytes)
+				<< " allocated, peak RSS " << formatBytes(peakResidentBytes()) << '\n';
+			if( counted > 0 )
+				output
+					<< indentLevel1 << "per file " << perFile(fileAllocations.load(memory_order_relaxed))
+					<< " allocations (max " << maxFileAllocations.load(memory_order_relaxed) << "), "
+					<< perFile(fileAllocatedBytes.load(memory_order_relaxed)) / 1e3 << " KB (max "
+					<< maxFileAllocatedBytes.load(memory_order_relaxed) / 1e3 << " KB)\n";
+			// Zero where the system does not report the current resident set
+			if( counted > 0 && maxFileResident.load(memory_order_relaxed) > 0 )
+				output
+					<< indentLevel1 << "per file RSS +" << perFile(fileResidentGrowth.load(memory_order_relaxed)) / 1e3
+					<< " KB (max +" << maxFileResidentGrowth.load(memory_order_relaxed) / 1e3 << " KB), RSS around files up to "
+					<< formatBytes(maxFileResident.load(memory_order_relaxed)) << '\n';
+			writeAllocationStages(output);
+		}
+
+		output.flags(flags);
+		output.precision(precision);
+	}
+}
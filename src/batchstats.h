@@ -0,0 +1,320 @@
+/**
+ *	@file batchstats.h
+ *	@brief Counters and latency histograms collected during a batch.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_BATCHSTATS_H
+#define SITHCODEC_BATCHSTATS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "allocstats.h"
+#include "codec.h"
+
+namespace SithCodec {
+	/**
+	 *	@brief Histogram of durations in the manner of HdrHistogram: buckets
+	 *		   are linear within each power of two, so every recorded value is
+	 *		   kept to within 1/64 of itself whatever its magnitude.
+	 *	@details record() is lock-free and may be called from any thread.
+	 */
+	class LatencyHistogram {
+	public:
+		/**
+		 *	@brief Adds a value.
+		 *
+		 *	@param nanoseconds duration
+		 */
+		void record(std::uint64_t nanoseconds) noexcept;
+
+		/**
+		 *	@brief Gets the number of values added.
+		 */
+		std::uint64_t count() const noexcept;
+
+		/**
+		 *	@brief Gets the value below which a share of the values fall.
+		 *
+		 *	@param percentile share in percent, e.g. 99
+		 *
+		 *	@return upper bound of the bucket holding that value, or 0 if empty
+		 */
+		std::uint64_t percentile(double percentile) const noexcept;
+
+		/**
+		 *	@brief Gets the largest value added, exactly.
+		 */
+		std::uint64_t max() const noexcept;
+
+	private:
+		static constexpr unsigned subBucketBits = 7;
+		static constexpr std::size_t subBuckets = std::size_t(1) << subBucketBits;
+		static constexpr std::size_t bucketCount = subBuckets + (64 - subBucketBits) * (subBuckets / 2);
+
+		static std::size_t indexOf(std::uint64_t value) noexcept;
+		static std::uint64_t highestValueOf(std::size_t index) noexcept;
+
+		std::array<std::atomic<std::uint64_t>, bucketCount> buckets{};
+		std::atomic<std::uint64_t> total{ 0 };
+		std::atomic<std::uint64_t> largest{ 0 };
+	};
+
+	/**
+	 *	@brief Phases of a batch whose time is accumulated separately.
+	 */
+	enum class BatchStage {
+		Enumerate,	///< walking the input tree or reading the list
+		Manifest,	///< checking files against the manifest
+		Convert,	///< encoding or decoding, summed over files
+		Save,		///< rewriting the manifest
+	};
+
+	/**
+	 *	@brief Statistics of a batch, fed by encodeAll() and decodeAll() when
+	 *		   given in BatchOptions::stats.
+	 *	@details Every counter is an atomic updated without locks; only a file
+	 *			 slower than all of the current slowest files takes a lock.
+	 */
+	class BatchStats {
+	public:
+		/**
+		 *	@brief Creates empty statistics.
+		 *
+		 *	@param slowestCount number of slowest files to keep
+		 */
+		explicit BatchStats(std::size_t slowestCount = 10);
+
+		/**
+		 *	@brief Marks the start of the batch; called by the batch itself.
+		 */
+		void begin() noexcept;
+
+		/**
+		 *	@brief Marks the end of the batch; called by the batch itself.
+		 */
+		void end() noexcept;
+
+		/**
+		 *	@brief Counts a file handed to the workers; called by the batch.
+		 *
+		 *	@param bytes size of the input file
+		 */
+		void fileQueued(std::uintmax_t bytes = 0) noexcept;
+
+		/**
+		 *	@brief Marks every file as queued, which makes the totals final;
+		 *		   called by the batch.
+		 */
+		void enumerationFinished() noexcept;
+
+		/**
+		 *	@brief Counts a file a worker took from the queue; called by the
+		 *		   batch before recordFile().
+		 */
+		void fileTaken() noexcept;
+
+		/**
+		 *	@brief Adds time spent in a stage.
+		 *
+		 *	@param stage	   stage
+		 *	@param nanoseconds duration
+		 */
+		void addStageTime(BatchStage stage, std::uint64_t nanoseconds) noexcept;
+
+		/**
+		 *	@brief Records a finished file.
+		 *
+		 *	@param operation	 input file
+		 *	@param outcome		 what happened to it
+		 *	@param conversion	 format and byte counts, for converted files
+		 *	@param nanoseconds	 time spent on the file
+		 */
+		void recordFile(const FileOperation& operation, FileOutcome outcome, const FileConversion& conversion,
+			std::uint64_t nanoseconds);
+
+		/**
+		 *	@brief Records the heap allocations and resident memory of one
+		 *		   file, while allocations are counted.
+		 *	@details The resident set is the whole process's, so with several
+		 *			 workers a file's growth includes what the others did
+		 *			 meanwhile; the largest growth bounds the memory one file
+		 *			 can cost.
+		 *
+		 *	@param counts		  allocations made between taking the file and finishing it
+		 *	@param residentBefore currentResidentBytes() when the file was taken
+		 *	@param residentAfter  currentResidentBytes() when it was finished
+		 */
+		void recordFileAllocations(const AllocationCounts& counts, std::uint64_t residentBefore, std::uint64_t residentAfter) noexcept;
+
+		/**
+		 *	@brief Gets the number of files with an outcome.
+		 */
+		std::uint64_t files(FileOutcome outcome) const noexcept;
+
+		/**
+		 *	@brief Gets the number of files converted from or to a format.
+		 */
+		std::uint64_t files(AudioFormat format) const noexcept;
+
+		/**
+		 *	@brief Gets the number of files of a format with an outcome.
+		 *	@details Failed and skipped files count under the format encoded
+		 *			 to, or AudioFormat::None when decoding.
+		 */
+		std::uint64_t files(AudioFormat format, FileOutcome outcome) const noexcept;
+
+		/**
+		 *	@brief Gets the number of files finished with any outcome.
+		 */
+		std::uint64_t filesFinished() const noexcept;
+
+		/**
+		 *	@brief Gets the number of files enumerated so far.
+		 */
+		std::uint64_t filesQueued() const noexcept;
+
+		/**
+		 *	@brief Gets the input size of the files enumerated so far.
+		 *
+		 *	@return bytes, or 0 unless BatchOptions::sizeInputs is set
+		 */
+		std::uint64_t bytesQueued() const noexcept;
+
+		/**
+		 *	@brief Gets the input size of the files finished with any outcome.
+		 *
+		 *	@return bytes, or 0 unless BatchOptions::sizeInputs is set
+		 */
+		std::uint64_t bytesFinished() const noexcept;
+
+		/**
+		 *	@brief Determines whether enumeration has finished, so that
+		 *		   filesQueued() and bytesQueued() are totals.
+		 */
+		bool isEnumerated() const noexcept;
+
+		/**
+		 *	@brief Gets the number of files enumerated but not yet taken.
+		 */
+		std::uint64_t queueDepth() const noexcept;
+
+		/**
+		 *	@brief Gets the number of files taken but not yet finished, which
+		 *		   is the number of busy workers, or of files in flight on
+		 *		   io_uring.
+		 */
+		std::uint64_t activeFiles() const noexcept;
+
+		/**
+		 *	@brief Gets the time spent in a stage.
+		 *
+		 *	@return nanoseconds
+		 */
+		std::uint64_t stageTime(BatchStage stage) const noexcept;
+
+		/**
+		 *	@brief Gets the number of bytes read, in total or for one format.
+		 */
+		std::uint64_t bytesRead() const noexcept;
+		std::uint64_t bytesRead(AudioFormat format) const noexcept;
+
+		/**
+		 *	@brief Gets the number of bytes written, in total or for one format.
+		 */
+		std::uint64_t bytesWritten() const noexcept;
+		std::uint64_t bytesWritten(AudioFormat format) const noexcept;
+
+		/**
+		 *	@brief Gets the time since begin(), up to end() once it was called.
+		 *
+		 *	@return seconds
+		 */
+		double elapsed() const noexcept;
+
+		/**
+		 *	@brief Gets the per-file latency histogram.
+		 */
+		const LatencyHistogram& latency() const noexcept { return histogram; }
+
+		/**
+		 *	@brief Gets the slowest files, slowest first.
+		 *
+		 *	@return pairs of nanoseconds and path
+		 */
+		std::vector<std::pair<std::uint64_t, std::string>> slowest() const;
+
+		/**
+		 *	@brief Prints totals, throughput, latency percentiles and the
+		 *		   slowest files.
+		 *
+		 *	@param output output stream
+		 */
+		void printSummary(std::ostream& output) const;
+
+	private:
+		static constexpr std::size_t formatCount = 3;
+		static constexpr std::size_t outcomeCount = 3;
+		static constexpr std::size_t stageCount = 4;
+
+		struct Totals {
+			std::array<std::atomic<std::uint64_t>, outcomeCount> files{};
+			std::atomic<std::uint64_t> bytesRead{ 0 };
+			std::atomic<std::uint64_t> bytesWritten{ 0 };
+		};
+
+		std::array<Totals, formatCount> formats;
+		std::atomic<std::uint64_t> allocationFiles{ 0 };
+		std::atomic<std::uint64_t> fileAllocations{ 0 };
+		std::atomic<std::uint64_t> fileAllocatedBytes{ 0 };
+		std::atomic<std::uint64_t> maxFileAllocations{ 0 };
+		std::atomic<std::uint64_t> maxFileAllocatedBytes{ 0 };
+		std::atomic<std::uint64_t> fileResidentGrowth{ 0 };
+		std::atomic<std::uint64_t> maxFileResidentGrowth{ 0 };
+		std::atomic<std::uint64_t> maxFileResident{ 0 };	///< largest resident set sampled around a file
+		std::array<std::atomic<std::uint64_t>, stageCount> stages{};
+		std::atomic<std::uint64_t> queued{ 0 };
+		std::atomic<std::uint64_t> queuedBytes{ 0 };
+		std::atomic<std::uint64_t> finishedBytes{ 0 };
+		std::atomic<bool> enumerated{ false };
+		std::atomic<std::uint64_t> taken{ 0 };
+		LatencyHistogram histogram;
+		std::atomic<std::int64_t> started{ 0 };
+		std::atomic<std::int64_t> finished{ 0 };
+
+		const std::size_t slowestCount;
+		std::atomic<std::uint64_t> slowThreshold{ 0 };	///< fastest of the slowest, once there are enough
+		mutable std::mutex slowMutex;
+		std::vector<std::pair<std::uint64_t, std::string>> slowFiles;	///< min-heap on duration
+	};
+}
+
+#endif
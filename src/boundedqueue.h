@@ -0,0 +1,156 @@
+/**
+ *	@file boundedqueue.h
+ *	@brief Blocking queue of limited capacity connecting pipeline stages.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_BOUNDEDQUEUE_H
+#define SITHCODEC_BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace SithCodec {
+	/**
+	 *	@brief Multi-producer, multi-consumer FIFO queue that blocks producers
+	 *		   while full and consumers while empty.
+	 *
+	 *	@tparam T element type
+	 */
+	template<class T>
+	class BoundedQueue {
+	public:
+		/**
+		 *	@brief Creates an empty queue.
+		 *
+		 *	@param capacity maximum number of queued elements
+		 */
+		explicit BoundedQueue(std::size_t capacity) : capacity(capacity ? capacity : 1) {}
+
+		/**
+		 *	@brief Adds an element, waiting for room if the queue is full.
+		 *
+		 *	@param value element to add
+		 *
+		 *	@return false if the queue was closed, in which case value is dropped
+		 */
+		bool push(T value) {
+			std::unique_lock lock(mutex);
+
+			notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+
+			if( closed )
+				return false;
+
+			items.push_back(std::move(value));
+			lock.unlock();
+			notEmpty.notify_one();
+			return true;
+		}
+
+		/**
+		 *	@brief Removes the oldest element, waiting for one if the queue is empty.
+		 *
+		 *	@return element, or nothing once the queue is closed and drained
+		 */
+		std::optional<T> pop() {
+			std::unique_lock lock(mutex);
+
+			notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+
+			return take(lock);
+		}
+
+		/**
+		 *	@brief Removes the oldest element if there is one, without waiting.
+		 *
+		 *	@return element, or nothing if the queue is empty
+		 */
+		std::optional<T> tryPop() {
+			std::unique_lock lock(mutex);
+
+			return take(lock);
+		}
+
+		/**
+		 *	@brief Marks the end of input. Consumers drain what is left, and
+		 *		   further pushes fail.
+		 */
+		void close() {
+			{
+				std::lock_guard lock(mutex);
+
+				closed = true;
+			}
+			notEmpty.notify_all();
+			notFull.notify_all();
+		}
+
+		/**
+		 *	@brief Gets the number of queued elements.
+		 *
+		 *	@return number of elements
+		 */
+		std::size_t size() const {
+			std::lock_guard lock(mutex);
+
+			return items.size();
+		}
+
+		/**
+		 *	@brief Whether close() has been called and every element was taken.
+		 *
+		 *	@return true if nothing more will come out of the queue
+		 */
+		bool drained() const {
+			std::lock_guard lock(mutex);
+
+			return closed && items.empty();
+		}
+
+	private:
+		std::optional<T> take(std::unique_lock<std::mutex>& lock) {
+			if( items.empty() )
+				return std::nullopt;
+
+			std::optional<T> value(std::move(items.front()));
+
+			items.pop_front();
+			lock.unlock();
+			notFull.notify_one();
+			return value;
+		}
+
+		const std::size_t capacity;
+		mutable std::mutex mutex;
+		std::condition_variable notEmpty;
+		std::condition_variable notFull;
+		std::deque<T> items;
+		bool closed = false;
+	};
+}
+
+#endif
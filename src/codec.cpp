@@ -26,165 +26,728 @@
 
 #include "codec.h"
 
+#include <algorithm>
+#include <cstring>
+#include <deque>
 #include <exception>
 #include <fstream>
+#include <future>
 #include <iomanip>
+#include <memory>
+#include <new>
 #include <random>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+
+#ifdef SITHCODEC_POSIX
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "asynclog.h"
+#include "batchstats.h"
+#include "boundedqueue.h"
+#include "dirwalk.h"
+#include "listfile.h"
+#include "manifest.h"
+#include "trace.h"
+#include "uringbatch.h"
 
 namespace SithCodec {
 	namespace fs = std::filesystem;
 	using namespace std;
 
-	vector<FileOperation> loadOperations(const fs::path& path) {
+	namespace {
+		/**
+		 *	@brief Deletes the file an encode or decode replaced when the new
+		 *		   file was given a different extension.
+		 *
+		 *	@param outputPath path requested by the caller
+		 *	@param finalPath  path actually written
+		 *	@param error	  set to CodecErrc::Delete on failure
+		 */
+		void removeReplaced(const fs::path& outputPath, const fs::path& finalPath, FileError& error) {
+			if( outputPath == finalPath )
+				return;
+
+			TraceSpan span("remove");
+			error_code removeError;
+
+			remove(outputPath, removeError);
+
+			if( removeError )
+				error = { CodecErrc::Delete, removeError.value() };
+		}
+
+		/**
+		 *	@brief Throws the error of a single encode or decode, with the
+		 *		   message naming the file it concerns.
+		 *
+		 *	@param error	  error
+		 *	@param inputPath  path of the input file
+		 *	@param outputPath path requested by the caller
+		 *	@param conversion result so far
+		 *
+		 *	@throws runtime_error
+		 */
+		[[noreturn]] void throwFileError(const FileError& error, const fs::path& inputPath, const fs::path& outputPath,
+			const FileConversion& conversion) {
+			switch( error.code ) {
+			case CodecErrc::Open:
+			case CodecErrc::Read:
+				throw runtime_error(errorMessage(error, inputPath));
+			case CodecErrc::Delete:
+				throw runtime_error(errorMessage(error, outputPath));
+			default:
+				throw runtime_error(errorMessage(error, conversion.outputPath));
+			}
+		}
+
+		/**
+		 *	@brief Determines whether a path is a directory or lies inside one.
+		 *
+		 *	@param path		 path to test
+		 *	@param directory directory
+		 *
+		 *	@return true if path is directory or one of its descendants
+		 */
+		bool isWithin(const fs::path& path, const fs::path& directory) {
+			error_code error;
+			const auto canonicalPath = weakly_canonical(path, error);
+			const auto canonicalDirectory = weakly_canonical(directory, error);
+
+			if( error )
+				return true;
+
+			const auto relativePath = canonicalPath.lexically_relative(canonicalDirectory);
+
+			return !relativePath.empty() && *relativePath.begin() != "..";
+		}
+
+		/**
+		 *	@brief Thrown through enumeration to stop it once nobody takes
+		 *		   its files any more.
+		 */
+		struct EnumerationStopped {};
+
+		/**
+		 *	@brief Enumerates the inputs of a batch, leaving out its outputs.
+		 *	@details Outputs written beside their inputs are never seen, since
+		 *			 the walk lists a directory completely before it visits any
+		 *			 of its files. An output directory elsewhere inside the
+		 *			 input folder is skipped as a whole, as the walk could reach
+		 *			 it after outputs were written there.
+		 *
+		 *	@param inputPath	   path to a list of files, or a folder
+		 *	@param outputDirectory directory receiving the outputs
+		 *	@param visit		   function called with each input
+		 */
+		void enumerateInputs(const fs::path& inputPath, const fs::path& outputDirectory, const function<void(fs::path)>& visit) {
+			if( !is_directory(inputPath) || !isWithin(outputDirectory, inputPath) || isWithin(inputPath, outputDirectory) ) {
+				enumerateOperations(inputPath, visit);
+				return;
+			}
+
+			// Walked paths are joined onto inputPath as given, so the output
+			// directory is spelled the same way and compared as a prefix
+			const auto outputs = inputPath / weakly_canonical(outputDirectory).lexically_relative(weakly_canonical(inputPath));
+			const auto outputsPrefix = (outputs / "").native();
+
+			walkDirectory(inputPath, [&](const fs::path& entry, bool isDirectory) {
+				if( !isDirectory && entry.native().compare(0, outputsPrefix.size(), outputsPrefix) != 0 )
+					visit(entry);
+			});
+		}
+
+		/**
+		 *	@brief Checks the input of a batch and creates its output directory.
+		 *
+		 *	@param inputPath  path to a list of files, or a folder
+		 *	@param outputPath output folder, or empty to write beside the inputs
+		 *
+		 *	@return directory receiving the outputs
+		 *
+		 *	@throws runtime_error
+		 */
+		fs::path prepareBatchOutput(const fs::path& inputPath, const fs::path& outputPath) {
+			if( !exists(inputPath) )
+				throw runtime_error(openErrorMsg(inputPath));
+
+			const auto& outputDirectory = outputPath == "" ? inputPath : outputPath;
+
+			if( !exists(outputDirectory) && !empty(outputDirectory) )
+				create_directories(outputDirectory);
+
+			if( !is_directory(outputDirectory) )
+				throw runtime_error(openErrorMsg(outputPath));
+
+			return outputDirectory;
+		}
+
+		/**
+		 *	@brief Encodes or decodes every file found under a path.
+		 *	@details Enumeration runs on its own thread and feeds the workers
+		 *			 through a BoundedQueue, so conversion starts with the first
+		 *			 file found and memory for pending work stays bounded, in
+		 *			 place too; see enumerateInputs(). Enumeration stops as soon
+		 *			 as the workers give up. With a manifest, files it shows to
+		 *			 be up to date are skipped.
+		 *
+		 *	@param inputPath	   path to a list of files, or a folder
+		 *	@param outputDirectory directory receiving the outputs
+		 *	@param encodeFormat	   format to encode in, or nothing to decode
+		 *	@param options		   batch settings
+		 *	@param table		   table receiving every file in the order it was
+		 *						   enumerated, with its outcome, or null
+		 *	@param sink			   function receiving each result, or empty
+		 *
+		 *	@throws runtime_error
+		 */
+		void runBatch(const fs::path& inputPath, const fs::path& outputDirectory, optional<AudioFormat> encodeFormat, const BatchOptions& options,
+			OperationTable* table, const BatchSink& sink) {
+			BoundedQueue<FileOperation> queue(pipelineCapacity);
+			exception_ptr enumerationError;
+			const auto manifest = options.manifest.empty() ? nullptr : make_unique<Manifest>(options.manifest, options.hashContents);
+			const string signature = encodeFormat ? string("encode ") + getFormatName(encodeFormat.value()) : "decode";
+
+			if( options.stats )
+				options.stats->begin();
+
+			const auto accept = [&](FileOperation& operation, const fs::path& outputPath) {
+				if( !manifest )
+					return true;
+
+				TraceSpan span("manifest");
+				const auto started = options.stats ? traceClock() : 0;
+				const bool upToDate = manifest->upToDate(operation.path, signature, outputPath);
+
+				if( options.stats )
+					options.stats->addStageTime(BatchStage::Manifest, static_cast<uint64_t>(traceClock() - started));
+				if( upToDate ) {
+					const auto format = encodeFormat.value_or(AudioFormat::None);
+
+					operation.skipped = true;
+					if( table )
+						table->update(operation);
+					if( options.stats )
+						options.stats->recordFile(operation, FileOutcome::UpToDate, { {}, format }, 0);
+					if( sink )
+						sink(operation, FileOutcome::UpToDate, { {}, format }, 0);
+					return false;
+				}
+				return true;
+			};
+			// Called for failed files too, whose conversion is empty
+			const auto finish = [&](FileOperation& operation, const FileConversion& conversion, uint64_t nanoseconds) {
+				const auto outcome = operation.error ? FileOutcome::Failed : FileOutcome::Done;
+
+				if( table )
+					table->update(operation);
+				if( manifest && !operation.error )
+					manifest->record(operation.path, signature, conversion.outputPath);
+				if( options.stats )
+					options.stats->recordFile(operation, outcome, conversion, nanoseconds);
+				if( sink )
+					sink(operation, outcome, conversion, nanoseconds);
+			};
+
+			// Files io_uring takes are counted here, the workers count their own
+			const auto take = [&](FileOperation& operation, const fs::path& outputPath) {
+				if( options.stats )
+					options.stats->fileTaken();
+				return accept(operation, outputPath);
+			};
+
+			thread producer([&] {
+				const auto started = options.stats ? traceClock() : 0;
+				size_t sequence = 0;
+
+				try {
+					enumerateInputs(inputPath, outputDirectory, [&](fs::path path) {
+						FileOperation operation{ move(path), {} };
+
+						// The table never moves its entries, so workers can update
+						// them while enumeration keeps appending; its indices are the
+						// same sequence numbers
+						operation.index = table ? table->add(operation.path) : sequence;
+						++sequence;
+
+						// Sized here, off the workers' path, but only when asked: a stat
+						// per file is what enumeration otherwise avoids
+						if( options.stats && options.sizeInputs ) {
+							error_code ec;
+							const auto size = fs::file_size(operation.path, ec);
+
+							operation.size = ec ? 0 : size;
+							if( table )
+								table->setInputSize(operation.index, operation.size);
+						}
+						if( options.stats )
+							options.stats->fileQueued(operation.size);
+						// Closed: the workers failed, so the rest of the tree is not needed
+						if( !queue.push(move(operation)) )
+							throw EnumerationStopped();
+					});
+				}
+				catch( const EnumerationStopped& ) {
+				}
+				catch( ... ) {
+					enumerationError = current_exception();
+				}
+				if( options.stats ) {
+					options.stats->addStageTime(BatchStage::Enumerate, static_cast<uint64_t>(traceClock() - started));
+					options.stats->enumerationFinished();
+				}
+				queue.close();
+			});
+
+			const auto consume = [&] {
+				while( auto popped = queue.pop() ) {
+					auto& operation = *popped;
+					const bool countAllocations = options.stats && isCountingAllocations();
+					const auto allocations = countAllocations ? threadAllocations() : AllocationCounts{};
+					const auto resident = countAllocations ? currentResidentBytes() : 0;
+					FileConversion conversion;
+					int64_t started = 0;
+
+					// Failures are counted under the format they were encoded to
+					conversion.format = encodeFormat.value_or(AudioFormat::None);
+					if( options.stats )
+						options.stats->fileTaken();
+
+					try {
+						const auto outputPath = outputDirectory / getRelativePath(operation.path, inputPath);
+
+						if( !accept(operation, outputPath) )
+							continue;
+
+						if( options.stats || sink )
+							started = traceClock();
+
+						TraceSpan span(encodeFormat ? "encode" : "decode", operation.path);
+
+						// Unreadable and foreign files are common in large trees, so
+						// their failures are returned rather than thrown
+						conversion = encodeFormat
+							? encode(operation.path, encodeFormat.value(), outputPath, options.engine, operation.error)
+							: decode(operation.path, outputPath, options.engine, operation.error);
+					}
+					// What can still throw here is allocation and the path and
+					// manifest calls around the conversion; the errno keeps the cause
+					catch( const bad_alloc& ) {
+						operation.error = { CodecErrc::Memory };
+					}
+					catch( const system_error& ex ) {
+						operation.error = { CodecErrc::Other, ex.code().category() == system_category() || ex.code().category() == generic_category() ? ex.code().value() : 0 };
+					}
+					catch( const exception& ) {
+						operation.error = { CodecErrc::Other };
+					}
+					if( operation.error )
+						conversion = { {}, encodeFormat.value_or(AudioFormat::None) };
+
+					if( countAllocations ) {
+						const auto now = threadAllocations();
+
+						options.stats->recordFileAllocations({ now.allocations - allocations.allocations, now.bytes - allocations.bytes },
+							resident, currentResidentBytes());
+					}
+					finish(operation, conversion, started ? static_cast<uint64_t>(traceClock() - started) : 0);
+				}
+			};
+
+			try {
+				if( options.engine == IoEngine::Uring )
+					uringConvertAll(queue, inputPath, outputDirectory, encodeFormat, options.queueDepth, take, finish);
+
+				// Whatever io_uring did not take is converted by the workers
+				const unsigned workers = options.jobs ? options.jobs : defaultWorkerCount();
+
+				if( workers == 1 ) {
+					consume();
+				}
+				else {
+					ThreadPool pool(workers);
+
+					for( unsigned i = 0; i < workers; ++i )
+						pool.submit(consume);
+					pool.wait();
+				}
+			}
+			catch( ... ) {
+				queue.close();
+				if( producer.joinable() )
+					producer.join();
+				if( options.stats )
+					options.stats->end();
+				throw;
+			}
+
+			if( producer.joinable() )
+				producer.join();
+
+			// Saved even if enumeration failed, so the files converted count next time
+			if( manifest ) {
+				const auto started = options.stats ? traceClock() : 0;
+
+				manifest->save();
+				if( options.stats )
+					options.stats->addStageTime(BatchStage::Save, static_cast<uint64_t>(traceClock() - started));
+			}
+
+			if( options.stats )
+				options.stats->end();
+
+			if( enumerationError )
+				rethrow_exception(enumerationError);
+		}
+
+		/**
+		 *	@brief Number of entries printFormats() probes as one unit of work.
+		 */
+		constexpr size_t listChunkSize = 256;
+
+		/**
+		 *	@brief Appends a string to a CSV row as a quoted field.
+		 */
+		void appendCsvField(string& text, string_view field) {
+			text += '"';
+			for( const char ch : field ) {
+				if( ch == '"' )
+					text += '"';
+				text += ch;
+			}
+			text += '"';
+		}
+
+		/**
+		 *	@brief Appends a string as a quoted JSON string.
+		 */
+		void appendJsonString(string& text, string_view str) {
+			const char* digits = "0123456789abcdef";
+
+			text += '"';
+			for( const char ch : str ) {
+				const auto byte = static_cast<unsigned char>(ch);
+
+				if( ch == '"' || ch == '\\' ) {
+					text += '\\';
+					text += ch;
+				}
+				else if( byte < 0x20 ) {
+					text += "\\u00";
+					text += digits[byte >> 4];
+					text += digits[byte & 0xf];
+				}
+				else {
+					text += ch;
+				}
+			}
+			text += '"';
+		}
+
+		/**
+		 *	@brief Appends the lines printFormats() writes before any entry.
+		 */
+		void appendListHeader(string& text, const fs::path& directory, ListFormat format) {
+			switch( format ) {
+			case ListFormat::Csv:
+				text += "path,type,format\n";
+				break;
+			case ListFormat::JsonLines:
+				break;
+			default:
+				text += directory.string();
+				text += '\n';
+				break;
+			}
+		}
+
+		/**
+		 *	@brief Appends one printFormats() entry.
+		 *
+		 *	@param text		   output buffer
+		 *	@param path		   path of entry
+		 *	@param isDirectory whether the entry is a directory
+		 *	@param format	   audio format, or nothing if the file could not be read
+		 *	@param listFormat  output layout
+		 */
+		void appendListEntry(string& text, const fs::path& path, bool isDirectory, optional<AudioFormat> format, ListFormat listFormat) {
+			const char* formatName = format ? getFormatName(format.value()) : nullptr;
+
+			switch( listFormat ) {
+			case ListFormat::Csv:
+				appendCsvField(text, path.string());
+				text += isDirectory ? ",directory," : ",file,";
+				if( !isDirectory )
+					text += formatName ? formatName : "error";
+				text += '\n';
+				break;
+			case ListFormat::JsonLines:
+				text += "{\"path\":";
+				appendJsonString(text, path.string());
+				text += isDirectory ? ",\"type\":\"directory\"" : ",\"type\":\"file\"";
+				if( !isDirectory ) {
+					text += ",\"format\":";
+					if( formatName ) {
+						text += '"';
+						text += formatName;
+						text += '"';
+					}
+					else {
+						text += "null";
+					}
+				}
+				text += "}\n";
+				break;
+			default:
+				if( isDirectory ) {
+					text += indentLevel1;
+					text += path.string();
+				}
+				else {
+					text += indentLevel2;
+					text += path.filename().string();
+					text += ' ';
+					text += formatName ? formatName : failMsg;
+				}
+				text += '\n';
+				break;
+			}
+		}
+
+		/**
+		 *	@brief Run of consecutive printFormats() entries, probed and
+		 *		   formatted together.
+		 */
+		struct ListChunk {
+			struct Item {
+				fs::path path;
+				bool isDirectory;
+			};
+
+			ListChunk() : done(ready.get_future()) {}
+
+			vector<Item> entries;
+			string text;
+			promise<void> ready;
+			future<void> done;
+
+			void format(ListFormat listFormat) {
+				// The writer waits on every chunk in turn, so a failure must reach it
+				try {
+					for( const auto& entry : entries )
+						appendListEntry(text, entry.path, entry.isDirectory,
+							entry.isDirectory ? nullopt : probeFormat(entry.path), listFormat);
+					entries = vector<Item>();
+				}
+				catch( ... ) {
+					ready.set_exception(current_exception());
+					return;
+				}
+				ready.set_value();
+			}
+		};
+	}
+
+	OperationTable loadOperations(const fs::path& path) {
 		return is_directory(path)
 			? loadOperationsFromFolder(path)
 			: loadOperationsFromFile(path);
 	}
 
-	vector<FileOperation> loadOperationsFromFolder(const fs::path& path) {
-		vector<FileOperation> operations;
+	OperationTable loadOperationsFromFolder(const fs::path& path) {
+		OperationTable operations;
 
-		for( const auto& entry : fs::recursive_directory_iterator(path) )
-			if( !is_directory(entry) )
-				operations.push_back({ entry.path(), nullopt });
+		enumerateOperationsFromFolder(path, [&](const fs::path& entry) {
+			operations.add(entry);
+		});
 
 		return operations;
 	}
 
-	vector<FileOperation> loadOperationsFromFile(const fs::path& path) {
-		ifstream file(path);
+	OperationTable loadOperationsFromFile(const fs::path& path) {
+		OperationTable operations;
+		ListFile list(path);
+		string_view line;
+
+		// Lines go straight into the table, with no path built in between
+		while( list.next(line) ) {
+			if constexpr( is_same_v<fs::path::value_type, char> )
+				operations.add(line);
+			else
+				operations.add(fs::path(line));
+		}
 
-		if( !file )
-			throw runtime_error(openErrorMsg(path));
+		return operations;
+	}
 
-		vector<FileOperation> operations;
-		string str;
+	void enumerateOperations(const fs::path& path, const function<void(fs::path)>& visit) {
+		if( is_directory(path) )
+			enumerateOperationsFromFolder(path, visit);
+		else
+			enumerateOperationsFromFile(path, visit);
+	}
+
+	void enumerateOperationsFromFolder(const fs::path& path, const function<void(fs::path)>& visit) {
+		walkDirectory(path, [&](const fs::path& entry, bool isDirectory) {
+			if( !isDirectory )
+				visit(entry);
+		});
+	}
 
-		while( getline(file, str) )
-			operations.push_back({ str, nullopt });
+	void enumerateOperationsFromFile(const fs::path& path, const function<void(fs::path)>& visit) {
+		ListFile list(path);
+		string_view line;
 
-		return operations;
+		while( list.next(line) )
+			visit(fs::path(line));
 	}
 
-	void encode(const fs::path& inputPath, AudioFormat format, const fs::path& outputPath) {
-		ifstream input(inputPath, ios::binary);
+	FileConversion encode(const fs::path& inputPath, AudioFormat format, const fs::path& outputPath, IoEngine engine) {
+		FileError error;
+		auto conversion = encode(inputPath, format, outputPath, engine, error);
 
-		if( !input )
-			throw runtime_error(openErrorMsg(inputPath));
+		if( error )
+			throwFileError(error, inputPath, outputPath, conversion);
+		return conversion;
+	}
 
-		const auto tempPath = getTempPath();
-		ofstream output(tempPath, ios::binary);
+	FileConversion encode(const fs::path& inputPath, AudioFormat format, const fs::path& outputPath, IoEngine engine, FileError& error) {
+		FileConversion conversion;
 
-		if( !output )
-			throw runtime_error(writeErrorMsg(tempPath));
+		if( format == AudioFormat::None ) {
+			error = { CodecErrc::Format };
+			return conversion;
+		}
 
-		const char* header = getHeader(format);
-		const auto headerSize = sizeOfHeader(format);
+		conversion.outputPath = fs::path(outputPath).replace_extension(getEncodeExtension(format));
+		conversion.format = format;
 
-		output.write(header, headerSize);
-		copy(istreambuf_iterator(input), {}, ostreambuf_iterator(output));
-		input.close();
-		output.close();
+		StagedFile output(conversion.outputPath, error);
+		const auto headerSize = static_cast<uintmax_t>(sizeOfHeader(format));
 
-		if( exists(outputPath) ) {
-			error_code error;
+		if( error )
+			return conversion;
 
-			remove(outputPath, error);
+		const auto payload = transfer(inputPath, 0, string_view(getHeader(format), headerSize), output, engine, error);
 
-			if( error )
-				throw runtime_error(deleteErrorMsg(outputPath));
-		}
-		else if( !outputPath.parent_path().empty() ) {
-			create_directories(outputPath.parent_path());
-		}
+		if( error )
+			return conversion;
+		output.commit(error);
+		if( error )
+			return conversion;
+		removeReplaced(outputPath, conversion.outputPath, error);
+		if( error )
+			return conversion;
 
-		rename(tempPath, fs::path(outputPath).replace_extension(getEncodeExtension(format)));
+		conversion.bytesRead = payload;
+		conversion.bytesWritten = headerSize + payload;
+		return conversion;
 	}
 
-	vector<FileOperation> encodeAll(const fs::path& inputPath, AudioFormat format, const fs::path& outputPath) {
-		if( !exists(inputPath) )
-			throw std::runtime_error(openErrorMsg(inputPath));
+	OperationTable encodeAll(const fs::path& inputPath, AudioFormat format, const fs::path& outputPath, const BatchOptions& options) {
+		OperationTable table;
 
-		const auto& outputDirectory = outputPath == "" ? inputPath : outputPath;
+		runBatch(inputPath, prepareBatchOutput(inputPath, outputPath), format, options, &table, {});
+		return table;
+	}
 
-		if( !exists(outputDirectory) && !empty(outputDirectory) )
-			create_directories(outputDirectory);
+	void encodeAll(const fs::path& inputPath, AudioFormat format, const fs::path& outputPath, const BatchOptions& options, const BatchSink& sink) {
+		runBatch(inputPath, prepareBatchOutput(inputPath, outputPath), format, options, nullptr, sink);
+	}
 
-		if( !is_directory(outputDirectory) )
-			throw runtime_error(openErrorMsg(outputPath));
+	FileConversion decode(const fs::path& inputPath, const fs::path& outputPath, IoEngine engine) {
+		FileError error;
+		auto conversion = decode(inputPath, outputPath, engine, error);
 
-		auto operations = loadOperations(inputPath);
+		if( error )
+			throwFileError(error, inputPath, outputPath, conversion);
+		return conversion;
+	}
 
-		for( auto& op : operations ) {
-			try {
-				encode(op.path, format, outputDirectory / getRelativePath(op.path, inputPath));
-			}
-			catch( const exception& ex ) {
-				op.error = ex.what();
-			}
+	FileConversion decode(const fs::path& inputPath, const fs::path& outputPath, IoEngine engine, FileError& error) {
+		FileConversion conversion;
+		const auto probe = probeFormat(inputPath);
+
+		if( !probe ) {
+			error = { CodecErrc::Open };
+			return conversion;
 		}
 
-		return operations;
-	}
+		const auto format = probe.value();
+		const auto offset = static_cast<uintmax_t>(format == AudioFormat::None ? 0 : sizeOfHeader(format));
 
-	void decode(const fs::path& inputPath, const fs::path& outputPath) {
-		ifstream input(inputPath, ios::binary);
+		conversion.outputPath = fs::path(outputPath).replace_extension(getDecodeExtension(format));
+		conversion.format = format;
 
-		if( !input )
-			throw runtime_error(openErrorMsg(inputPath));
+		StagedFile output(conversion.outputPath, error);
 
-		auto tempPath = getTempPath();
-		ofstream output(tempPath, ios::binary);
+		if( error )
+			return conversion;
 
-		if( !output )
-			throw runtime_error(writeErrorMsg(tempPath));
+		const auto payload = transfer(inputPath, offset, {}, output, engine, error);
 
-		const auto format = formatOf(input);
+		if( error )
+			return conversion;
+		output.commit(error);
+		if( error )
+			return conversion;
+		removeReplaced(outputPath, conversion.outputPath, error);
+		if( error )
+			return conversion;
 
-		skipHeader(input, format);
-		copy(istreambuf_iterator(input), {}, ostreambuf_iterator(output));
-		input.close();
-		output.close();
+		conversion.bytesRead = offset + payload;
+		conversion.bytesWritten = payload;
+		return conversion;
+	}
 
-		if( exists(outputPath) ) {
-			error_code error;
+	DecodedBytes decode(ByteSpan input) noexcept {
+		const auto format = formatOf(input);
+		const auto offset = static_cast<size_t>(format == AudioFormat::None ? 0 : sizeOfHeader(format));
 
-			remove(outputPath, error);
+		return { input.subspan(offset), format };
+	}
 
-			if( error )
-				throw runtime_error(deleteErrorMsg(outputPath));
-		}
-		else if( !outputPath.parent_path().empty() ) {
-			create_directories(outputPath.parent_path());
-		}
+	size_t encodedSize(AudioFormat format, size_t payloadSize) {
+		if( format == AudioFormat::None )
+			throw runtime_error(formatErrorMsg);
 
-		rename(tempPath, fs::path(outputPath).replace_extension(getDecodeExtension(format)));
+		return static_cast<size_t>(sizeOfHeader(format)) + payloadSize;
 	}
 
-	vector<FileOperation> decodeAll(const fs::path& inputPath, const fs::path& outputPath) {
-		if( !exists(inputPath) )
-			throw runtime_error(openErrorMsg(inputPath));
+	size_t encode(ByteSpan input, AudioFormat format, MutableByteSpan output) {
+		const auto size = encodedSize(format, input.size());
 
-		const auto& outputDirectory = outputPath == "" ? inputPath : outputPath;
+		if( output.size() < size )
+			throw runtime_error(bufferErrorMsg);
 
-		if( !exists(outputDirectory) && !empty(outputDirectory) )
-			create_directories(outputDirectory);
+		const auto header = reinterpret_cast<const byte*>(getHeader(format));
+		const auto payload = copy(header, header + sizeOfHeader(format), output.data());
 
-		if( !is_directory(outputDirectory) )
-			throw runtime_error(openErrorMsg(outputPath));
+		if( !input.empty() )
+			memcpy(payload, input.data(), input.size());
+		return size;
+	}
 
-		auto operations = loadOperations(inputPath);
+	array<ByteSpan, 2> encodeScattered(ByteSpan input, AudioFormat format) {
+		if( format == AudioFormat::None )
+			throw runtime_error(formatErrorMsg);
 
-		for( auto& op : operations ) {
-			try {
-				decode(op.path, outputDirectory / getRelativePath(op.path, inputPath));
-			}
-			catch( exception& ex ) {
-				op.error = ex.what();
-			}
-		}
+		return { { { reinterpret_cast<const byte*>(getHeader(format)), static_cast<size_t>(sizeOfHeader(format)) }, input } };
+	}
 
-		return operations;
+	OperationTable decodeAll(const fs::path& inputPath, const fs::path& outputPath, const BatchOptions& options) {
+		OperationTable table;
+
+		runBatch(inputPath, prepareBatchOutput(inputPath, outputPath), nullopt, options, &table, {});
+		return table;
+	}
+
+	void decodeAll(const fs::path& inputPath, const fs::path& outputPath, const BatchOptions& options, const BatchSink& sink) {
+		runBatch(inputPath, prepareBatchOutput(inputPath, outputPath), nullopt, options, nullptr, sink);
 	}
 	void printHeaderSource(const fs::path& inputPath, ostream& output) {
 		try {
@@ -215,25 +778,66 @@ namespace SithCodec {
 		}
 	}
 
-	void printFormats(const fs::path& inputPath, ostream& output) {
+	void printFormats(const fs::path& inputPath, ostream& output, const ListOptions& options) {
 		const auto inputDirectory = inputPath == "" ? fs::current_path() : inputPath;
 
 		if( !exists(inputDirectory) || !is_directory(inputDirectory) )
 			throw runtime_error(openErrorMsg(inputDirectory));
 
-		output << inputDirectory.string() << '\n';
-		for( const auto& entry : fs::recursive_directory_iterator(inputDirectory) ) {
-			if( is_directory(entry.path()) ) {
-				output << indentLevel1 << entry.path().string() << '\n';
+		// Probing is latency bound, so more threads than CPUs pay off
+		const unsigned workers = options.jobs ? options.jobs : max(8U, defaultWorkerCount());
+		unique_ptr<ThreadPool> pool = workers > 1 ? make_unique<ThreadPool>(workers) : nullptr;
+		deque<shared_ptr<ListChunk>> pending;
+		auto chunk = make_shared<ListChunk>();
+
+		// Chunks are formatted by any thread but written strictly in walk order
+		const auto flush = [&](size_t limit) {
+			while( pending.size() > limit ) {
+				auto& front = *pending.front();
+
+				// Rethrows the failure of a chunk instead of waiting forever
+				front.done.get();
+				output.write(front.text.data(), static_cast<streamsize>(front.text.size()));
+				pending.pop_front();
 			}
-			else {
-				ifstream file(entry.path());
+		};
+		const auto submit = [&] {
+			if( chunk->entries.empty() )
+				return;
+
+			pending.push_back(chunk);
+			if( pool )
+				pool->submit([chunk, &options] { chunk->format(options.format); });
+			else
+				chunk->format(options.format);
+			chunk = make_shared<ListChunk>();
+			flush(pool ? 4 * pool->size() : 0);
+		};
+
+		{
+			string header;
+
+			appendListHeader(header, inputDirectory, options.format);
+			output.write(header.data(), static_cast<streamsize>(header.size()));
+		}
 
-				output << indentLevel2 << entry.path().filename().string() << ' ' << (file ? toString(formatOf(file)) : failMsg) << '\n';
-			}
+		try {
+			walkDirectory(inputDirectory, [&](const fs::path& entry, bool isDirectory) {
+				chunk->entries.push_back({ entry, isDirectory });
+				if( chunk->entries.size() == listChunkSize )
+					submit();
+			});
+		}
+		catch( ... ) {
+			// Let workers finish with the chunks they reference
+			pool.reset();
+			throw;
 		}
+
+		submit();
+		flush(0);
 	}
-	
+
 	void skipHeader(istream& input, AudioFormat format) {
 		switch( format ) {
 		case AudioFormat::SFX:
@@ -261,19 +865,55 @@ namespace SithCodec {
 			return AudioFormat::None;
 	}
 
+	AudioFormat formatOf(const char* data, size_t size) {
+		if( Header::sfxSize && size >= static_cast<size_t>(Header::sfxSize) && equal(data, data + Header::sfxSize, Header::sfx) )
+			return AudioFormat::SFX;
+		else if( Header::voSize && size >= static_cast<size_t>(Header::voSize) && equal(data, data + Header::voSize, Header::vo) )
+			return AudioFormat::VO;
+		else
+			return AudioFormat::None;
+	}
+
+	AudioFormat formatOf(ByteSpan data) noexcept {
+		return formatOf(reinterpret_cast<const char*>(data.data()), data.size());
+	}
+
+	optional<AudioFormat> probeFormat(const fs::path& path) {
+		TraceSpan span("formatOf");
+		char header[Header::maxSize];
+		size_t size = 0;
+
+#ifdef SITHCODEC_POSIX
+		FileDescriptor file(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+
+		if( !file )
+			return nullopt;
+
+		auto n = ::pread(file.get(), header, sizeof(header), 0);
+
+		while( n < 0 && errno == EINTR )
+			n = ::pread(file.get(), header, sizeof(header), 0);
+
+		size = n > 0 ? static_cast<size_t>(n) : 0;
+#else
+		ifstream file(path, ios::binary);
+
+		if( !file )
+			return nullopt;
+
+		file.read(header, sizeof(header));
+		size = static_cast<size_t>(file.gcount());
+#endif
+
+		return formatOf(header, size);
+	}
+
 	string toString(AudioFormat format) {
-		switch( format ) {
-		case AudioFormat::SFX:
-			return "SFX";
-		case AudioFormat::VO:
-			return "VO";
-		default:
-			return "None";
-		}
+		return getFormatName(format);
 	}
 
 	string getRandomString(string_view chars, string::size_type length) {
-		static auto rand = mt19937(random_device()());
+		thread_local auto rand = mt19937(random_device()());
 		auto dist = uniform_int_distribution(static_cast<string_view::size_type>(0), chars.length() - 1);
 		string str;
 
@@ -300,7 +940,11 @@ namespace SithCodec {
 	}
 
 	fs::path getRelativePath(const fs::path& path, const fs::path& directory) {
-		auto relativePath = relative(path, directory);
+		// Only a mix of absolute and relative paths needs the current
+		// directory; everything else is a comparison of path elements
+		const bool mixed = path.is_absolute() != directory.is_absolute();
+		const auto base = (mixed ? fs::absolute(directory) : directory).lexically_normal();
+		auto relativePath = (mixed ? fs::absolute(path) : path).lexically_normal().lexically_relative(base);
 
 		return relativePath.empty() ? path.filename() : relativePath;
 	}
@@ -309,6 +953,10 @@ namespace SithCodec {
 		return "Failed to open \"" + path.string() + "\".";
 	}
 
+	string readErrorMsg(const fs::path& path) {
+		return "Failed to read \"" + path.string() + "\".";
+	}
+
 	string eofErrorMsg(const fs::path& path) {
 		return "Reached end of \"" + path.string() + "\" before data could be read.";
 	}
@@ -320,4 +968,17 @@ namespace SithCodec {
 	string deleteErrorMsg(const fs::path& path) {
 		return "Failed to delete \"" + path.string() + "\".";
 	}
+
+	string errorMessage(const FileOperation& operation) {
+		const auto& error = operation.error;
+
+		switch( error.code ) {
+		case CodecErrc::Write:
+			return "Failed to write the output of \"" + operation.path.string() + "\".";
+		case CodecErrc::Delete:
+			return "Failed to delete the file replaced by the output of \"" + operation.path.string() + "\".";
+		default:
+			return errorMessage(error, operation.path);
+		}
+	}
 }
\ No newline at end of file
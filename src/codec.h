@@ -27,20 +27,28 @@
 #ifndef SITHCODEC_CODEC_H
 #define SITHCODEC_CODEC_H
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <functional>
 #include <iostream>
 #include <optional>
 #include <string>
 #include <string_view>
-#include <vector>
 
+#include "codecerror.h"
 #include "fileheaders.h"
+#include "iobackend.h"
+#include "operationtable.h"
+#include "threadpool.h"
 
  /**
   *	%SithCodec project namespace.
   */
 namespace SithCodec {
+	class BatchStats;
+
 	/**
 	 *	@brief Enumerator of KOTOR audio formats.
 	 */
@@ -51,17 +59,166 @@ namespace SithCodec {
 	};
 
 	/**
-		@brief Object containing a file path and an optional error message associated
-			   with the file operation.
+	 *	@brief View of elements held elsewhere, standing in for C++20's
+	 *		   std::span.
+	 */
+	template<class T>
+	class Span {
+	public:
+		constexpr Span() noexcept = default;
+		constexpr Span(T* data, std::size_t size) noexcept : first(data), count(size) {}
+
+		constexpr T* data() const noexcept { return first; }
+		constexpr std::size_t size() const noexcept { return count; }
+		constexpr bool empty() const noexcept { return count == 0; }
+		constexpr T* begin() const noexcept { return first; }
+		constexpr T* end() const noexcept { return first + count; }
+
+		/**
+		 *	@brief Gets the elements from offset on, which must not exceed
+		 *		   size().
+		 */
+		constexpr Span subspan(std::size_t offset) const noexcept { return { first + offset, count - offset }; }
+
+	private:
+		T* first = nullptr;
+		std::size_t count = 0;
+	};
+
+	using ByteSpan = Span<const std::byte>;
+	using MutableByteSpan = Span<std::byte>;
+
+	/**
+	 *	@brief Result of decode() over bytes in memory.
+	 */
+	struct DecodedBytes {
+		ByteSpan payload;	///< audio without its header, within the input
+		AudioFormat format = AudioFormat::None;	///< header found
+	};
+
+	/**
+	 *	@brief Result of encode() or decode().
+	 */
+	struct FileConversion {
+		std::filesystem::path outputPath;	///< path written, with the extension of the output format
+		AudioFormat format = AudioFormat::None;	///< header added by encode() or found by decode()
+		std::uintmax_t bytesRead = 0;
+		std::uintmax_t bytesWritten = 0;
+	};
+
+	/**
+	 *	@brief Outcome of one file in a batch.
+	 */
+	enum class FileOutcome {
+		Done,
+		Failed,
+		UpToDate,
+	};
+
+	/**
+	 *	@brief Function receiving the result of each file of a batch as soon
+	 *		   as it is finished.
+	 *	@details Called once per file, in completion order, from whichever
+	 *			 thread finished it, so possibly from several threads at
+	 *			 once. The operation and conversion are only valid during the
+	 *			 call. Up-to-date and failed files come with an empty
+	 *			 conversion but for its format.
+	 *
+	 *			 FileOperation::index numbers the files from 0 in the order
+	 *			 enumeration found them, the order loadOperations returns, so
+	 *			 a sink that needs that order can restore it, holding back
+	 *			 each result until the ones before it have arrived.
+	 *
+	 *	@param operation   the file, its error if any, and its sequence number
+	 *	@param outcome	   how the file ended
+	 *	@param conversion  what was written
+	 *	@param nanoseconds time the conversion took, or 0 if not measured
 	 */
-	struct FileOperation {
-		std::filesystem::path path;
-		std::optional<std::string> error;
+	using BatchSink = std::function<void(const FileOperation& operation, FileOutcome outcome, const FileConversion& conversion,
+		std::uint64_t nanoseconds)>;
+
+	/**
+	 *	@brief Enumerator of output layouts for printFormats().
+	 */
+	enum class ListFormat {
+		Text,		///< indented, human-readable tree
+		Csv,		///< one "path,type,format" row per entry
+		JsonLines,	///< one JSON object per entry
+	};
+
+	/**
+	 *	@brief Settings for printFormats().
+	 */
+	struct ListOptions {
+		/**
+		 *	@brief Output layout.
+		 */
+		ListFormat format = ListFormat::Text;
+
+		/**
+		 *	@brief Number of threads probing files, or 0 for a default suited
+		 *		   to network storage.
+		 */
+		unsigned jobs = 0;
+	};
+
+	/**
+	 *	@brief Settings for encodeAll() and decodeAll().
+	 */
+	struct BatchOptions {
+		/**
+		 *	@brief Number of worker threads, or 0 for defaultWorkerCount().
+		 */
+		unsigned jobs = 0;
+
+		/**
+		 *	@brief Engine used to copy each payload.
+		 */
+		IoEngine engine = IoEngine::Auto;
+
+		/**
+		 *	@brief Number of files kept in flight by IoEngine::Uring.
+		 */
+		unsigned queueDepth = 64;
+
+		/**
+		 *	@brief Path of the manifest recording earlier conversions, or empty
+		 *		   to convert every file.
+		 *	@details Files whose input and output are unchanged since they
+		 *			 were recorded are skipped. The manifest is rewritten at the
+		 *			 end of the batch.
+		 */
+		std::filesystem::path manifest;
+
+		/**
+		 *	@brief Whether the manifest includes content hashes, so that inputs
+		 *		   touched without being changed are still skipped.
+		 */
+		bool hashContents = false;
+
+		/**
+		 *	@brief Statistics fed with every file of the batch, or null.
+		 */
+		BatchStats* stats = nullptr;
+
+		/**
+		 *	@brief Whether stats also counts the input bytes queued and
+		 *		   finished, for progress in bytes.
+		 *	@details Costs a stat of every file on the enumerating thread,
+		 *			 which on network storage can slow enumeration down; off,
+		 *			 BatchStats::bytesQueued() stays 0.
+		 */
+		bool sizeInputs = false;
 	};
 
 	constexpr const char* mp3 = ".mp3";
 	constexpr const char* wav = ".wav";
 
+	/**
+	 *	@brief Number of enumerated files a batch may queue ahead of the workers.
+	 */
+	constexpr std::size_t pipelineCapacity = 4096;
+
 	constexpr const char* indentLevel1 = "  ";
 	constexpr const char* indentLevel2 = "    ";
 
@@ -70,27 +227,59 @@ namespace SithCodec {
 	 *
 	 *	@param path path to a file containing a list of paths, or a folder
 	 *
-	 *	@return vector of FileOperaiton objects without error messages
+	 *	@return table of the files, all pending
 	 */
-	std::vector<FileOperation> loadOperations(const std::filesystem::path& path);
+	OperationTable loadOperations(const std::filesystem::path& path);
 
 	/**
 	 *	@brief Loads list of file operations from a folder.
 	 *
 	 *	@param path path of folder
 	 *
-	 *	@return vector of FileOperaiton objects without error messages
+	 *	@return table of the files, all pending
 	 */
-	std::vector<FileOperation> loadOperationsFromFolder(const std::filesystem::path& path);
+	OperationTable loadOperationsFromFolder(const std::filesystem::path& path);
 
 	/**
 	 *	@brief Loads list of file operations from a file.
+	 *	@details The list is read with ListFile: LF or CRLF endings, blank
+	 *			 lines skipped.
 	 *
 	 *	@param path path to a file containing a list of paths
 	 *
-	 *	@return vector of FileOperaiton objects without error messages
+	 *	@return table of the files, all pending
 	 */
-	std::vector<FileOperation> loadOperationsFromFile(const std::filesystem::path& path);
+	OperationTable loadOperationsFromFile(const std::filesystem::path& path);
+
+	/**
+	 *	@brief Visits every path loadOperations() would return, as soon as it
+	 *		   is found.
+	 *
+	 *	@param path	 path to a file containing a list of paths, or a folder
+	 *	@param visit function called with each path, in order
+	 *
+	 *	@throws runtime_error
+	 */
+	void enumerateOperations(const std::filesystem::path& path, const std::function<void(std::filesystem::path)>& visit);
+
+	/**
+	 *	@brief Visits every file in a folder, recursively, as soon as it is found.
+	 *
+	 *	@param path	 path of folder
+	 *	@param visit function called with each path
+	 */
+	void enumerateOperationsFromFolder(const std::filesystem::path& path, const std::function<void(std::filesystem::path)>& visit);
+
+	/**
+	 *	@brief Visits every path listed in a file, as soon as it is read.
+	 *	@details The list is read as by loadOperationsFromFile().
+	 *
+	 *	@param path	 path to a file containing a list of paths
+	 *	@param visit function called with each path, in order
+	 *
+	 *	@throws runtime_error
+	 */
+	void enumerateOperationsFromFile(const std::filesystem::path& path, const std::function<void(std::filesystem::path)>& visit);
 
 	/**
 	 *	@brief Encodes a given file in a given format.
@@ -100,10 +289,29 @@ namespace SithCodec {
 	 *	@param outputPath optional path of the final output file
 	 *					  (default argument will use inputPath and potentially
 	 *					  overwrite)
+	 *	@param engine	  engine used to copy the payload
+	 *
+	 *	@return path of the file written, with the format and bytes copied
 	 *
 	 *	@throws runtime_error
 	 */
-	void encode(const std::filesystem::path& inputPath, AudioFormat format, const std::filesystem::path& outputPath = "");
+	FileConversion encode(const std::filesystem::path& inputPath, AudioFormat format, const std::filesystem::path& outputPath = "", IoEngine engine = IoEngine::Auto);
+
+	/**
+	 *	@brief Encodes a given file in a given format, without throwing.
+	 *	@details Failures cost neither an exception nor a message; the
+	 *			 outputPath of the result is set as soon as it is known.
+	 *
+	 *	@param inputPath  path of the input file
+	 *	@param format	  format of output audio file
+	 *	@param outputPath path of the final output file
+	 *	@param engine	  engine used to copy the payload
+	 *	@param error	  set on failure
+	 *
+	 *	@return path of the file written, with the format and bytes copied
+	 */
+	FileConversion encode(const std::filesystem::path& inputPath, AudioFormat format, const std::filesystem::path& outputPath,
+		IoEngine engine, FileError& error);
 
 	/**
 	 *	@brief Encodes all of the files included in a given list of files.
@@ -114,12 +322,34 @@ namespace SithCodec {
 	 *	@param outputPath optional path of the final output file
 	 *					  (default argument will use inputPath and potentially
 	 *					  overwrite)
+	 *	@param options	  batch settings
 	 *
-	 *	@return vector of file paths with optional error messages if something went wrong
+	 *	@return table of the files in the order they were loaded, with the
+	 *			status and error of each
 	 *
 	 *	@throws runtime_error
 	 */
-	std::vector<FileOperation> encodeAll(const std::filesystem::path& inputPath, AudioFormat format, const std::filesystem::path& outputPath = "");
+	OperationTable encodeAll(const std::filesystem::path& inputPath, AudioFormat format, const std::filesystem::path& outputPath = "", const BatchOptions& options = {});
+
+	/**
+	 *	@brief Encodes all of the files included in a given list of files,
+	 *		   streaming each result to a sink instead of keeping them.
+	 *	@details Memory stays bounded however many files there are. An
+	 *			 output directory inside the input folder is left out of the
+	 *			 files to encode.
+	 *
+	 *	@param inputPath  path of the list that contains the names of the files
+	 *					  that we want to encode, or a folder
+	 *	@param format	  format of output audio file
+	 *	@param outputPath path of the output folder, or empty to write beside
+	 *					  the inputs
+	 *	@param options	  batch settings
+	 *	@param sink		  function receiving the result of each file
+	 *
+	 *	@throws runtime_error
+	 */
+	void encodeAll(const std::filesystem::path& inputPath, AudioFormat format, const std::filesystem::path& outputPath,
+		const BatchOptions& options, const BatchSink& sink);
 
 	/**
 	 *	@brief Decodes a given file.
@@ -128,10 +358,75 @@ namespace SithCodec {
 	 *	@param outputPath optional path of the final output file
 	 *					  (default argument will use inputPath and potentially
 	 *					  overwrite)
+	 *	@param engine	  engine used to copy the payload
+	 *
+	 *	@return path of the file written, with the format found and bytes copied
 	 *
 	 *	@throws runtime_error
 	 */
-	void decode(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath = "");
+	FileConversion decode(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath = "", IoEngine engine = IoEngine::Auto);
+
+	/**
+	 *	@brief Decodes a given file, without throwing.
+	 *	@details Failures cost neither an exception nor a message; the
+	 *			 outputPath of the result is set as soon as it is known.
+	 *
+	 *	@param inputPath  path of the input file
+	 *	@param outputPath path of the final output file
+	 *	@param engine	  engine used to copy the payload
+	 *	@param error	  set on failure
+	 *
+	 *	@return path of the file written, with the format found and bytes copied
+	 */
+	FileConversion decode(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath, IoEngine engine,
+		FileError& error);
+
+	/**
+	 *	@brief Decodes audio held in memory, without copying it.
+	 *
+	 *	@param input encoded audio
+	 *
+	 *	@return the part of input that follows its header, or all of it if no
+	 *			header was found, with the format found
+	 */
+	DecodedBytes decode(ByteSpan input) noexcept;
+
+	/**
+	 *	@brief Gets the size of audio held in memory once encoded.
+	 *
+	 *	@param format	   format to encode in
+	 *	@param payloadSize number of bytes of audio
+	 *
+	 *	@return number of bytes, header included
+	 */
+	std::size_t encodedSize(AudioFormat format, std::size_t payloadSize);
+
+	/**
+	 *	@brief Encodes audio held in memory into a buffer.
+	 *
+	 *	@param input  audio to encode
+	 *	@param format format to encode in
+	 *	@param output buffer of at least encodedSize() bytes
+	 *
+	 *	@return number of bytes written
+	 *
+	 *	@throws runtime_error if format is AudioFormat::None or output is too
+	 *			small
+	 */
+	std::size_t encode(ByteSpan input, AudioFormat format, MutableByteSpan output);
+
+	/**
+	 *	@brief Encodes audio held in memory without copying it, as the pieces
+	 *		   of the output in order, such as for writev().
+	 *
+	 *	@param input  audio to encode
+	 *	@param format format to encode in
+	 *
+	 *	@return the header, in static storage, then input
+	 *
+	 *	@throws runtime_error if format is AudioFormat::None
+	 */
+	std::array<ByteSpan, 2> encodeScattered(ByteSpan input, AudioFormat format);
 
 	/**
 	 *	@brief Decodes all of the files included in a given list of files.
@@ -141,12 +436,31 @@ namespace SithCodec {
 	 *	@param outputPath optional path of the final output file
 	 *					  (default argument will use inputPath and potentially
 	 *					  overwrite)
+	 *	@param options	  batch settings
+	 *
+	 *	@return table of the files in the order they were loaded, with the
+	 *			status and error of each
+	 *
+	 *	@throws runtime_error
+	 */
+	OperationTable decodeAll(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath = "", const BatchOptions& options = {});
+
+	/**
+	 *	@brief Decodes all of the files included in a given list of files,
+	 *		   streaming each result to a sink instead of keeping them.
+	 *	@details Memory stays bounded as with the streaming encodeAll().
 	 *
-	 *	@return vector of file paths with optional error messages if something went wrong
+	 *	@param inputPath  path of the list that contains the names of the files
+	 *					  that we want to decode, or a folder
+	 *	@param outputPath path of the output folder, or empty to write beside
+	 *					  the inputs
+	 *	@param options	  batch settings
+	 *	@param sink		  function receiving the result of each file
 	 *
 	 *	@throws runtime_error
 	 */
-	std::vector<FileOperation> decodeAll(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath = "");
+	void decodeAll(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath, const BatchOptions& options,
+		const BatchSink& sink);
 
 	/**
 	 *	@brief Prints individual bytes of a header as hex numbers.
@@ -159,13 +473,16 @@ namespace SithCodec {
 
 	/**
 	 *	@brief Prints the format of every file in a given directory.
+	 *	@details Files are probed in parallel; the output is in walk order
+	 *			 regardless of the number of threads.
 	 *
 	 *	@param inputPath  path of directory containing audio files
 	 *	@param outputPath path of output file, or empty string for cout
+	 *	@param options	  list settings
 	 *
 	 *	@throws runtime_error
 	 */
-	void printFormats(const std::filesystem::path& inputPath, std::ostream& output = std::cout);
+	void printFormats(const std::filesystem::path& inputPath, std::ostream& output = std::cout, const ListOptions& options = {});
 
 	/**
 	 *	@brief Gets the bytes of an audio format's header.
@@ -204,6 +521,44 @@ namespace SithCodec {
 	 */
 	AudioFormat formatOf(std::istream& input);
 
+	/**
+	 *	@brief Determines the audio format of the first bytes of a file.
+	 *
+	 *	@param data first bytes of the file
+	 *	@param size number of bytes available, up to Header::maxSize are used
+	 *
+	 *	@return audio format
+	 */
+	AudioFormat formatOf(const char* data, std::size_t size);
+
+	/**
+	 *	@brief Determines the audio format of bytes in memory.
+	 *
+	 *	@param data first bytes of the file, up to Header::maxSize are used
+	 *
+	 *	@return audio format
+	 */
+	AudioFormat formatOf(ByteSpan data) noexcept;
+
+	/**
+	 *	@brief Determines the audio format of a file with a single read of
+	 *		   its header.
+	 *
+	 *	@param path path of file
+	 *
+	 *	@return audio format, or nothing if the file cannot be opened
+	 */
+	std::optional<AudioFormat> probeFormat(const std::filesystem::path& path);
+
+	/**
+	 *	@brief Gets the human-readable name of an audio format.
+	 *
+	 *	@param format audio format
+	 *
+	 *	@return name
+	 */
+	constexpr const char* getFormatName(AudioFormat format);
+
 	/**
 	 *	@brief Converts an audio format to a human-readable string.
 	 *
@@ -215,6 +570,7 @@ namespace SithCodec {
 
 	/**
 		@brief Generates a random string.
+		@details Safe to call from multiple threads.
 
 		@param chars  characters to choose from
 		@param length length of output string
@@ -225,6 +581,7 @@ namespace SithCodec {
 
 	/**
 		@brief Generates a new, unique path in the user's temp folder.
+		@details Safe to call from multiple threads.
 
 		@return temporary file path
 	 */
@@ -237,6 +594,8 @@ namespace SithCodec {
 	 *	@param path directory to remove
 	 *
 	 *	@note if directory is totally unrelated to path, returns filename only
+	 *	@note The computation is lexical and does not query the filesystem, so
+	 *		  symbolic links are not resolved.
 	 *
 	 *	@return relative portion of path
 	 */
@@ -269,6 +628,15 @@ namespace SithCodec {
 	 */
 	std::string openErrorMsg(const std::filesystem::path& path);
 
+	/**
+	 *	@brief Error message for failure to read a file that was opened.
+	 *
+	 *	@param path path that raised error
+	 *
+	 *	@return string
+	 */
+	std::string readErrorMsg(const std::filesystem::path& path);
+
 	/**
 	 *	@brief End of file error message.
 	 *
@@ -297,9 +665,22 @@ namespace SithCodec {
 	std::string deleteErrorMsg(const std::filesystem::path& path);
 
 	constexpr const char* formatErrorMsg = "invalid audio format";
+	constexpr const char* bufferErrorMsg = "output buffer too small";
+
+	/**
+	 *	@brief Renders the error of a batch file operation.
+	 *	@details Batches keep only the input path, so errors concerning the
+	 *			 output name the input it was converted from.
+	 *
+	 *	@param operation file operation
+	 *
+	 *	@return message, or an empty string if the operation succeeded
+	 */
+	std::string errorMessage(const FileOperation& operation);
 
 	constexpr const char* failMsg = "failed!";
 	constexpr const char* successMsg = "done!";
+	constexpr const char* upToDateMsg = "up to date";
 
 	constexpr const char* getHeader(AudioFormat format) {
 		switch( format ) {
@@ -323,6 +704,17 @@ namespace SithCodec {
 		}
 	}
 
+	constexpr const char* getFormatName(AudioFormat format) {
+		switch( format ) {
+		case AudioFormat::SFX:
+			return "SFX";
+		case AudioFormat::VO:
+			return "VO";
+		default:
+			return "None";
+		}
+	}
+
 	constexpr const char* getEncodeExtension(AudioFormat format) {
 		return wav;
 	}
@@ -0,0 +1,118 @@
+/**
+ *	@file codecerror.cpp
+ *	@brief Compact errors of encoding and decoding, for the non-throwing API.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "codecerror.h"
+
+#include "codec.h"
+
+namespace SithCodec {
+	namespace fs = std::filesystem;
+	using namespace std;
+
+	namespace {
+		class CodecCategory : public error_category {
+		public:
+			const char* name() const noexcept override {
+				return "sithcodec";
+			}
+
+			string message(int value) const override {
+				switch( static_cast<CodecErrc>(value) ) {
+				case CodecErrc::None:
+					return "success";
+				case CodecErrc::Open:
+					return "cannot open input";
+				case CodecErrc::Read:
+					return "cannot read input";
+				case CodecErrc::Write:
+					return "cannot write output";
+				case CodecErrc::Delete:
+					return "cannot delete replaced output";
+				case CodecErrc::Format:
+					return formatErrorMsg;
+				case CodecErrc::Memory:
+					return "out of memory";
+				default:
+					return "conversion failed";
+				}
+			}
+		};
+	}
+
+	const error_category& codecCategory() noexcept {
+		static const CodecCategory category;
+
+		return category;
+	}
+
+	error_code make_error_code(CodecErrc code) noexcept {
+		return { static_cast<int>(code), codecCategory() };
+	}
+
+	const char* getErrorName(CodecErrc code) noexcept {
+		switch( code ) {
+		case CodecErrc::None:
+			return "none";
+		case CodecErrc::Open:
+			return "open";
+		case CodecErrc::Read:
+			return "read";
+		case CodecErrc::Write:
+			return "write";
+		case CodecErrc::Delete:
+			return "delete";
+		case CodecErrc::Format:
+			return "format";
+		case CodecErrc::Memory:
+			return "memory";
+		default:
+			return "other";
+		}
+	}
+
+	string errorMessage(const FileError& error, const fs::path& path) {
+		switch( error.code ) {
+		case CodecErrc::None:
+			return {};
+		case CodecErrc::Open:
+			return openErrorMsg(path);
+		case CodecErrc::Read:
+			return readErrorMsg(path);
+		case CodecErrc::Write:
+			return writeErrorMsg(path);
+		case CodecErrc::Delete:
+			return deleteErrorMsg(path);
+		case CodecErrc::Format:
+			return formatErrorMsg;
+		case CodecErrc::Memory:
+			return "Ran out of memory converting \"" + path.string() + "\".";
+		default:
+			// The errno is all that is left of the cause
+			if( error.systemError )
+				return "Failed to convert \"" + path.string() + "\": " + system_category().message(error.systemError) + ".";
+			return "Failed to convert \"" + path.string() + "\".";
+		}
+	}
+}
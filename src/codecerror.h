@@ -0,0 +1,98 @@
+/**
+ *	@file codecerror.h
+ *	@brief Compact errors of encoding and decoding, for the non-throwing API.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_CODECERROR_H
+#define SITHCODEC_CODECERROR_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+namespace SithCodec {
+	/**
+	 *	@brief Enumerator of the ways converting a file can fail.
+	 */
+	enum class CodecErrc : std::uint8_t {
+		None,	///< no error
+		Open,	///< the input could not be opened
+		Read,	///< the input was opened but reading it failed
+		Write,	///< the output could not be created, written or published
+		Delete,	///< the file the output replaced could not be deleted
+		Format,	///< no audio format was given to encode in
+		Memory,	///< memory ran out
+		Other,	///< anything else; the errno, if any, says why
+	};
+
+	/**
+	 *	@brief Error of one file: what failed and, if the system said why,
+	 *		   its errno. Eight bytes, and no message until one is asked for.
+	 */
+	struct FileError {
+		CodecErrc code = CodecErrc::None;
+		int systemError = 0;	///< errno of the failed call, or 0
+
+		explicit operator bool() const noexcept { return code != CodecErrc::None; }
+	};
+
+	/**
+	 *	@brief Gets the category of CodecErrc values in std::error_code.
+	 */
+	const std::error_category& codecCategory() noexcept;
+
+	/**
+	 *	@brief Makes a std::error_code from a CodecErrc; found by argument
+	 *		   dependent lookup, so CodecErrc values compare with error codes.
+	 */
+	std::error_code make_error_code(CodecErrc code) noexcept;
+
+	/**
+	 *	@brief Gets a short, stable name of an error, for machine-readable
+	 *		   output.
+	 *
+	 *	@param code error
+	 *
+	 *	@return lowercase name, such as "open"
+	 */
+	const char* getErrorName(CodecErrc code) noexcept;
+
+	/**
+	 *	@brief Renders the message of an error, as thrown by the throwing
+	 *		   API.
+	 *
+	 *	@param error error
+	 *	@param path	 file the error concerns: the output for CodecErrc::Write
+	 *				 and CodecErrc::Delete, the input otherwise
+	 *
+	 *	@return message, or an empty string if there is no error
+	 */
+	std::string errorMessage(const FileError& error, const std::filesystem::path& path);
+}
+
+template<>
+struct std::is_error_code_enum<SithCodec::CodecErrc> : std::true_type {};
+
+#endif
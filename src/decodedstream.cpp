@@ -0,0 +1,204 @@
+/**
+ *	@file decodedstream.cpp
+ *	@brief Random-access reading of the audio inside an encoded file.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "decodedstream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef SITHCODEC_POSIX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace SithCodec {
+	namespace fs = std::filesystem;
+	using namespace std;
+
+	DecodedStreamBuf::DecodedStreamBuf(const fs::path& path) : path(path), buffer(new char[decodedBufferSize]) {
+		uintmax_t fileSize = 0;
+
+#ifdef SITHCODEC_POSIX
+		file = FileDescriptor(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+
+		struct stat info;
+
+		if( !file || ::fstat(file.get(), &info) != 0 )
+			throw runtime_error(openErrorMsg(path));
+		fileSize = static_cast<uintmax_t>(info.st_size);
+#else
+		file.open(path, ios::binary);
+		if( !file )
+			throw runtime_error(openErrorMsg(path));
+		fileSize = fs::file_size(path);
+#endif
+
+		// The header is found with one read, into the buffer it is then dropped from
+		const auto probed = readAt(0, buffer.get(), static_cast<size_t>(Header::maxSize));
+
+		audioFormat = formatOf(buffer.get(), probed);
+		headerSize = audioFormat == AudioFormat::None ? 0 : static_cast<uintmax_t>(sizeOfHeader(audioFormat));
+		payloadSize = fileSize - headerSize;
+		setg(buffer.get(), buffer.get(), buffer.get());
+	}
+
+	DecodedStreamBuf::int_type DecodedStreamBuf::underflow() {
+		if( gptr() < egptr() )
+			return traits_type::to_int_type(*gptr());
+
+		const auto next = bufferEnd();
+
+		if( next >= payloadSize )
+			return traits_type::eof();
+
+		const auto count = static_cast<size_t>(min<uintmax_t>(decodedBufferSize, payloadSize - next));
+		const auto read = readAt(next, buffer.get(), count);
+
+		bufferStart = next;
+		setg(buffer.get(), buffer.get(), buffer.get() + read);
+		return read ? traits_type::to_int_type(*gptr()) : traits_type::eof();
+	}
+
+	streamsize DecodedStreamBuf::xsgetn(char_type* data, streamsize count) {
+		streamsize copied = 0;
+
+		while( copied < count ) {
+			const auto available = egptr() - gptr();
+
+			if( available > 0 ) {
+				const auto chunk = min<streamsize>(available, count - copied);
+
+				memcpy(data + copied, gptr(), static_cast<size_t>(chunk));
+				gbump(static_cast<int>(chunk));
+				copied += chunk;
+				continue;
+			}
+
+			const auto next = bufferEnd();
+
+			if( next >= payloadSize )
+				break;
+
+			const auto wanted = static_cast<uintmax_t>(count - copied);
+
+			if( wanted < decodedBufferSize ) {
+				if( traits_type::eq_int_type(underflow(), traits_type::eof()) )
+					break;
+				continue;
+			}
+
+			// Large reads skip the buffer and go straight into the caller's memory
+			const auto read = readAt(next, data + copied, static_cast<size_t>(min(wanted, payloadSize - next)));
+
+			if( read == 0 )
+				break;
+			bufferStart = next + read;
+			setg(buffer.get(), buffer.get(), buffer.get());
+			copied += static_cast<streamsize>(read);
+		}
+		return copied;
+	}
+
+	streamsize DecodedStreamBuf::showmanyc() {
+		const auto next = bufferEnd();
+
+		return next < payloadSize ? static_cast<streamsize>(payloadSize - next) : -1;
+	}
+
+	DecodedStreamBuf::pos_type DecodedStreamBuf::seekoff(off_type offset, ios_base::seekdir direction, ios_base::openmode which) {
+		const pos_type failed(off_type(-1));
+
+		if( !(which & ios_base::in) )
+			return failed;
+
+		off_type base = 0;
+
+		if( direction == ios_base::cur )
+			base = static_cast<off_type>(bufferStart) + (gptr() - eback());
+		else if( direction == ios_base::end )
+			base = static_cast<off_type>(payloadSize);
+
+		const auto target = base + offset;
+
+		if( target < 0 || static_cast<uintmax_t>(target) > payloadSize )
+			return failed;
+
+		const auto position = static_cast<uintmax_t>(target);
+
+		// Within the buffer the bytes are kept; elsewhere the next read refills it
+		if( position >= bufferStart && position <= bufferEnd() ) {
+			setg(eback(), eback() + (position - bufferStart), egptr());
+		}
+		else {
+			bufferStart = position;
+			setg(buffer.get(), buffer.get(), buffer.get());
+		}
+		return pos_type(target);
+	}
+
+	DecodedStreamBuf::pos_type DecodedStreamBuf::seekpos(pos_type position, ios_base::openmode which) {
+		return seekoff(off_type(position), ios_base::beg, which);
+	}
+
+	size_t DecodedStreamBuf::readAt(uintmax_t offset, char* data, size_t count) {
+		const auto start = offset + headerSize;
+		size_t done = 0;
+
+#ifdef SITHCODEC_POSIX
+		while( done < count ) {
+			const auto n = ::pread(file.get(), data + done, count - done, static_cast<off_t>(start + done));
+
+			if( n < 0 ) {
+				if( errno == EINTR )
+					continue;
+				throw runtime_error(readErrorMsg(path));
+			}
+			if( n == 0 )
+				break;
+			done += static_cast<size_t>(n);
+		}
+#else
+		file.clear();
+		if( !file.seekg(static_cast<streamoff>(start)) )
+			throw runtime_error(readErrorMsg(path));
+		file.read(data, static_cast<streamsize>(count));
+		if( file.bad() )
+			throw runtime_error(readErrorMsg(path));
+		done = static_cast<size_t>(file.gcount());
+#endif
+		return done;
+	}
+
+	uintmax_t DecodedStreamBuf::bufferEnd() const noexcept {
+		return bufferStart + static_cast<uintmax_t>(egptr() - eback());
+	}
+
+	DecodedStream::DecodedStream(const fs::path& path) : istream(nullptr), buffer(path) {
+		rdbuf(&buffer);
+	}
+}
@@ -0,0 +1,141 @@
+/**
+ *	@file decodedstream.h
+ *	@brief Random-access reading of the audio inside an encoded file.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_DECODEDSTREAM_H
+#define SITHCODEC_DECODEDSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <streambuf>
+
+#include "codec.h"
+
+namespace SithCodec {
+	/**
+	 *	@brief Size of the read buffer of a DecodedStreamBuf.
+	 */
+	constexpr std::size_t decodedBufferSize = 64 * 1024;
+
+	/**
+	 *	@brief Read-only stream buffer presenting a file as decode() would
+	 *		   write it, without writing anything.
+	 *	@details Offsets are those of the decoded audio: the header is
+	 *			 skipped by adding its size to every read. On POSIX systems
+	 *			 reads are made with pread, so seeking costs no system call,
+	 *			 and reads of at least decodedBufferSize bytes go straight into
+	 *			 the caller's memory. A file with no known header is presented
+	 *			 whole, as decode() copies it.
+	 */
+	class DecodedStreamBuf : public std::streambuf {
+	public:
+		/**
+		 *	@brief Opens a file and finds its header.
+		 *
+		 *	@param path path of the encoded file
+		 *
+		 *	@throws runtime_error if the file cannot be opened or read
+		 */
+		explicit DecodedStreamBuf(const std::filesystem::path& path);
+
+		DecodedStreamBuf(const DecodedStreamBuf&) = delete;
+		DecodedStreamBuf& operator=(const DecodedStreamBuf&) = delete;
+
+		/**
+		 *	@brief Gets the format of the header found.
+		 */
+		AudioFormat format() const noexcept { return audioFormat; }
+
+		/**
+		 *	@brief Gets the size of the decoded audio.
+		 *
+		 *	@return number of bytes
+		 */
+		std::uintmax_t size() const noexcept { return payloadSize; }
+
+	protected:
+		int_type underflow() override;
+		std::streamsize xsgetn(char_type* data, std::streamsize count) override;
+		std::streamsize showmanyc() override;
+		pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override;
+		pos_type seekpos(pos_type position, std::ios_base::openmode which) override;
+
+	private:
+		/**
+		 *	@brief Reads decoded bytes, retrying short reads.
+		 *
+		 *	@return number of bytes read, less than count only at the end of
+		 *			the file
+		 *
+		 *	@throws runtime_error if the file cannot be read
+		 */
+		std::size_t readAt(std::uintmax_t offset, char* data, std::size_t count);
+
+		/**
+		 *	@brief Gets the decoded offset of the end of the buffered bytes.
+		 */
+		std::uintmax_t bufferEnd() const noexcept;
+
+		std::filesystem::path path;
+#ifdef SITHCODEC_POSIX
+		FileDescriptor file;
+#else
+		std::ifstream file;
+#endif
+		AudioFormat audioFormat = AudioFormat::None;
+		std::uintmax_t headerSize = 0;
+		std::uintmax_t payloadSize = 0;
+		std::uintmax_t bufferStart = 0;	///< decoded offset of eback()
+		std::unique_ptr<char[]> buffer;
+	};
+
+	/**
+	 *	@brief Input stream over the decoded audio of a file, with
+	 *		   random access through seekg() and tellg().
+	 *	@details See DecodedStreamBuf.
+	 */
+	class DecodedStream : public std::istream {
+	public:
+		/**
+		 *	@brief Opens a file.
+		 *
+		 *	@param path path of the encoded file
+		 *
+		 *	@throws runtime_error if the file cannot be opened or read
+		 */
+		explicit DecodedStream(const std::filesystem::path& path);
+
+		AudioFormat format() const noexcept { return buffer.format(); }
+		std::uintmax_t size() const noexcept { return buffer.size(); }
+
+	private:
+		DecodedStreamBuf buffer;
+	};
+}
+
+#endif
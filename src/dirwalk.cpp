@@ -0,0 +1,312 @@
+/**
+ *	@file dirwalk.cpp
+ *	@brief Recursive directory walker that reads directories in parallel.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "dirwalk.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "iobackend.h"
+#include "threadpool.h"
+
+#ifdef SITHCODEC_POSIX
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace SithCodec {
+	namespace fs = std::filesystem;
+	using namespace std;
+
+	namespace {
+		struct Node;
+
+		/**
+		 *	@brief One directory entry as read from its parent.
+		 */
+		struct Entry {
+			string name;
+			bool directory = false;
+			shared_ptr<Node> child;	///< set for directories that are descended into
+		};
+
+		/**
+		 *	@brief A directory whose entries are read once, by whichever thread
+		 *		   gets to it first.
+		 */
+		struct Node {
+			enum class State {
+				Idle,
+				Queued,
+				Reading,
+				Done,
+			};
+
+			explicit Node(fs::path path) : path(move(path)) {}
+
+			fs::path path;
+			vector<Entry> entries;
+			error_code error;
+			std::mutex guard;
+			condition_variable done;
+			State state = State::Idle;
+			bool prefetched = false;
+		};
+
+#ifdef SITHCODEC_POSIX
+		/**
+		 *	@brief Determines whether an entry is a directory and whether to
+		 *		   descend into it, without a stat when d_type suffices.
+		 */
+		void classify(int directoryFd, const dirent& entry, Entry& result) {
+			unsigned char type = entry.d_type;
+
+			if( type == DT_UNKNOWN ) {
+#ifdef STATX_TYPE
+				struct statx info;
+
+				if( ::statx(directoryFd, entry.d_name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, STATX_TYPE, &info) == 0 )
+					type = S_ISDIR(info.stx_mode) ? DT_DIR : S_ISLNK(info.stx_mode) ? DT_LNK : DT_REG;
+#else
+				struct stat info;
+
+				if( ::fstatat(directoryFd, entry.d_name, &info, AT_SYMLINK_NOFOLLOW) == 0 )
+					type = S_ISDIR(info.st_mode) ? DT_DIR : S_ISLNK(info.st_mode) ? DT_LNK : DT_REG;
+#endif
+			}
+
+			if( type == DT_DIR ) {
+				result.directory = true;
+			}
+			else if( type == DT_LNK ) {
+				// Links count as their target, like is_directory(), but are not followed
+#ifdef STATX_TYPE
+				struct statx info;
+
+				result.directory = ::statx(directoryFd, entry.d_name, AT_NO_AUTOMOUNT, STATX_TYPE, &info) == 0
+					&& S_ISDIR(info.stx_mode);
+#else
+				struct stat info;
+
+				result.directory = ::fstatat(directoryFd, entry.d_name, &info, 0) == 0 && S_ISDIR(info.st_mode);
+#endif
+				return;
+			}
+
+			if( result.directory )
+				result.child = make_shared<Node>(fs::path());
+		}
+#endif
+
+		/**
+		 *	@brief Shared state of one walk.
+		 */
+		class Walk {
+		public:
+			explicit Walk(unsigned workers) {
+				if( workers > 1 )
+					pool = make_unique<ThreadPool>(workers);
+			}
+
+			~Walk() {
+				stopping = true;
+				pool.reset();
+			}
+
+			/**
+			 *	@brief Visits a directory's entries depth first.
+			 */
+			void emit(Node& node, const function<void(const fs::path&, bool)>& visit) {
+				claim(node);
+
+				if( node.error )
+					throw fs::filesystem_error("cannot read directory", node.path, node.error);
+
+				for( auto& entry : node.entries ) {
+					const auto path = node.path / entry.name;
+
+					visit(path, entry.directory);
+
+					if( entry.child ) {
+						emit(*entry.child, visit);
+						entry.child.reset();
+					}
+				}
+
+				node.entries = vector<Entry>();
+
+				if( node.prefetched )
+					--ahead;
+			}
+
+			/**
+			 *	@brief Reads a directory unless another thread has done so.
+			 */
+			void read(const shared_ptr<Node>& node) {
+				{
+					lock_guard lock(node->guard);
+
+					if( node->state != Node::State::Idle && node->state != Node::State::Queued )
+						return;
+					node->state = Node::State::Reading;
+				}
+
+				list(*node);
+
+				for( auto& entry : node->entries ) {
+					if( !entry.child )
+						continue;
+
+					entry.child->path = node->path / entry.name;
+					prefetch(entry.child);
+				}
+
+				{
+					lock_guard lock(node->guard);
+
+					node->state = Node::State::Done;
+				}
+				node->done.notify_all();
+			}
+
+		private:
+			/**
+			 *	@brief Makes sure a node's entries are available to the visitor.
+			 */
+			void claim(Node& node) {
+				unique_lock lock(node.guard);
+
+				if( node.state == Node::State::Idle || node.state == Node::State::Queued ) {
+					lock.unlock();
+					// Not started yet, so reading it here is quicker than waiting
+					read(shared_from(node));
+					return;
+				}
+
+				node.done.wait(lock, [&] { return node.state == Node::State::Done; });
+			}
+
+			/**
+			 *	@brief Hands a directory to a worker if readahead allows. The
+			 *		   slot is released once the visitor has finished with it.
+			 */
+			void prefetch(const shared_ptr<Node>& node) {
+				if( !pool || stopping || ahead >= walkReadahead )
+					return;
+
+				{
+					lock_guard lock(node->guard);
+
+					if( node->state != Node::State::Idle )
+						return;
+					node->state = Node::State::Queued;
+					node->prefetched = true;
+				}
+
+				++ahead;
+				pool->submit([this, node] { read(node); });
+			}
+
+			/**
+			 *	@brief Recovers the owning pointer for a node being claimed.
+			 *	@details Nodes are always owned by their parent's Entry or by
+			 *			 walkDirectory(), both of which outlive the claim, so a
+			 *			 non-owning alias is enough.
+			 */
+			static shared_ptr<Node> shared_from(Node& node) {
+				return shared_ptr<Node>(shared_ptr<Node>(), &node);
+			}
+
+			void list(Node& node) {
+#ifdef SITHCODEC_POSIX
+				DIR* directory = ::opendir(node.path.c_str());
+
+				if( !directory ) {
+					node.error = error_code(errno, generic_category());
+					return;
+				}
+
+				const int fd = ::dirfd(directory);
+
+				errno = 0;
+				while( const dirent* entry = ::readdir(directory) ) {
+					const char* name = entry->d_name;
+
+					if( name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')) )
+						continue;
+
+					Entry result;
+
+					result.name = name;
+					classify(fd, *entry, result);
+					node.entries.push_back(move(result));
+					// A dangling link fails the stat in classify(), which is no read error
+					errno = 0;
+				}
+
+				if( errno != 0 )
+					node.error = error_code(errno, generic_category());
+
+				::closedir(directory);
+#else
+				for( const auto& entry : fs::directory_iterator(node.path, node.error) ) {
+					Entry result;
+					error_code error;
+
+					result.name = entry.path().filename().string();
+					result.directory = entry.is_directory(error);
+					if( result.directory && !entry.is_symlink(error) )
+						result.child = make_shared<Node>(fs::path());
+					node.entries.push_back(move(result));
+				}
+#endif
+			}
+
+			unique_ptr<ThreadPool> pool;
+			atomic<size_t> ahead{ 0 };
+			atomic<bool> stopping{ false };
+		};
+	}
+
+	void walkDirectory(const fs::path& root, const function<void(const fs::path&, bool)>& visit, unsigned workers) {
+		// Directory reads are latency bound, so more threads than CPUs pay off
+		if( workers == 0 )
+			workers = max(8U, defaultWorkerCount());
+
+		auto node = make_shared<Node>(root);
+		Walk walk(workers);
+
+		walk.emit(*node, visit);
+	}
+}
@@ -0,0 +1,61 @@
+/**
+ *	@file dirwalk.h
+ *	@brief Recursive directory walker that reads directories in parallel.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_DIRWALK_H
+#define SITHCODEC_DIRWALK_H
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+
+namespace SithCodec {
+	/**
+	 *	@brief Maximum number of directories read ahead of the visitor.
+	 */
+	constexpr std::size_t walkReadahead = 256;
+
+	/**
+	 *	@brief Visits every entry below a directory.
+	 *	@details Entries are visited in the same order as
+	 *			 std::filesystem::recursive_directory_iterator: a directory
+	 *			 comes just before its contents, and siblings are in the order
+	 *			 the filesystem returns them. Worker threads read subdirectories
+	 *			 ahead of the visitor. On POSIX systems the entry type comes from
+	 *			 readdir's d_type, and a stat is made only for symbolic links
+	 *			 and filesystems that report no type. Symbolic links to
+	 *			 directories are reported as directories but not descended into.
+	 *
+	 *	@param root	   directory to walk
+	 *	@param visit   function called with each entry's path and whether it is
+	 *				   a directory, on the calling thread
+	 *	@param workers number of threads reading directories, or 0 for a default
+	 *				   suited to network storage; 1 reads on the calling thread
+	 *
+	 *	@throws filesystem_error if a directory cannot be read
+	 */
+	void walkDirectory(const std::filesystem::path& root, const std::function<void(const std::filesystem::path&, bool)>& visit, unsigned workers = 0);
+}
+
+#endif
@@ -0,0 +1,587 @@
+/**
+ *	@file iobackend.cpp
+ *	@brief Interchangeable engines for copying audio payloads between files.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "iobackend.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#ifdef SITHCODEC_POSIX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef SITHCODEC_LINUX
+#include <sys/sendfile.h>
+#endif
+
+#include "codec.h"
+#include "trace.h"
+
+namespace SithCodec {
+	namespace fs = std::filesystem;
+	using namespace std;
+
+	namespace {
+		/**
+		 *	@brief Gets a reusable copy buffer for the calling thread.
+		 *
+		 *	@return buffer of blockSize bytes
+		 */
+		vector<char>& blockBuffer() {
+			thread_local vector<char> buffer(blockSize);
+
+			return buffer;
+		}
+
+		/**
+		 *	@brief Creates a directory and its parents, tolerating other threads
+		 *		   doing the same.
+		 *
+		 *	@param directory path of directory
+		 *
+		 *	@return true if the directory exists afterwards
+		 */
+		bool createDirectories(const fs::path& directory) {
+			TraceSpan span("create_directories");
+			error_code error;
+
+			create_directories(directory, error);
+
+			return !error || fs::is_directory(directory);
+		}
+
+		uintmax_t streamTransfer(const fs::path& inputPath, uintmax_t offset, string_view prefix, const fs::path& stagingPath, FileError& error) {
+			ifstream input(inputPath, ios::binary);
+
+			if( !input ) {
+				error = { CodecErrc::Open };
+				return 0;
+			}
+
+			ofstream output(stagingPath, ios::binary);
+
+			if( !output ) {
+				error = { CodecErrc::Write };
+				return 0;
+			}
+
+			output.write(prefix.data(), prefix.size());
+			input.seekg(offset);
+
+			const auto start = output.tellp();
+
+			try {
+				copy(istreambuf_iterator(input), {}, ostreambuf_iterator(output));
+			}
+			catch( const ios_base::failure& ) {
+				// libstdc++ throws from underflow() when the read fails
+				input.setstate(ios::badbit);
+			}
+
+			const auto end = output.tellp();
+
+			output.close();
+
+			if( input.bad() )
+				error = { CodecErrc::Read };
+			else if( !output )
+				error = { CodecErrc::Write };
+
+			return static_cast<uintmax_t>(end - start);
+		}
+
+#ifdef SITHCODEC_POSIX
+		bool writeAll(int fd, const char* data, size_t size, FileError& error) {
+			while( size > 0 ) {
+				const auto n = ::write(fd, data, size);
+
+				if( n < 0 ) {
+					if( errno == EINTR )
+						continue;
+					error = { CodecErrc::Write, errno };
+					return false;
+				}
+				// Nothing written would retry the same write forever
+				if( n == 0 ) {
+					error = { CodecErrc::Write, EIO };
+					return false;
+				}
+
+				data += n;
+				size -= static_cast<size_t>(n);
+			}
+			return true;
+		}
+
+		uintmax_t copyBlock(int input, int output, uintmax_t offset, FileError& error) {
+			auto& buffer = blockBuffer();
+			uintmax_t copied = 0;
+
+			for( ;; ) {
+				const auto n = ::pread(input, buffer.data(), buffer.size(), static_cast<off_t>(offset + copied));
+
+				if( n < 0 ) {
+					if( errno == EINTR )
+						continue;
+					error = { CodecErrc::Read, errno };
+					return copied;
+				}
+				if( n == 0 || !writeAll(output, buffer.data(), static_cast<size_t>(n), error) )
+					return copied;
+
+				copied += static_cast<uintmax_t>(n);
+			}
+		}
+
+		uintmax_t copyMmap(int input, int output, uintmax_t offset, uintmax_t size, FileError& error) {
+			if( size == 0 )
+				return 0;
+
+			const auto length = static_cast<size_t>(offset + size);
+			void* map = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, input, 0);
+
+			if( map == MAP_FAILED )
+				return copyBlock(input, output, offset, error);
+
+			::madvise(map, length, MADV_SEQUENTIAL);
+
+			const bool written = writeAll(output, static_cast<const char*>(map) + offset, static_cast<size_t>(size), error);
+
+			::munmap(map, length);
+			return written ? size : 0;
+		}
+
+#ifdef SITHCODEC_LINUX
+		/**
+		 *	@brief Whether /proc/self/fd is mounted, checked once per process.
+		 *	@details An O_TMPFILE file can only be linked into place, or
+		 *			 reopened by the stream engine, through its entry there;
+		 *			 chroots and minimal containers often have no /proc.
+		 */
+		bool hasProcFd() {
+			static const bool available = [] {
+				struct stat info;
+
+				return ::stat("/proc/self/fd", &info) == 0 && S_ISDIR(info.st_mode);
+			}();
+
+			return available;
+		}
+
+		/**
+		 *	@brief Whether an in-kernel copy error means the call is not
+		 *		   supported for this pair of files, rather than a real failure.
+		 *	@details EISDIR can only concern the input, which the fallback
+		 *			 then reports as a read failure.
+		 */
+		bool isUnsupported(int error) {
+			return error == EXDEV || error == ENOSYS || error == EINVAL
+				|| error == EOPNOTSUPP || error == EBADF || error == EISDIR;
+		}
+
+		uintmax_t copySendfile(int input, int output, uintmax_t offset, FileError& error) {
+			auto position = static_cast<off_t>(offset);
+			uintmax_t copied = 0;
+
+			for( ;; ) {
+				const auto n = ::sendfile(output, input, &position, 0x7ffff000);
+
+				if( n < 0 ) {
+					if( errno == EINTR )
+						continue;
+					if( copied == 0 && isUnsupported(errno) )
+						return copyBlock(input, output, offset, error);
+					error = { CodecErrc::Write, errno };
+					return copied;
+				}
+				if( n == 0 )
+					return copied;
+
+				copied += static_cast<uintmax_t>(n);
+			}
+		}
+
+		uintmax_t copyFileRange(int input, int output, uintmax_t offset, FileError& error) {
+			auto position = static_cast<off_t>(offset);
+			uintmax_t copied = 0;
+
+			for( ;; ) {
+				const auto n = ::copy_file_range(input, &position, output, nullptr, 0x7ffff000, 0);
+
+				if( n < 0 ) {
+					if( errno == EINTR )
+						continue;
+					if( copied == 0 && isUnsupported(errno) )
+						return copySendfile(input, output, offset, error);
+					error = { CodecErrc::Write, errno };
+					return copied;
+				}
+				if( n == 0 )
+					return copied;
+
+				copied += static_cast<uintmax_t>(n);
+			}
+		}
+#endif
+#else
+		uintmax_t blockTransfer(const fs::path& inputPath, uintmax_t offset, string_view prefix, const fs::path& stagingPath, FileError& error) {
+			ifstream input(inputPath, ios::binary);
+
+			if( !input ) {
+				error = { CodecErrc::Open };
+				return 0;
+			}
+
+			ofstream output(stagingPath, ios::binary);
+
+			if( !output ) {
+				error = { CodecErrc::Write };
+				return 0;
+			}
+
+			auto& buffer = blockBuffer();
+			uintmax_t copied = 0;
+
+			output.write(prefix.data(), prefix.size());
+			input.seekg(offset);
+			while( input.read(buffer.data(), buffer.size()) || input.gcount() > 0 ) {
+				output.write(buffer.data(), input.gcount());
+				copied += static_cast<uintmax_t>(input.gcount());
+			}
+			output.close();
+
+			if( input.bad() )
+				error = { CodecErrc::Read };
+			else if( !output )
+				error = { CodecErrc::Write };
+
+			return copied;
+		}
+#endif
+	}
+
+#ifdef SITHCODEC_POSIX
+	FileDescriptor::~FileDescriptor() {
+		if( fd >= 0 )
+			::close(fd);
+	}
+
+	FileDescriptor& FileDescriptor::operator=(FileDescriptor&& other) noexcept {
+		if( this != &other ) {
+			if( fd >= 0 )
+				::close(fd);
+			fd = other.release();
+		}
+		return *this;
+	}
+
+	int FileDescriptor::release() noexcept {
+		const int result = fd;
+
+		fd = -1;
+		return result;
+	}
+#endif
+
+	StagedFile::StagedFile(const fs::path& destination) : destination(destination) {
+		FileError error;
+
+		open(error);
+		if( error )
+			throw runtime_error(errorMessage(error, destination));
+	}
+
+	StagedFile::StagedFile(const fs::path& destination, FileError& error) : destination(destination) {
+		open(error);
+	}
+
+	void StagedFile::open(FileError& error) {
+		TraceSpan span("open output");
+		auto directory = destination.parent_path();
+
+		if( directory.empty() )
+			directory = ".";
+
+#ifdef SITHCODEC_LINUX
+		// An unnamed file in the destination directory needs no name at all,
+		// but can only be published through /proc
+		if( hasProcFd() ) {
+			fd = FileDescriptor(::open(directory.c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, 0666));
+
+			if( !fd && errno == ENOENT && createDirectories(directory) )
+				fd = FileDescriptor(::open(directory.c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, 0666));
+
+			if( fd ) {
+				stagingPath = "/proc/self/fd/" + to_string(fd.get());
+				anonymous = true;
+				return;
+			}
+		}
+#endif
+		stagingPath = createNamed(directory, error);
+	}
+
+	StagedFile::~StagedFile() {
+		if( committed )
+			return;
+
+#ifdef SITHCODEC_POSIX
+		fd = FileDescriptor();
+		if( !anonymous )
+			::unlink(stagingPath.c_str());
+#else
+		error_code error;
+
+		fs::remove(stagingPath, error);
+#endif
+	}
+
+	const fs::path& StagedFile::path() const noexcept {
+		return stagingPath;
+	}
+
+	const fs::path& StagedFile::destinationPath() const noexcept {
+		return destination;
+	}
+
+	void StagedFile::commit() {
+		FileError error;
+
+		commit(error);
+		if( error )
+			throw runtime_error(errorMessage(error, destination));
+	}
+
+	void StagedFile::commit(FileError& error) {
+		TraceSpan span("rename");
+
+#ifdef SITHCODEC_LINUX
+		if( anonymous ) {
+			// Linking fails if the destination exists, in which case the file
+			// gets a name beside it and is renamed over the old one instead
+			if( ::linkat(AT_FDCWD, stagingPath.c_str(), AT_FDCWD, destination.c_str(), AT_SYMLINK_FOLLOW) != 0 ) {
+				if( errno != EEXIST ) {
+					error = { CodecErrc::Write, errno };
+					return;
+				}
+
+				for( ;; ) {
+					auto name = getStagingPath(destination);
+
+					if( ::linkat(AT_FDCWD, stagingPath.c_str(), AT_FDCWD, name.c_str(), AT_SYMLINK_FOLLOW) == 0 ) {
+						stagingPath = move(name);
+						anonymous = false;
+						break;
+					}
+					if( errno != EEXIST ) {
+						error = { CodecErrc::Write, errno };
+						return;
+					}
+				}
+			}
+			else {
+				committed = true;
+			}
+		}
+#endif
+
+#ifdef SITHCODEC_POSIX
+		if( ::close(fd.release()) != 0 || (!committed && ::rename(stagingPath.c_str(), destination.c_str()) != 0) ) {
+			error = { CodecErrc::Write, errno };
+			return;
+		}
+#else
+		error_code renameError;
+
+		fs::rename(stagingPath, destination, renameError);
+
+		if( renameError ) {
+			error = { CodecErrc::Write, renameError.value() };
+			return;
+		}
+#endif
+
+		committed = true;
+	}
+
+#ifdef SITHCODEC_POSIX
+	int StagedFile::descriptor() const noexcept {
+		return fd.get();
+	}
+#endif
+
+	fs::path StagedFile::createNamed(const fs::path& directory, FileError& error) {
+		bool retried = false;
+
+		for( ;; ) {
+			auto name = getStagingPath(destination);
+
+#ifdef SITHCODEC_POSIX
+			fd = FileDescriptor(::open(name.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666));
+
+			if( fd )
+				return name;
+			if( errno == EEXIST )
+				continue;
+			if( errno == ENOENT && !retried && createDirectories(directory) ) {
+				retried = true;
+				continue;
+			}
+#else
+			if( !retried && !fs::exists(directory) ) {
+				createDirectories(directory);
+				retried = true;
+			}
+			if( ofstream(name, ios::binary) )
+				return name;
+#endif
+			error = { CodecErrc::Write, errno };
+			return {};
+		}
+	}
+
+	fs::path getStagingPath(const fs::path& destination) {
+		const char* chars =
+			"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+			"abcdefghijklmnopqrstuvwxyz"
+			"0123456789";
+
+		return destination.parent_path() / ("." + destination.filename().string() + "." + getRandomString(chars, 8) + ".tmp");
+	}
+
+	uintmax_t transfer(const fs::path& inputPath, uintmax_t offset, string_view prefix, StagedFile& output, IoEngine engine) {
+		FileError error;
+		const auto copied = transfer(inputPath, offset, prefix, output, engine, error);
+
+		if( error )
+			throw runtime_error(errorMessage(error, error.code == CodecErrc::Open || error.code == CodecErrc::Read ? inputPath : output.destinationPath()));
+		return copied;
+	}
+
+	uintmax_t transfer(const fs::path& inputPath, uintmax_t offset, string_view prefix, StagedFile& output, IoEngine engine, FileError& error) {
+		if( engine == IoEngine::Stream ) {
+			TraceSpan span("copy");
+
+			return streamTransfer(inputPath, offset, prefix, output.path(), error);
+		}
+
+#ifdef SITHCODEC_POSIX
+		FileDescriptor input;
+		struct stat inputStat;
+
+		{
+			TraceSpan span("open input");
+
+			input = FileDescriptor(::open(inputPath.c_str(), O_RDONLY | O_CLOEXEC));
+
+			if( !input || ::fstat(input.get(), &inputStat) != 0 ) {
+				error = { CodecErrc::Open, errno };
+				return 0;
+			}
+		}
+
+		TraceSpan span("copy");
+
+		const int fd = output.descriptor();
+
+		if( !writeAll(fd, prefix.data(), prefix.size(), error) )
+			return 0;
+
+		const auto fileSize = static_cast<uintmax_t>(inputStat.st_size);
+		const auto size = fileSize > offset ? fileSize - offset : 0;
+
+		if( engine == IoEngine::Auto ) {
+			struct stat outputStat;
+
+			engine = selectEngine(size, ::fstat(fd, &outputStat) == 0 && outputStat.st_dev == inputStat.st_dev);
+		}
+
+		switch( engine ) {
+		case IoEngine::Mmap:
+			return copyMmap(input.get(), fd, offset, size, error);
+#ifdef SITHCODEC_LINUX
+		case IoEngine::CopyFileRange:
+			return copyFileRange(input.get(), fd, offset, error);
+		case IoEngine::Sendfile:
+			return copySendfile(input.get(), fd, offset, error);
+#endif
+		default:
+			return copyBlock(input.get(), fd, offset, error);
+		}
+#else
+		TraceSpan span("copy");
+
+		return blockTransfer(inputPath, offset, prefix, output.path(), error);
+#endif
+	}
+
+	IoEngine selectEngine([[maybe_unused]] uintmax_t size, [[maybe_unused]] bool sameDevice) {
+#ifdef SITHCODEC_LINUX
+		// Small files fit in one read, which beats the setup cost of the
+		// in-kernel paths. Larger files stay in the kernel; copy_file_range
+		// can additionally offload to the filesystem (reflink, NFS server-side
+		// copy) when both ends are on the same device.
+		if( size < smallFileSize )
+			return IoEngine::Block;
+		return sameDevice ? IoEngine::CopyFileRange : IoEngine::Sendfile;
+#else
+		return IoEngine::Block;
+#endif
+	}
+
+	string toString(IoEngine engine) {
+		switch( engine ) {
+		case IoEngine::Stream:
+			return "stream";
+		case IoEngine::Block:
+			return "block";
+		case IoEngine::Mmap:
+			return "mmap";
+		case IoEngine::CopyFileRange:
+			return "copy_file_range";
+		case IoEngine::Sendfile:
+			return "sendfile";
+		case IoEngine::Uring:
+			return "io_uring";
+		default:
+			return "auto";
+		}
+	}
+
+	optional<IoEngine> toIoEngine(string_view str) {
+		for( auto engine : { IoEngine::Auto, IoEngine::Stream, IoEngine::Block, IoEngine::Mmap, IoEngine::CopyFileRange, IoEngine::Sendfile, IoEngine::Uring } )
+			if( str == toString(engine) )
+				return engine;
+
+		return nullopt;
+	}
+}
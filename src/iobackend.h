@@ -0,0 +1,257 @@
+/**
+ *	@file iobackend.h
+ *	@brief Interchangeable engines for copying audio payloads between files.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_IOBACKEND_H
+#define SITHCODEC_IOBACKEND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "codecerror.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SITHCODEC_POSIX 1
+#endif
+
+#if defined(__linux__)
+#define SITHCODEC_LINUX 1
+#endif
+
+namespace SithCodec {
+	/**
+	 *	@brief Enumerator of engines that can copy a payload between files.
+	 */
+	enum class IoEngine {
+		Auto,			///< choose per file by size and filesystem
+		Stream,			///< buffered iostream iterators
+		Block,			///< large-block read/write
+		Mmap,			///< map the input and write from the mapping
+		CopyFileRange,	///< in-kernel copy with copy_file_range
+		Sendfile,		///< in-kernel copy with sendfile
+		Uring,			///< batched io_uring submission; single files use Block
+	};
+
+	/**
+	 *	@brief Files smaller than this are copied with a single block read
+	 *		   when the engine is IoEngine::Auto.
+	 */
+	constexpr std::uintmax_t smallFileSize = 256 * 1024;
+
+	/**
+	 *	@brief Size of the buffer used by IoEngine::Block.
+	 */
+	constexpr std::size_t blockSize = 1024 * 1024;
+
+#ifdef SITHCODEC_POSIX
+	/**
+	 *	@brief Owning wrapper for a POSIX file descriptor.
+	 */
+	class FileDescriptor {
+	public:
+		FileDescriptor() noexcept = default;
+		explicit FileDescriptor(int fd) noexcept : fd(fd) {}
+		FileDescriptor(FileDescriptor&& other) noexcept : fd(other.release()) {}
+		~FileDescriptor();
+
+		FileDescriptor& operator=(FileDescriptor&& other) noexcept;
+
+		int get() const noexcept { return fd; }
+		int release() noexcept;
+		explicit operator bool() const noexcept { return fd >= 0; }
+
+	private:
+		int fd = -1;
+	};
+#endif
+
+	/**
+	 *	@brief Output file that is written in the destination directory and
+	 *		   only appears under its final name once committed.
+	 *	@details On Linux the file is created unnamed with O_TMPFILE and linked
+	 *			 into place by commit() through /proc/self/fd. Elsewhere, on
+	 *			 filesystems without O_TMPFILE, or without /proc, it is a
+	 *			 hidden file beside the destination that commit() renames
+	 *			 over it. Either way the data is written once, on the
+	 *			 destination's filesystem. Missing parent directories are
+	 *			 created on demand. An uncommitted file is discarded.
+	 */
+	class StagedFile {
+	public:
+		/**
+		 *	@brief Creates an empty staging file for a destination.
+		 *
+		 *	@param destination final path of the file
+		 *
+		 *	@throws runtime_error
+		 */
+		explicit StagedFile(const std::filesystem::path& destination);
+
+		/**
+		 *	@brief Creates an empty staging file for a destination, without
+		 *		   throwing.
+		 *
+		 *	@param destination final path of the file
+		 *	@param error	   set to CodecErrc::Write on failure, in which case
+		 *					   the object may only be destroyed
+		 */
+		StagedFile(const std::filesystem::path& destination, FileError& error);
+
+		/**
+		 *	@brief Discards the staging file unless it was committed.
+		 */
+		~StagedFile();
+
+		StagedFile(const StagedFile&) = delete;
+		StagedFile& operator=(const StagedFile&) = delete;
+
+		/**
+		 *	@brief Gets a path that opens the staging file for writing.
+		 *
+		 *	@return path
+		 */
+		const std::filesystem::path& path() const noexcept;
+
+		/**
+		 *	@brief Gets the final path of the file.
+		 *
+		 *	@return path
+		 */
+		const std::filesystem::path& destinationPath() const noexcept;
+
+#ifdef SITHCODEC_POSIX
+		/**
+		 *	@brief Gets the open descriptor of the staging file.
+		 *
+		 *	@return file descriptor, open for writing
+		 */
+		int descriptor() const noexcept;
+#endif
+
+		/**
+		 *	@brief Publishes the staging file under its final path, replacing
+		 *		   any file already there.
+		 *
+		 *	@throws runtime_error
+		 */
+		void commit();
+
+		/**
+		 *	@brief Publishes the staging file under its final path, without
+		 *		   throwing.
+		 *
+		 *	@param error set to CodecErrc::Write on failure
+		 */
+		void commit(FileError& error);
+
+	private:
+		void open(FileError& error);
+		std::filesystem::path createNamed(const std::filesystem::path& directory, FileError& error);
+
+		std::filesystem::path destination;
+		std::filesystem::path stagingPath;
+#ifdef SITHCODEC_POSIX
+		FileDescriptor fd;
+		bool anonymous = false;
+#endif
+		bool committed = false;
+	};
+
+	/**
+	 *	@brief Generates a hidden path beside a destination for staging it.
+	 *
+	 *	@param destination final path of the file
+	 *
+	 *	@return staging path in the same directory
+	 */
+	std::filesystem::path getStagingPath(const std::filesystem::path& destination);
+
+	/**
+	 *	@brief Writes a prefix followed by the contents of a file, starting at
+	 *		   an offset, to a staged output file.
+	 *
+	 *	@param inputPath path of the input file
+	 *	@param offset	 number of bytes to skip at the start of the input
+	 *	@param prefix	 bytes to write before the payload
+	 *	@param output	 empty staged output file
+	 *	@param engine	 engine used to copy the payload
+	 *
+	 *	@return number of payload bytes copied
+	 *
+	 *	@throws runtime_error
+	 */
+	std::uintmax_t transfer(const std::filesystem::path& inputPath, std::uintmax_t offset, std::string_view prefix,
+		StagedFile& output, IoEngine engine = IoEngine::Auto);
+
+	/**
+	 *	@brief Writes a prefix followed by the contents of a file, without
+	 *		   throwing.
+	 *
+	 *	@param inputPath path of the input file
+	 *	@param offset	 number of bytes to skip at the start of the input
+	 *	@param prefix	 bytes to write before the payload
+	 *	@param output	 empty staged output file
+	 *	@param engine	 engine used to copy the payload
+	 *	@param error	 set to CodecErrc::Open, CodecErrc::Read or CodecErrc::Write on
+	 *					 failure
+	 *
+	 *	@return number of payload bytes copied
+	 */
+	std::uintmax_t transfer(const std::filesystem::path& inputPath, std::uintmax_t offset, std::string_view prefix,
+		StagedFile& output, IoEngine engine, FileError& error);
+
+	/**
+	 *	@brief Picks the engine IoEngine::Auto uses for a copy.
+	 *
+	 *	@param size		   number of payload bytes
+	 *	@param sameDevice  whether input and output live on the same filesystem
+	 *
+	 *	@return engine, never IoEngine::Auto
+	 */
+	IoEngine selectEngine(std::uintmax_t size, bool sameDevice);
+
+	/**
+	 *	@brief Converts an I/O engine to a human-readable string.
+	 *
+	 *	@param engine I/O engine
+	 *
+	 *	@return string
+	 */
+	std::string toString(IoEngine engine);
+
+	/**
+	 *	@brief Determines an I/O engine from its name.
+	 *
+	 *	@param str lowercase engine name, as produced by toString()
+	 *
+	 *	@return engine, or nothing if the name is not recognized
+	 */
+	std::optional<IoEngine> toIoEngine(std::string_view str);
+}
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ *	@file listfile.cpp
+ *	@brief Fast reader of lists of paths, one per line.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "listfile.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#ifdef SITHCODEC_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "codec.h"
+
+namespace SithCodec {
+	namespace fs = std::filesystem;
+	using namespace std;
+
+	ListFile::ListFile(const fs::path& path) {
+#ifdef SITHCODEC_POSIX
+		const FileDescriptor file(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+		struct stat info;
+
+		if( !file || ::fstat(file.get(), &info) != 0 )
+			throw runtime_error(openErrorMsg(path));
+
+		// Pipes and the like cannot be mapped, and empty files need not be
+		if( S_ISREG(info.st_mode) && info.st_size > 0 ) {
+			const auto size = static_cast<size_t>(info.st_size);
+			void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.get(), 0);
+
+			if( map != MAP_FAILED ) {
+				::madvise(map, size, MADV_SEQUENTIAL);
+				data = static_cast<const char*>(map);
+				length = size;
+				mapped = true;
+				return;
+			}
+		}
+#endif
+		ifstream stream(path, ios::binary);
+
+		if( !stream )
+			throw runtime_error(openErrorMsg(path));
+
+		buffer.assign(istreambuf_iterator<char>(stream), istreambuf_iterator<char>());
+		if( stream.bad() )
+			throw runtime_error(openErrorMsg(path));
+		data = buffer.data();
+		length = buffer.size();
+	}
+
+	ListFile::~ListFile() {
+#ifdef SITHCODEC_POSIX
+		if( mapped )
+			::munmap(const_cast<char*>(data), length);
+#endif
+	}
+
+	bool ListFile::next(string_view& line) noexcept {
+		while( position < length ) {
+			const char* start = data + position;
+			const auto remaining = length - position;
+			const auto* newline = static_cast<const char*>(memchr(start, '\n', remaining));
+			auto size = newline ? static_cast<size_t>(newline - start) : remaining;
+
+			position += newline ? size + 1 : size;
+			if( size > 0 && start[size - 1] == '\r' )
+				--size;
+			if( size > 0 ) {
+				line = string_view(start, size);
+				return true;
+			}
+		}
+		return false;
+	}
+}
@@ -0,0 +1,82 @@
+/**
+ *	@file listfile.h
+ *	@brief Fast reader of lists of paths, one per line.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_LISTFILE_H
+#define SITHCODEC_LISTFILE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+#include "iobackend.h"
+
+namespace SithCodec {
+	/**
+	 *	@brief List of paths, one per line, handed out as views into the
+	 *		   file.
+	 *	@details On POSIX systems a regular file is memory-mapped, so lines
+	 *			 cost neither a copy nor an allocation; other files are read
+	 *			 whole into memory. Line endings are found with memchr, which
+	 *			 the C library implements with vector instructions. LF and
+	 *			 CRLF endings are both accepted, blank lines are skipped, and
+	 *			 the last line needs no ending.
+	 */
+	class ListFile {
+	public:
+		/**
+		 *	@brief Opens a list.
+		 *
+		 *	@param path path of the list
+		 *
+		 *	@throws runtime_error if the list cannot be opened or read
+		 */
+		explicit ListFile(const std::filesystem::path& path);
+
+		~ListFile();
+
+		ListFile(const ListFile&) = delete;
+		ListFile& operator=(const ListFile&) = delete;
+
+		/**
+		 *	@brief Gets the next path of the list.
+		 *
+		 *	@param line set to the path, without its line ending; valid for the
+		 *				life of this object
+		 *
+		 *	@return false at the end of the list
+		 */
+		bool next(std::string_view& line) noexcept;
+
+	private:
+		const char* data = nullptr;
+		std::size_t length = 0;
+		std::size_t position = 0;
+		bool mapped = false;
+		std::vector<char> buffer;	///< contents of a list that could not be mapped
+	};
+}
+
+#endif
@@ -25,10 +25,19 @@
 
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "allocstats.h"
+#include "asynclog.h"
+#include "batchstats.h"
 #include "codec.h"
+#include "metrics.h"
+#include "perfcounters.h"
+#include "progress.h"
+#include "trace.h"
 
 namespace fs = std::filesystem;
 using namespace std;
@@ -108,6 +117,22 @@ vector<string> parseArgs(int argc, const char* argv[]);
  */
 vector<string> parseArgs(const string& str);
 
+/**
+ *	@brief Matches an option that takes a value, given as "-x=value",
+ *		   "-x value", or as the following argument.
+ *
+ *	@param args		 arguments
+ *	@param i		 index of current argument; advanced if the value is the
+ *					 following argument
+ *	@param shortName short form of the option, e.g. "-j", or an empty string if
+ *					 there is none
+ *	@param longName	 long form of the option, e.g. "--jobs"
+ *	@param value	 receives the value, or an empty string if none was given
+ *
+ *	@return true if the current argument is the option
+ */
+bool matchOption(const vector<string>& args, size_t& i, const string& shortName, const string& longName, string& value);
+
 /**
  *	@brief Executes a command based on the input arguments.
  *
@@ -124,9 +149,10 @@ Result executeArgs(vector<string>& args, ostream& log = cout);
  *	@param inputPath  input file path
  *	@param format     audio format
  *	@param outputPath output file path
+ *	@param engine     engine used to copy the payload
  *	@param log        output stream for logging
  */
-void runEncode(const fs::path& inputPath, SithCodec::AudioFormat format, const fs::path& outputPath = "", ostream& log = cout);
+void runEncode(const fs::path& inputPath, SithCodec::AudioFormat format, const fs::path& outputPath = "", IoEngine engine = IoEngine::Auto, ostream& log = cout);
 
 /**
  *	@brief Encodes all audio files.
@@ -134,27 +160,32 @@ void runEncode(const fs::path& inputPath, SithCodec::AudioFormat format, const f
  *	@param inputPath  path to list of audio files, or directory containing audio files
  *	@param format     audio format
  *	@param outputPath output file path
+ *	@param options    batch settings
+ *	@param logFormat  layout of the result of each file
  *	@param log        output stream for logging
  */
-void runEncodeAll(const fs::path& inputPath, SithCodec::AudioFormat format, const fs::path& outputPath = "", ostream& log = cout);
+void runEncodeAll(const fs::path& inputPath, SithCodec::AudioFormat format, const fs::path& outputPath = "", const BatchOptions& options = {}, LogFormat logFormat = LogFormat::Text, ostream& log = cout);
 
 /**
  *	@brief Decodes an audio file.
  *
  *	@param inputPath  input file path
  *	@param outputPath output file path
+ *	@param engine     engine used to copy the payload
  *	@param log        output stream for logging
  */
-void runDecode(const fs::path& inputPath, const fs::path& outputPath = "", ostream& log = cout);
+void runDecode(const fs::path& inputPath, const fs::path& outputPath = "", IoEngine engine = IoEngine::Auto, ostream& log = cout);
 
 /**
  *	@brief Decodes all audio files.
  *
  *	@param inputPath  path to list of audio files, or directory containing audio files
  *	@param outputPath output directory
+ *	@param options    batch settings
+ *	@param logFormat  layout of the result of each file
  *	@param log        output stream for logging
  */
-void runDecodeAll(const fs::path& inputPath, const fs::path& outputPath = "", ostream& log = cout);
+void runDecodeAll(const fs::path& inputPath, const fs::path& outputPath = "", const BatchOptions& options = {}, LogFormat logFormat = LogFormat::Text, ostream& log = cout);
 
 /**
  *	@brief Generates a list of all files in a directory and the corresponding
@@ -162,19 +193,12 @@ void runDecodeAll(const fs::path& inputPath, const fs::path& outputPath = "", os
  *
  *	@param inputPath  directory to search
  *	@param outputPath output path of file, or empty string for cout
+ *	@param options    list settings
  *	@param log        output stream for logging
  *
  *	@warning If the current path is used, the executable will appear in the list.
  */
-void runList(const fs::path& inputPath, const fs::path& outputPath = "", ostream& log = cout);
-
-/**
- *	@brief Prints the status of a file operation.
- *
- *	@param op  FileOperation
- *	@param log output stream for logging
- */
-void printLog(const FileOperation& op, ostream& log = cout);
+void runList(const fs::path& inputPath, const fs::path& outputPath = "", const ListOptions& options = {}, ostream& log = cout);
 
 /**
  *	@brief Converts a string to all lowercase.
@@ -267,6 +291,21 @@ ostream& help(ostream& output) {
 		<< "-l, --list                  list files & formats                               \n"
 		<< "-i, --in                    input path                                         \n"
 		<< "-o, --out                   output path                                        \n"
+		<< "-j, --jobs [n]              number of worker threads for -a and -l             \n"
+		<< "    --io [engine]           copy engine: auto, stream, block, mmap,            \n"
+		<< "                            copy_file_range, sendfile, io_uring                \n"
+		<< "    --queue-depth [n]       files in flight with --io=io_uring                 \n"
+		<< "    --manifest [path]       skip files unchanged since the last -a run         \n"
+		<< "    --hash                  compare contents too, with --manifest              \n"
+		<< "    --trace [path]          write stage timings as Chrome trace JSON           \n"
+		<< "    --summary [n]           print throughput, latency & n slowest files for -a \n"
+		<< "    --counters [path]       count cycles, cache misses etc. per stage          \n"
+		<< "    --allocations           add heap allocations & peak RSS to the -a summary  \n"
+		<< "    --metrics [path]        keep Prometheus metrics of an -a run in a file     \n"
+		<< "    --metrics-interval [s]  seconds between metrics updates (default 15)       \n"
+		<< "    --progress [s]          report -a progress on stderr every s seconds       \n"
+		<< "    --csv                   list as CSV                                        \n"
+		<< "    --jsonl                 list, or log -a results, as JSON lines             \n"
 		<< "-h, --help                  display this menu                                  \n"
 		<< "-c, --commands              display list of commands                           \n"
 		<< "-x, --examples              display example commands                           \n"
@@ -293,10 +332,20 @@ ostream& commands(ostream& output) {
 		<< "-e -a -f -[format] -i=[input path]                                             \n"
 		<< "-e -a -f -[format] -o=[output path]                                            \n"
 		<< "-e -a -f -[format] -i=[input path] -o=[output path]                            \n"
+		<< "-d -a -j=[n]                                                                   \n"
+		<< "-e -a -f -[format] -j=[n]                                                      \n"
+		<< "-d -i=[input path] --io=[engine]                                               \n"
+		<< "-d -a -i=[input path] -o=[output path] --manifest=[manifest path]              \n"
+		<< "-e -a -f -[format] -i=[input path] --summary=[n]                               \n"
+		<< "-e -a -f -[format] -i=[input path] --metrics=[path] --metrics-interval=[s]     \n"
+		<< "-d -a -i=[input path] --counters                                               \n"
+		<< "-d -a -i=[input path] -o=[output path] --progress=[s]                          \n"
 		<< "-l                                                                             \n"
 		<< "-l -i=[input path]                                                             \n"
 		<< "-l -o=[output path]                                                            \n"
 		<< "-l -i=[input path] -o=[output path]                                            \n"
+		<< "-l --csv -i=[input path] -o=[output path]                                      \n"
+		<< "-l --jsonl -i=[input path] -o=[output path]                                    \n"
 		<< "-------------------------------------------------------------------------------\n"
 		<< "                                                                               \n";
 }
@@ -316,6 +365,12 @@ ostream& examples(ostream& output) {
 		<< "Decode a file without specifying output, possibly overwriting the original:    \n"
 		<< "-d -i=file.wav                                                                 \n"
 		<< "                                                                               \n"
+		<< "Decode all files in the input path using 4 worker threads:                     \n"
+		<< "-d --all -j=4 -i=in_folder -o=out_folder                                       \n"
+		<< "                                                                               \n"
+		<< "Decode only the files that changed since the last run with the same manifest:  \n"
+		<< "-d --all -i=in_folder -o=out_folder --manifest=out_folder.manifest             \n"
+		<< "                                                                               \n"
 		<< "List all files & formats in a given directory, printing to the console:        \n"
 		<< "-l -i=my_folder                                                                \n"
 		<< "                                                                               \n"
@@ -363,9 +418,40 @@ vector<string> parseArgs(const string& str) {
 	return args;
 }
 
+bool matchOption(const vector<string>& args, size_t& i, const string& shortName, const string& longName, string& value) {
+	const string arg = toLowercase(args[i]);
+
+	for( const auto& name : { shortName, longName } ) {
+		if( name.empty() )
+			continue;
+		if( arg == name ) {
+			value = i + 1 < args.size() && args[i + 1].find('-') != 0 ? args[++i] : "";
+			return true;
+		}
+		if( arg.length() > name.length()
+			&& arg.compare(0, name.length(), name) == 0
+			&& (arg[name.length()] == '=' || arg[name.length()] == ' ') ) {
+			value = args[i].substr(name.length() + 1);
+			value.erase(value.find_last_not_of(' ') + 1);
+			return true;
+		}
+	}
+
+	return false;
+}
+
 Result executeArgs(vector<string>& args, ostream& log) {
 	string::size_type argc = args.size(), pos;
-	string option, inputStr, outputStr, format, arg;
+	string option, inputStr, outputStr, format, arg, value;
+	BatchOptions options;
+	ListOptions listOptions;
+	fs::path tracePath, countersPath;
+	fs::path metricsPath;
+	chrono::seconds metricsInterval{ 15 };
+	optional<chrono::seconds> progressInterval;
+	unique_ptr<BatchStats> stats;
+	bool summary = false, metricsIntervalSet = false, counting = false, countingAllocations = false;
+	bool engineSet = false, queueDepthSet = false;
 
 	for( size_t i = 1; i < argc; ++i ) {
 		arg = toLowercase(args[i]);
@@ -410,6 +496,12 @@ Result executeArgs(vector<string>& args, ostream& log) {
 				return Result::BadInput;
 			option = "l";
 		}
+		// List output layout (can only be set once)
+		else if( arg == "--csv" || arg == "--jsonl" ) {
+			if( listOptions.format != ListFormat::Text )
+				return Result::BadInput;
+			listOptions.format = arg == "--csv" ? ListFormat::Csv : ListFormat::JsonLines;
+		}
 		// Decode/encode upgraded to decode all/encode all
 		else if( arg == "-a" || arg == "--all" ) {
 			if( option == "d" )
@@ -439,6 +531,104 @@ Result executeArgs(vector<string>& args, ostream& log) {
 				return Result::BadInput;
 			outputStr = args[i].substr(pos, arg.length() - pos);
 		}
+		// Worker thread count (can only be set once)
+		else if( matchOption(args, i, "-j", "--jobs", value) ) {
+			if( options.jobs != 0
+				|| value.empty()
+				|| value.length() > 4
+				|| value.find_first_not_of("0123456789") != string::npos )
+				return Result::BadInput;
+			options.jobs = static_cast<unsigned>(stoul(value));
+			if( options.jobs == 0 )
+				return Result::BadInput;
+			listOptions.jobs = options.jobs;
+		}
+		// I/O engine (can only be set once)
+		else if( matchOption(args, i, "", "--io", value) ) {
+			const auto engine = toIoEngine(toLowercase(value));
+
+			if( engineSet || !engine )
+				return Result::BadInput;
+			options.engine = engine.value();
+			engineSet = true;
+		}
+		// io_uring queue depth (can only be set once)
+		else if( matchOption(args, i, "", "--queue-depth", value) ) {
+			if( queueDepthSet
+				|| value.empty()
+				|| value.length() > 4
+				|| value.find_first_not_of("0123456789") != string::npos
+				|| stoul(value) == 0 )
+				return Result::BadInput;
+			options.queueDepth = static_cast<unsigned>(stoul(value));
+			queueDepthSet = true;
+		}
+		// Incremental manifest (can only be set once)
+		else if( matchOption(args, i, "", "--manifest", value) ) {
+			if( !options.manifest.empty() || value.empty() )
+				return Result::BadInput;
+			options.manifest = value;
+		}
+		// Trace output file (can only be set once)
+		else if( matchOption(args, i, "", "--trace", value) ) {
+			if( !tracePath.empty() || value.empty() )
+				return Result::BadInput;
+			tracePath = value;
+		}
+		// End-of-run summary, optionally with the number of slowest files (can only be set once)
+		else if( matchOption(args, i, "", "--summary", value) ) {
+			if( summary
+				|| value.length() > 4
+				|| value.find_first_not_of("0123456789") != string::npos )
+				return Result::BadInput;
+			stats = make_unique<BatchStats>(value.empty() ? 10 : stoul(value));
+			summary = true;
+		}
+		// Prometheus metrics file (can only be set once)
+		else if( matchOption(args, i, "", "--metrics", value) ) {
+			if( !metricsPath.empty() || value.empty() )
+				return Result::BadInput;
+			metricsPath = value;
+		}
+		// Seconds between metrics file updates (can only be set once)
+		else if( matchOption(args, i, "", "--metrics-interval", value) ) {
+			if( metricsIntervalSet
+				|| value.empty()
+				|| value.length() > 5
+				|| value.find_first_not_of("0123456789") != string::npos
+				|| stoul(value) == 0 )
+				return Result::BadInput;
+			metricsInterval = chrono::seconds(stoul(value));
+			metricsIntervalSet = true;
+		}
+		// Live progress, optionally with the seconds between reports (can only be set once)
+		else if( matchOption(args, i, "", "--progress", value) ) {
+			if( progressInterval
+				|| value.length() > 5
+				|| value.find_first_not_of("0123456789") != string::npos
+				|| (!value.empty() && stoul(value) == 0) )
+				return Result::BadInput;
+			progressInterval = chrono::seconds(value.empty() ? 0 : stoul(value));
+		}
+		// Performance counters per stage, to the log or a file (can only be set once)
+		else if( matchOption(args, i, "", "--counters", value) ) {
+			if( counting )
+				return Result::BadInput;
+			countersPath = value;
+			counting = true;
+		}
+		// Heap allocations per stage and per file, in the summary
+		else if( arg == "--allocations" ) {
+			if( countingAllocations )
+				return Result::BadInput;
+			countingAllocations = true;
+		}
+		// Content hashes in the manifest
+		else if( arg == "--hash" ) {
+			if( options.hashContents )
+				return Result::BadInput;
+			options.hashContents = true;
+		}
 		// Audio format (can only be set once)
 		else if( arg == "-f" || arg == "--format" ) {
 			if( ++i == argc )
@@ -452,81 +642,192 @@ Result executeArgs(vector<string>& args, ostream& log) {
 			return Result::BadInput;
 	}
 
+	if( options.hashContents && options.manifest.empty() )
+		return Result::BadInput;
+
+	if( (summary || countingAllocations || !metricsPath.empty() || metricsIntervalSet || progressInterval) && option != "da" && option != "ea" )
+		return Result::BadInput;
+
+	// Nothing would be counted without the operator new of allocnew.cpp
+	if( countingAllocations && !canCountAllocations() ) {
+		log << "--allocations needs allocnew.cpp, which this build leaves out.\n";
+		return Result::BadInput;
+	}
+
+	if( countingAllocations && !summary ) {
+		stats = make_unique<BatchStats>();
+		summary = true;
+	}
+
+	if( metricsIntervalSet && metricsPath.empty() )
+		return Result::BadInput;
+
+	if( (!metricsPath.empty() || progressInterval) && !stats )
+		stats = make_unique<BatchStats>(0);
+	options.stats = stats.get();
+	// Only progress reports bytes against a total, which takes a stat per file
+	options.sizeInputs = progressInterval.has_value();
+
+	if( !tracePath.empty() )
+		startTrace();
+
+	if( counting )
+		startCounting();
+
+	if( countingAllocations )
+		startAllocationCounting();
+
+	// Written however the command ends, so failed runs can be inspected too
+	const auto finishTrace = [&] {
+		if( tracePath.empty() )
+			return true;
+
+		ofstream file(tracePath);
+
+		writeTrace(file);
+		file.close();
+		if( !file )
+			log << writeErrorMsg(tracePath) << '\n';
+		return static_cast<bool>(file);
+	};
+
+	const auto finishCounters = [&] {
+		if( !counting )
+			return true;
+		if( countersPath.empty() ) {
+			writeCounters(log);
+			return true;
+		}
+
+		ofstream file(countersPath);
+
+		writeCounters(file);
+		file.close();
+		if( !file )
+			log << writeErrorMsg(countersPath) << '\n';
+		return static_cast<bool>(file);
+	};
+
+	unique_ptr<MetricsFile> metrics;
+	unique_ptr<ProgressReport> progress;
+
+	// Likewise written at exit whatever the outcome, with the final counts
+	const auto finishMetrics = [&] {
+		if( !metrics )
+			return true;
+
+		try {
+			metrics->finish();
+			return true;
+		}
+		catch( const exception& ex ) {
+			log << ex.what() << '\n';
+			return false;
+		}
+	};
+
 	try {
+		if( !metricsPath.empty() )
+			metrics = make_unique<MetricsFile>(metricsPath, *stats, metricsInterval);
+
+		// A terminal is redrawn often, a log file is appended to sparingly
+		if( progressInterval ) {
+			const auto style = progressStyleFor(cerr);
+			const auto defaultInterval = chrono::seconds(style == ProgressStyle::StatusLine ? 1 : 30);
+
+			progress = make_unique<ProgressReport>(cerr, *stats, style,
+				progressInterval->count() ? *progressInterval : defaultInterval);
+		}
+
+		const auto logFormat = listOptions.format == ListFormat::JsonLines ? LogFormat::JsonLines : LogFormat::Text;
+
 		if( option == "d" )
-			runDecode(inputStr, outputStr, log);
+			runDecode(inputStr, outputStr, options.engine, log);
 		else if( option == "da" )
-			runDecodeAll(inputStr, outputStr, log);
+			runDecodeAll(inputStr, outputStr, options, logFormat, log);
 		else if( option == "e" )
-			runEncode(inputStr, toAudioFormat(format), outputStr, log);
+			runEncode(inputStr, toAudioFormat(format), outputStr, options.engine, log);
 		else if( option == "ea" )
-			runEncodeAll(inputStr, toAudioFormat(format), outputStr, log);
+			runEncodeAll(inputStr, toAudioFormat(format), outputStr, options, logFormat, log);
 		else if( option == "l" )
-			runList(inputStr, outputStr, log);
-		return Result::Success;
+			runList(inputStr, outputStr, listOptions, log);
+
+		if( progress )
+			progress->finish();
+		stopAllocationCounting();
+		if( summary )
+			stats->printSummary(log);
+
+		const bool metricsWritten = finishMetrics();
+		const bool countersWritten = finishCounters();
+
+		return finishTrace() && metricsWritten && countersWritten ? Result::Success : Result::Failure;
 	}
 	catch( const exception& ex ) {
+		progress.reset();
+		stopAllocationCounting();
 		log << ex.what() << '\n';
+		finishMetrics();
+		finishCounters();
+		finishTrace();
 		return Result::Failure;
 	}
 }
 
-void runEncode(const fs::path& inputPath, AudioFormat format, const fs::path& outputPath, ostream& log) {
+void runEncode(const fs::path& inputPath, AudioFormat format, const fs::path& outputPath, IoEngine engine, ostream& log) {
 	if( format == AudioFormat::None ) {
 		log << formatErrorMsg << '\n';
 		return;
 	}
 
 	try {
-		encode(inputPath, format, outputPath);
+		encode(inputPath, format, outputPath, engine);
 	}
 	catch( const exception& ex ) {
 		log << ex.what() << '\n';
 	}
 }
 
-void runEncodeAll(const fs::path& inputPath, AudioFormat format, const fs::path& outputPath, ostream& log) {
+void runEncodeAll(const fs::path& inputPath, AudioFormat format, const fs::path& outputPath, const BatchOptions& options, LogFormat logFormat, ostream& log) {
 	if( format == AudioFormat::None ) {
 		log << formatErrorMsg << '\n';
 		return;
 	}
 
 	try {
-		const auto operations = encodeAll(inputPath, format, outputPath);
+		AsyncLog results(log, logFormat);
 
-		for( const auto& op : operations )
-			printLog(op, log);
+		encodeAll(inputPath, format, outputPath, options, results.sink());
 	}
 	catch( const exception& ex ) {
 		log << indentLevel2 << ex.what() << '\n';
 	}
 }
 
-void runDecode(const fs::path& inputPath, const fs::path& outputPath, ostream& log) {
+void runDecode(const fs::path& inputPath, const fs::path& outputPath, IoEngine engine, ostream& log) {
 	try {
-		decode(inputPath, outputPath);
+		decode(inputPath, outputPath, engine);
 	}
 	catch( const exception& ex ) {
 		log << ex.what() << '\n';
 	}
 }
 
-void runDecodeAll(const fs::path& inputPath, const fs::path& outputPath, ostream& log) {
+void runDecodeAll(const fs::path& inputPath, const fs::path& outputPath, const BatchOptions& options, LogFormat logFormat, ostream& log) {
 	try {
-		const auto operations = decodeAll(inputPath, outputPath);
+		AsyncLog results(log, logFormat);
 
-		for( const auto& op : operations )
-			printLog(op, log);
+		decodeAll(inputPath, outputPath, options, results.sink());
 	}
 	catch( const exception& ex ) {
 		log << indentLevel2 << ex.what() << '\n';
 	}
 }
 
-void runList(const fs::path& inputPath, const fs::path& outputPath, ostream& log) {
+void runList(const fs::path& inputPath, const fs::path& outputPath, const ListOptions& options, ostream& log) {
 	try {
 		if( outputPath == "" ) {
-			printFormats(inputPath);
+			printFormats(inputPath, cout, options);
 		}
 		else {
 			ofstream file(outputPath);
@@ -534,7 +835,7 @@ void runList(const fs::path& inputPath, const fs::path& outputPath, ostream& log
 			if( !file )
 				log << writeErrorMsg(outputPath);
 			else
-				printFormats(inputPath, file);
+				printFormats(inputPath, file, options);
 		}
 	}
 	catch( const exception& ex ) {
@@ -542,18 +843,6 @@ void runList(const fs::path& inputPath, const fs::path& outputPath, ostream& log
 	}
 }
 
-void printLog(const FileOperation& op, ostream& log) {
-	log << indentLevel1 << op.path.string() << ' ';
-	if( op.error ) {
-		log
-			<< failMsg << '\n'
-			<< indentLevel2 << op.error.value() << '\n';
-	}
-	else {
-		log << successMsg << '\n';
-	}
-}
-
 string toLowercase(string str) {
 	for( string::size_type i = 0; i < str.size(); ++i )
 		str[i] = tolower(static_cast<unsigned char>(str[i]));
@@ -0,0 +1,339 @@
+/**
+ *	@file manifest.cpp
+ *	@brief Persistent record of converted files for incremental batches.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "manifest.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "codec.h"
+#include "iobackend.h"
+
+#ifdef SITHCODEC_POSIX
+#include <sys/stat.h>
+#endif
+
+namespace SithCodec {
+	namespace fs = std::filesystem;
+	using namespace std;
+
+	namespace {
+		/**
+		 *	@brief First line of every manifest; bumped when the layout changes.
+		 */
+		constexpr string_view manifestHeader = "SithCodec manifest 1";
+
+		/**
+		 *	@brief Determines whether two identities describe the same version
+		 *		   of a file, going by metadata alone.
+		 */
+		bool sameMetadata(const FileIdentity& a, const FileIdentity& b) {
+			return a.size == b.size && a.mtime == b.mtime && a.inode == b.inode;
+		}
+
+		/**
+		 *	@brief Appends a path with tabs, newlines and backslashes escaped.
+		 */
+		void appendEscaped(string& text, string_view str) {
+			for( const char ch : str ) {
+				if( ch == '\\' )
+					text += "\\\\";
+				else if( ch == '\t' )
+					text += "\\t";
+				else if( ch == '\n' )
+					text += "\\n";
+				else
+					text += ch;
+			}
+		}
+
+		string unescape(string_view str) {
+			string result;
+
+			result.reserve(str.size());
+			for( size_t i = 0; i < str.size(); ++i ) {
+				if( str[i] != '\\' || i + 1 == str.size() ) {
+					result += str[i];
+					continue;
+				}
+
+				const char ch = str[++i];
+
+				result += ch == 't' ? '\t' : ch == 'n' ? '\n' : ch;
+			}
+
+			return result;
+		}
+
+		template<class T>
+		void appendNumber(string& text, T value, int base = 10) {
+			char buffer[24];
+			const auto end = to_chars(buffer, buffer + sizeof(buffer), value, base).ptr;
+
+			text.append(buffer, end);
+		}
+
+		template<class T>
+		bool parseNumber(string_view field, T& value, int base = 10) {
+			const auto end = field.data() + field.size();
+			const auto result = from_chars(field.data(), end, value, base);
+
+			return result.ec == errc() && result.ptr == end;
+		}
+
+		/**
+		 *	@brief Splits a line into tab-separated fields.
+		 */
+		vector<string_view> split(string_view line) {
+			vector<string_view> fields;
+			size_t pos;
+
+			while( (pos = line.find('\t')) != string_view::npos ) {
+				fields.push_back(line.substr(0, pos));
+				line.remove_prefix(pos + 1);
+			}
+			fields.push_back(line);
+
+			return fields;
+		}
+	}
+
+	optional<FileIdentity> identify(const fs::path& path) {
+		FileIdentity identity;
+
+#ifdef SITHCODEC_POSIX
+		struct stat info;
+
+		if( ::stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode) )
+			return nullopt;
+
+#ifdef __APPLE__
+		const auto& mtime = info.st_mtimespec;
+#else
+		const auto& mtime = info.st_mtim;
+#endif
+
+		identity.size = static_cast<uintmax_t>(info.st_size);
+		identity.mtime = static_cast<int64_t>(mtime.tv_sec) * 1000000000 + mtime.tv_nsec;
+		identity.inode = static_cast<uint64_t>(info.st_ino);
+#else
+		error_code error;
+
+		identity.size = file_size(path, error);
+		if( error )
+			return nullopt;
+
+		const auto time = last_write_time(path, error);
+
+		if( error )
+			return nullopt;
+		identity.mtime = chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count();
+#endif
+
+		return identity;
+	}
+
+	optional<uint64_t> hashFile(const fs::path& path) {
+		ifstream file(path, ios::binary);
+
+		if( !file )
+			return nullopt;
+
+		vector<char> buffer(blockSize);
+		uint64_t hash = 0xcbf29ce484222325;
+
+		do {
+			file.read(buffer.data(), static_cast<streamsize>(buffer.size()));
+			for( streamsize i = 0; i < file.gcount(); ++i ) {
+				hash ^= static_cast<unsigned char>(buffer[static_cast<size_t>(i)]);
+				hash *= 0x100000001b3;
+			}
+		} while( file );
+
+		if( file.bad() )
+			return nullopt;
+
+		// 0 means "not hashed" in a FileIdentity
+		return hash ? hash : 1;
+	}
+
+	Manifest::Manifest(fs::path path, bool hashContents) : path(move(path)), hashContents(hashContents) {
+		if( !exists(this->path) )
+			return;
+
+		ifstream file(this->path, ios::binary);
+
+		if( !file )
+			throw runtime_error(openErrorMsg(this->path));
+
+		string line;
+
+		if( !getline(file, line) || line != manifestHeader )
+			return;
+
+		while( getline(file, line) ) {
+			const auto fields = split(line);
+			Record record;
+
+			if( fields.size() != 10
+				|| !parseNumber(fields[1], record.input.size)
+				|| !parseNumber(fields[2], record.input.mtime)
+				|| !parseNumber(fields[3], record.input.inode)
+				|| !parseNumber(fields[4], record.input.hash, 16)
+				|| !parseNumber(fields[5], record.outputIdentity.size)
+				|| !parseNumber(fields[6], record.outputIdentity.mtime)
+				|| !parseNumber(fields[7], record.outputIdentity.inode) )
+				continue;
+
+			record.signature = fields[0];
+			record.output = unescape(fields[9]);
+			records.insert_or_assign(unescape(fields[8]), move(record));
+		}
+	}
+
+	bool Manifest::upToDate(const fs::path& input, const string& signature, const fs::path& outputPath) {
+		const auto key = input.string();
+		optional<Record> record;
+
+		{
+			lock_guard lock(mutex);
+
+			if( const auto it = records.find(key); it != records.end() )
+				record = it->second;
+		}
+
+		auto current = identify(input);
+
+		// Extensions follow the format, so only the rest of the output path is compared
+		if( record && current && record->signature == signature
+			&& fs::path(record->output).replace_extension() == fs::path(outputPath).replace_extension() ) {
+			const auto written = identify(record->output);
+
+			if( written && sameMetadata(*written, record->outputIdentity) ) {
+				if( record->output == key || sameMetadata(*current, record->input) )
+					return true;
+
+				if( hashContents && record->input.hash && current->size == record->input.size ) {
+					current->hash = hashFile(input).value_or(0);
+
+					if( current->hash == record->input.hash ) {
+						lock_guard lock(mutex);
+
+						records[key].input = *current;
+						return true;
+					}
+				}
+			}
+		}
+
+		if( !current )
+			return false;
+
+		if( hashContents && !current->hash )
+			current->hash = hashFile(input).value_or(0);
+
+		lock_guard lock(mutex);
+
+		pending.insert_or_assign(key, *current);
+		return false;
+	}
+
+	void Manifest::record(const fs::path& input, const string& signature, const fs::path& output) {
+		const auto written = identify(output);
+
+		if( !written )
+			return;
+
+		lock_guard lock(mutex);
+		const auto it = pending.find(input.string());
+
+		if( it == pending.end() )
+			return;
+
+		records.insert_or_assign(it->first, Record{ signature, it->second, output.string(), *written });
+		pending.erase(it);
+	}
+
+	void Manifest::save() const {
+		string text;
+
+		{
+			lock_guard lock(mutex);
+			vector<const decltype(records)::value_type*> entries;
+
+			entries.reserve(records.size());
+			for( const auto& entry : records )
+				entries.push_back(&entry);
+			// Sorted so that manifests of the same tree compare equal
+			sort(entries.begin(), entries.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+
+			text += manifestHeader;
+			text += '\n';
+			for( const auto* entry : entries ) {
+				const auto& record = entry->second;
+
+				text += record.signature;
+				text += '\t';
+				appendNumber(text, record.input.size);
+				text += '\t';
+				appendNumber(text, record.input.mtime);
+				text += '\t';
+				appendNumber(text, record.input.inode);
+				text += '\t';
+				appendNumber(text, record.input.hash, 16);
+				text += '\t';
+				appendNumber(text, record.outputIdentity.size);
+				text += '\t';
+				appendNumber(text, record.outputIdentity.mtime);
+				text += '\t';
+				appendNumber(text, record.outputIdentity.inode);
+				text += '\t';
+				appendEscaped(text, entry->first);
+				text += '\t';
+				appendEscaped(text, record.output);
+				text += '\n';
+			}
+		}
+
+		StagedFile staged(path);
+
+		{
+			ofstream file(staged.path(), ios::binary);
+
+			file.write(text.data(), static_cast<streamsize>(text.size()));
+			file.close();
+
+			if( !file )
+				throw runtime_error(writeErrorMsg(path));
+		}
+
+		staged.commit();
+	}
+}
@@ -0,0 +1,139 @@
+/**
+ *	@file manifest.h
+ *	@brief Persistent record of converted files for incremental batches.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_MANIFEST_H
+#define SITHCODEC_MANIFEST_H
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace SithCodec {
+	/**
+	 *	@brief What identifies one version of a file's contents.
+	 */
+	struct FileIdentity {
+		std::uintmax_t size = 0;
+		std::int64_t mtime = 0;		///< modification time in nanoseconds
+		std::uint64_t inode = 0;	///< 0 where the platform has no inode numbers
+		std::uint64_t hash = 0;		///< content hash, or 0 if not computed
+	};
+
+	/**
+	 *	@brief Reads the size, modification time and inode of a file.
+	 *
+	 *	@param path path of file
+	 *
+	 *	@return identity without a content hash, or nothing if the file does
+	 *			not exist
+	 */
+	std::optional<FileIdentity> identify(const std::filesystem::path& path);
+
+	/**
+	 *	@brief Computes a 64-bit FNV-1a hash of a file's contents.
+	 *
+	 *	@param path path of file
+	 *
+	 *	@return non-zero hash, or nothing if the file cannot be read
+	 */
+	std::optional<std::uint64_t> hashFile(const std::filesystem::path& path);
+
+	/**
+	 *	@brief Record of the inputs a batch converted and the outputs it wrote,
+	 *		   used to skip files that have not changed since.
+	 *	@details All member functions are safe to call from multiple threads.
+	 */
+	class Manifest {
+	public:
+		/**
+		 *	@brief Loads a manifest, or starts an empty one if the file does not
+		 *		   exist or was written by an incompatible version.
+		 *
+		 *	@param path			path of manifest file
+		 *	@param hashContents whether identities include a content hash
+		 *
+		 *	@throws runtime_error if the file exists but cannot be read
+		 */
+		explicit Manifest(std::filesystem::path path, bool hashContents = false);
+
+		/**
+		 *	@brief Determines whether converting a file again would reproduce
+		 *		   the output already on disk.
+		 *	@details An input is unchanged if its size, modification time and
+		 *			 inode match the record; with content hashing, a file
+		 *			 whose size matches but whose other metadata changed is
+		 *			 hashed and compared instead. The recorded output must be
+		 *			 unchanged as well. A file converted in place is its own
+		 *			 output and is compared against that alone.
+		 *			 When the file is out of date its current identity is kept
+		 *			 for the next record() of the same input.
+		 *
+		 *	@param input	  path of input file
+		 *	@param signature  description of the conversion, e.g. "decode"
+		 *	@param outputPath path the conversion would be asked to write
+		 *
+		 *	@return true if the input and its recorded output are unchanged
+		 */
+		bool upToDate(const std::filesystem::path& input, const std::string& signature, const std::filesystem::path& outputPath);
+
+		/**
+		 *	@brief Records a successful conversion of a file previously found
+		 *		   out of date by upToDate().
+		 *
+		 *	@param input	 path of input file
+		 *	@param signature description of the conversion
+		 *	@param output	 path of the file written
+		 */
+		void record(const std::filesystem::path& input, const std::string& signature, const std::filesystem::path& output);
+
+		/**
+		 *	@brief Atomically replaces the manifest file with the current records.
+		 *	@details Records of inputs this batch did not see are kept, so a
+		 *			 manifest can be shared by runs over different lists.
+		 *
+		 *	@throws runtime_error
+		 */
+		void save() const;
+
+	private:
+		struct Record {
+			std::string signature;
+			FileIdentity input;
+			std::string output;
+			FileIdentity outputIdentity;
+		};
+
+		std::filesystem::path path;
+		bool hashContents;
+		std::unordered_map<std::string, Record> records;
+		std::unordered_map<std::string, FileIdentity> pending;	///< identities read by upToDate()
+		mutable std::mutex mutex;
+	};
+}
+
+#endif
@@ -0,0 +1,176 @@
+/**
+ *	@file metrics.cpp
+ *	@brief Export of batch statistics for the Prometheus textfile collector.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "metrics.h"
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "iobackend.h"
+
+namespace SithCodec {
+	namespace fs = std::filesystem;
+	using namespace std;
+
+	namespace {
+		constexpr pair<AudioFormat, const char*> formatLabels[] = {
+			{ AudioFormat::None, "none" },
+			{ AudioFormat::SFX, "sfx" },
+			{ AudioFormat::VO, "vo" },
+		};
+
+		constexpr pair<FileOutcome, const char*> outcomeLabels[] = {
+			{ FileOutcome::Done, "done" },
+			{ FileOutcome::Failed, "failed" },
+			{ FileOutcome::UpToDate, "up_to_date" },
+		};
+
+		constexpr pair<BatchStage, const char*> stageLabels[] = {
+			{ BatchStage::Enumerate, "enumerate" },
+			{ BatchStage::Manifest, "manifest" },
+			{ BatchStage::Convert, "convert" },
+			{ BatchStage::Save, "save" },
+		};
+
+		void appendFamily(ostream& output, const char* name, const char* type, const char* help) {
+			output << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+		}
+
+		double toSeconds(uint64_t nanoseconds) {
+			return static_cast<double>(nanoseconds) / 1e9;
+		}
+	}
+
+	void writeMetrics(const BatchStats& stats, ostream& output) {
+		const auto flags = output.flags();
+		const auto precision = output.precision();
+
+		// Quantile labels must read 0.5, not 0.500000000, whatever the caller set
+		output << defaultfloat << setprecision(9);
+
+		appendFamily(output, "sithcodec_files_total", "counter", "Files finished, by audio format and outcome.");
+		for( const auto& [format, formatLabel] : formatLabels )
+			for( const auto& [outcome, outcomeLabel] : outcomeLabels )
+				output << "sithcodec_files_total{format=\"" << formatLabel << "\",outcome=\"" << outcomeLabel << "\"} "
+					<< stats.files(format, outcome) << '\n';
+
+		appendFamily(output, "sithcodec_read_bytes_total", "counter", "Bytes read from converted files, by audio format.");
+		for( const auto& [format, label] : formatLabels )
+			output << "sithcodec_read_bytes_total{format=\"" << label << "\"} " << stats.bytesRead(format) << '\n';
+
+		appendFamily(output, "sithcodec_written_bytes_total", "counter", "Bytes written to converted files, by audio format.");
+		for( const auto& [format, label] : formatLabels )
+			output << "sithcodec_written_bytes_total{format=\"" << label << "\"} " << stats.bytesWritten(format) << '\n';
+
+		appendFamily(output, "sithcodec_stage_seconds_total", "counter", "Time spent in each stage of the batch, summed over threads.");
+		for( const auto& [stage, label] : stageLabels )
+			output << "sithcodec_stage_seconds_total{stage=\"" << label << "\"} " << toSeconds(stats.stageTime(stage)) << '\n';
+
+		const auto& latency = stats.latency();
+
+		appendFamily(output, "sithcodec_file_duration_seconds", "summary", "Time to convert one file.");
+		for( const auto quantile : { 0.5, 0.9, 0.99 } )
+			output << "sithcodec_file_duration_seconds{quantile=\"" << quantile << "\"} "
+				<< toSeconds(latency.percentile(quantile * 100)) << '\n';
+		output
+			<< "sithcodec_file_duration_seconds_sum " << toSeconds(stats.stageTime(BatchStage::Convert)) << '\n'
+			<< "sithcodec_file_duration_seconds_count " << latency.count() << '\n';
+
+		appendFamily(output, "sithcodec_queue_depth", "gauge", "Files enumerated and waiting for a worker.");
+		output << "sithcodec_queue_depth " << stats.queueDepth() << '\n';
+
+		appendFamily(output, "sithcodec_active_workers", "gauge", "Files being converted: busy workers, or files in flight on io_uring.");
+		output << "sithcodec_active_workers " << stats.activeFiles() << '\n';
+
+		appendFamily(output, "sithcodec_elapsed_seconds", "gauge", "Time since the batch started, up to its end.");
+		output << "sithcodec_elapsed_seconds " << stats.elapsed() << '\n';
+
+		output.flags(flags);
+		output.precision(precision);
+	}
+
+	MetricsFile::MetricsFile(const fs::path& path, const BatchStats& stats, chrono::milliseconds interval)
+		: path(path), stats(stats), interval(interval) {
+		write();
+		writer = thread([this] {
+			unique_lock lock(mutex);
+
+			while( !wake.wait_for(lock, this->interval, [this] { return stopping; }) ) {
+				lock.unlock();
+				try {
+					write();
+				}
+				catch( const exception& ) {
+					// A missed snapshot is retried next interval; finish() reports errors
+				}
+				lock.lock();
+			}
+		});
+	}
+
+	MetricsFile::~MetricsFile() {
+		stop();
+	}
+
+	void MetricsFile::finish() {
+		stop();
+		write();
+	}
+
+	void MetricsFile::write() const {
+		ostringstream text;
+
+		writeMetrics(stats, text);
+
+		const auto str = text.str();
+		StagedFile staged(path);
+
+		{
+			ofstream file(staged.path(), ios::binary);
+
+			file.write(str.data(), static_cast<streamsize>(str.size()));
+			file.close();
+
+			if( !file )
+				throw runtime_error(writeErrorMsg(path));
+		}
+
+		staged.commit();
+	}
+
+	void MetricsFile::stop() {
+		{
+			lock_guard lock(mutex);
+
+			stopping = true;
+		}
+		wake.notify_all();
+		if( writer.joinable() )
+			writer.join();
+	}
+}
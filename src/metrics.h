@@ -0,0 +1,100 @@
+/**
+ *	@file metrics.h
+ *	@brief Export of batch statistics for the Prometheus textfile collector.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_METRICS_H
+#define SITHCODEC_METRICS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+#include "batchstats.h"
+
+namespace SithCodec {
+	/**
+	 *	@brief Writes a snapshot of batch statistics in the Prometheus text
+	 *		   exposition format.
+	 *	@details Counters cover files by format and outcome, bytes read and
+	 *			 written, and seconds per stage; gauges cover the queue
+	 *			 depth, files in progress and elapsed time. Safe to call while
+	 *			 the batch is running.
+	 *
+	 *	@param stats  statistics
+	 *	@param output output stream
+	 */
+	void writeMetrics(const BatchStats& stats, std::ostream& output);
+
+	/**
+	 *	@brief Keeps a metrics file up to date while a batch runs.
+	 *	@details A background thread rewrites the file every interval. Each
+	 *			 write goes through a StagedFile, so a collector never reads a
+	 *			 partial file.
+	 */
+	class MetricsFile {
+	public:
+		/**
+		 *	@brief Writes the file once and starts rewriting it periodically.
+		 *
+		 *	@param path		path of the file, which should end in .prom
+		 *	@param stats	statistics to export; must outlive this object
+		 *	@param interval time between writes
+		 *
+		 *	@throws runtime_error
+		 */
+		MetricsFile(const std::filesystem::path& path, const BatchStats& stats, std::chrono::milliseconds interval);
+
+		/**
+		 *	@brief Stops the periodic writes without a final one.
+		 */
+		~MetricsFile();
+
+		MetricsFile(const MetricsFile&) = delete;
+		MetricsFile& operator=(const MetricsFile&) = delete;
+
+		/**
+		 *	@brief Stops the periodic writes and writes the final values.
+		 *
+		 *	@throws runtime_error
+		 */
+		void finish();
+
+	private:
+		void write() const;
+		void stop();
+
+		const std::filesystem::path path;
+		const BatchStats& stats;
+		const std::chrono::milliseconds interval;
+		std::mutex mutex;
+		std::condition_variable wake;
+		bool stopping = false;
+		std::thread writer;
+	};
+}
+
+#endif
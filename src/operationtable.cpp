@@ -0,0 +1,164 @@
+/**
+ *	@file operationtable.cpp
+ *	@brief Compact table of the files of a batch.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "operationtable.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+namespace SithCodec {
+	namespace fs = std::filesystem;
+	using namespace std;
+
+	namespace {
+		/**
+		 *	@brief Longest directory or file name an entry can hold.
+		 */
+		constexpr size_t maxComponentLength = 0xffff;
+	}
+
+	size_t OperationTable::add(const fs::path& path) {
+		return add(StringView(path.native()));
+	}
+
+	size_t OperationTable::add(StringView whole) {
+		constexpr OperationTable::Char separators[] = { '/', fs::path::preferred_separator, 0 };
+		const auto separator = whole.find_last_of(separators);
+		const auto split = separator == StringView::npos ? 0 : separator + 1;
+		const auto directoryPart = whole.substr(0, split);
+		const auto namePart = whole.substr(split);
+
+		if( directoryPart.size() > maxComponentLength || namePart.size() > maxComponentLength )
+			throw length_error("path too long for the operation table");
+
+		// Files are enumerated directory by directory, so the last one usually matches
+		if( directories == 0 || view(directorySpans[lastDirectory]) != directoryPart ) {
+			const auto it = directoryIndex.find(directoryPart);
+
+			if( it != directoryIndex.end() ) {
+				lastDirectory = it->second;
+			}
+			else {
+				const auto span = store(directoryPart);
+
+				directorySpans.prepare(directories);
+				directorySpans[directories] = span;
+				lastDirectory = static_cast<uint32_t>(directories++);
+				directoryIndex.emplace(view(span), lastDirectory);
+			}
+		}
+
+		const auto index = entries;
+
+		directoryOf.prepare(index);
+		names.prepare(index);
+		statuses.prepare(index);
+		errors.prepare(index);
+		sizes.prepare(index);
+
+		directoryOf[index] = lastDirectory;
+		names[index] = store(namePart);
+		statuses[index] = FileStatus::Pending;
+		errors[index] = {};
+		sizes[index] = 0;
+
+		return entries++;
+	}
+
+	OperationTable::StringView OperationTable::directory(size_t index) const noexcept {
+		return view(directorySpans[directoryOf[index]]);
+	}
+
+	OperationTable::StringView OperationTable::name(size_t index) const noexcept {
+		return view(names[index]);
+	}
+
+	fs::path OperationTable::path(size_t index) const {
+		const auto directoryPart = directory(index);
+		const auto namePart = name(index);
+		fs::path::string_type str;
+
+		str.reserve(directoryPart.size() + namePart.size());
+		str.append(directoryPart).append(namePart);
+		return fs::path(move(str));
+	}
+
+	void OperationTable::appendPath(size_t index, string& text) const {
+		if constexpr( is_same_v<Char, char> )
+			text.append(directory(index)).append(name(index));
+		else
+			text += path(index).string();
+	}
+
+	size_t OperationTable::count(FileStatus status) const noexcept {
+		size_t result = 0;
+
+		for( size_t i = 0; i < entries; ++i )
+			result += statuses[i] == status;
+		return result;
+	}
+
+	FileOperation OperationTable::operation(size_t index) const {
+		return { path(index), errors[index], statuses[index] == FileStatus::UpToDate, sizes[index], index };
+	}
+
+	void OperationTable::update(const FileOperation& operation) noexcept {
+		const auto index = operation.index;
+
+		errors[index] = operation.error;
+		if( operation.skipped )
+			statuses[index] = FileStatus::UpToDate;
+		else
+			statuses[index] = operation.error ? FileStatus::Failed : FileStatus::Done;
+	}
+
+	OperationTable::Span OperationTable::store(StringView str) {
+		if( str.empty() )
+			return 0;
+
+		// A string never straddles two segments; the next one is always big enough
+		const auto segment = arena.segmentOf(arenaUsed);
+		const auto next = arena.segmentStart(segment + 1);
+
+		if( arenaUsed + str.size() > next )
+			arenaUsed = next;
+		arena.prepare(arenaUsed);
+		copy(str.begin(), str.end(), &arena[arenaUsed]);
+
+		const auto span = static_cast<Span>(arenaUsed) << 16 | str.size();
+
+		arenaUsed += str.size();
+		return span;
+	}
+
+	OperationTable::StringView OperationTable::view(Span span) const noexcept {
+		const auto length = static_cast<size_t>(span & maxComponentLength);
+
+		if( length == 0 )
+			return {};
+		return { &arena[static_cast<size_t>(span >> 16)], length };
+	}
+}
@@ -0,0 +1,262 @@
+/**
+ *	@file operationtable.h
+ *	@brief Compact table of the files of a batch.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_OPERATIONTABLE_H
+#define SITHCODEC_OPERATIONTABLE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "codecerror.h"
+
+namespace SithCodec {
+	/**
+	 *	@brief Working copy of one file of a batch, taken from an
+	 *		   OperationTable while the file is converted.
+	 */
+	struct FileOperation {
+		std::filesystem::path path;
+		FileError error;	///< rendered by errorMessage() when needed
+		bool skipped = false;	///< output was already up to date, see BatchOptions::manifest
+		std::uintmax_t size = 0;	///< input size found by enumeration when BatchOptions::sizeInputs is set
+		std::size_t index = 0;	///< enumeration sequence number in a batch, which is also the entry in the table the copy was taken from
+	};
+
+	/**
+	 *	@brief Enumerator of the states of a file in an OperationTable.
+	 */
+	enum class FileStatus : std::uint8_t {
+		Pending,	///< not converted (yet)
+		Done,
+		Failed,
+		UpToDate,	///< skipped, see BatchOptions::manifest
+	};
+
+	/**
+	 *	@brief Files of a batch, stored for millions of entries.
+	 *	@details Each directory is stored once and shared by the files in it;
+	 *			 file names are packed into an arena and referred to by
+	 *			 offset; status, error and size live in parallel columns.
+	 *			 An entry takes about 30 bytes plus its name, and adding
+	 *			 one allocates only when a storage segment fills.
+	 *
+	 *			 Storage grows in segments that never move, so one thread may
+	 *			 add entries while others read and update entries already
+	 *			 handed to them, such as through a BoundedQueue.
+	 */
+	class OperationTable {
+	public:
+		using Char = std::filesystem::path::value_type;
+		using StringView = std::basic_string_view<Char>;
+
+		/**
+		 *	@brief Appends a file; only one thread may add at a time.
+		 *
+		 *	@param path path of the file
+		 *
+		 *	@return index of the entry
+		 *
+		 *	@throws length_error if the directory or name is longer than 65535
+		 *			characters
+		 */
+		std::size_t add(const std::filesystem::path& path);
+
+		/**
+		 *	@brief Appends a file given as a native path string, such as a
+		 *		   line of a ListFile, without building a path first.
+		 */
+		std::size_t add(StringView path);
+
+		/**
+		 *	@brief Gets the number of entries.
+		 */
+		std::size_t size() const noexcept { return entries; }
+
+		/**
+		 *	@brief Determines whether the table has no entries.
+		 */
+		bool empty() const noexcept { return entries == 0; }
+
+		/**
+		 *	@brief Gets the number of distinct directories.
+		 */
+		std::size_t directoryCount() const noexcept { return directories; }
+
+		/**
+		 *	@brief Gets the directory of an entry, with its trailing separator.
+		 */
+		StringView directory(std::size_t index) const noexcept;
+
+		/**
+		 *	@brief Gets the file name of an entry.
+		 */
+		StringView name(std::size_t index) const noexcept;
+
+		/**
+		 *	@brief Builds the path of an entry.
+		 */
+		std::filesystem::path path(std::size_t index) const;
+
+		/**
+		 *	@brief Appends the path of an entry to a string, converting it
+		 *		   from the native encoding if needed.
+		 */
+		void appendPath(std::size_t index, std::string& text) const;
+
+		FileStatus status(std::size_t index) const noexcept { return statuses[index]; }
+		void setStatus(std::size_t index, FileStatus status) noexcept { statuses[index] = status; }
+
+		FileError error(std::size_t index) const noexcept { return errors[index]; }
+		void setError(std::size_t index, const FileError& error) noexcept { errors[index] = error; }
+
+		/**
+		 *	@brief Gets the input size recorded for an entry.
+		 *
+		 *	@return bytes, or 0 if never recorded
+		 */
+		std::uintmax_t inputSize(std::size_t index) const noexcept { return sizes[index]; }
+		void setInputSize(std::size_t index, std::uintmax_t size) noexcept { sizes[index] = size; }
+
+		/**
+		 *	@brief Counts the entries with a status.
+		 */
+		std::size_t count(FileStatus status) const noexcept;
+
+		/**
+		 *	@brief Takes a working copy of an entry.
+		 */
+		FileOperation operation(std::size_t index) const;
+
+		/**
+		 *	@brief Stores the outcome of a working copy back in its entry.
+		 *
+		 *	@param operation working copy taken by operation()
+		 */
+		void update(const FileOperation& operation) noexcept;
+
+	private:
+		/**
+		 *	@brief Array of segments, each twice the size of the one before,
+		 *		   so that elements never move and lookups need no lock.
+		 */
+		template<class T, unsigned FirstBits>
+		class Segmented {
+		public:
+			T& operator[](std::size_t index) noexcept;
+			const T& operator[](std::size_t index) const noexcept;
+
+			/**
+			 *	@brief Allocates the segment holding an index, if needed.
+			 */
+			void prepare(std::size_t index);
+
+			/**
+			 *	@brief Gets the index a segment starts at.
+			 */
+			static std::size_t segmentStart(unsigned segment) noexcept;
+
+			/**
+			 *	@brief Gets the segment holding an index.
+			 */
+			static unsigned segmentOf(std::size_t index) noexcept;
+
+		private:
+			std::array<std::unique_ptr<T[]>, 64 - FirstBits> segments;
+		};
+
+		/**
+		 *	@brief Location of a string in the arena: the offset in the upper
+		 *		   48 bits, the length in the lower 16.
+		 */
+		using Span = std::uint64_t;
+
+		Span store(StringView str);
+		StringView view(Span span) const noexcept;
+
+		Segmented<Char, 16> arena;
+		std::uint64_t arenaUsed = 0;
+		Segmented<Span, 8> directorySpans;
+		std::size_t directories = 0;
+		std::unordered_map<StringView, std::uint32_t> directoryIndex;	///< views into the arena
+		std::uint32_t lastDirectory = 0;	///< consecutive files usually share one
+		Segmented<std::uint32_t, 10> directoryOf;
+		Segmented<Span, 10> names;
+		Segmented<FileStatus, 10> statuses;
+		Segmented<FileError, 10> errors;
+		Segmented<std::uintmax_t, 10> sizes;
+		std::size_t entries = 0;
+	};
+
+	template<class T, unsigned FirstBits>
+	T& OperationTable::Segmented<T, FirstBits>::operator[](std::size_t index) noexcept {
+		const auto segment = segmentOf(index);
+
+		return segments[segment][index - segmentStart(segment)];
+	}
+
+	template<class T, unsigned FirstBits>
+	const T& OperationTable::Segmented<T, FirstBits>::operator[](std::size_t index) const noexcept {
+		const auto segment = segmentOf(index);
+
+		return segments[segment][index - segmentStart(segment)];
+	}
+
+	template<class T, unsigned FirstBits>
+	void OperationTable::Segmented<T, FirstBits>::prepare(std::size_t index) {
+		auto& segment = segments[segmentOf(index)];
+
+		// Left uninitialized, as every element is written before it is read
+		if( !segment )
+			segment.reset(new T[std::size_t(1) << (FirstBits + segmentOf(index))]);
+	}
+
+	template<class T, unsigned FirstBits>
+	std::size_t OperationTable::Segmented<T, FirstBits>::segmentStart(unsigned segment) noexcept {
+		return ((std::size_t(1) << segment) - 1) << FirstBits;
+	}
+
+	template<class T, unsigned FirstBits>
+	unsigned OperationTable::Segmented<T, FirstBits>::segmentOf(std::size_t index) noexcept {
+		const auto shifted = static_cast<std::uint64_t>(index) + (std::uint64_t(1) << FirstBits);
+
+#if defined(__GNUC__)
+		return static_cast<unsigned>(63 - __builtin_clzll(shifted)) - FirstBits;
+#else
+		unsigned bit = 63;
+
+		while( !(shifted >> bit) )
+			--bit;
+		return bit - FirstBits;
+#endif
+	}
+}
+
+#endif
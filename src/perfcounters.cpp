@@ -0,0 +1,428 @@
+/**
+ *	@file perfcounters.cpp
+ *	@brief Hardware and software performance counters sampled per stage.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "perfcounters.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "codec.h"
+#include "trace.h"
+
+#if defined(SITHCODEC_LINUX) && __has_include(<linux/perf_event.h>)
+#define SITHCODEC_PERF 1
+#endif
+
+#ifdef SITHCODEC_PERF
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace SithCodec {
+	using namespace std;
+
+	namespace {
+		constexpr const char* counterNames[perfCounterCount] = {
+			"cycles", "instructions", "cache-misses", "ctx-switches", "page-faults",
+		};
+
+		/**
+		 *	@brief Counts of one stage on one thread.
+		 */
+		struct StageTotals {
+			const char* name;
+			uint64_t calls = 0;
+			uint64_t nanoseconds = 0;
+			PerfValues values{};
+		};
+
+		/**
+		 *	@brief Stages of one thread. Only the owning thread adds to it, so
+		 *		   no lock is needed until the counts are written.
+		 */
+		struct ThreadStages {
+			unsigned generation = 0;	///< run the counts belong to
+			vector<StageTotals> stages;
+		};
+
+#ifdef SITHCODEC_PERF
+		struct EventSpec {
+			uint32_t type;
+			uint64_t config;
+		};
+
+		constexpr EventSpec eventSpecs[perfCounterCount] = {
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+			{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+			{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+		};
+
+		int openEvent(const EventSpec& spec, bool userOnly, bool inherit, int group) {
+			perf_event_attr attr;
+
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = spec.type;
+			attr.config = spec.config;
+			attr.exclude_kernel = userOnly;
+			attr.exclude_hv = 1;
+			attr.inherit = inherit;
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING
+				| (inherit ? 0 : PERF_FORMAT_GROUP);
+
+			return static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC));
+		}
+
+		/**
+		 *	@brief Scales a count up for the time the counter was not
+		 *		   scheduled, when more counters were requested than the PMU has.
+		 */
+		uint64_t scale(uint64_t value, uint64_t enabled, uint64_t running) {
+			if( running == 0 || running >= enabled )
+				return value;
+			return static_cast<uint64_t>(static_cast<double>(value) * enabled / running);
+		}
+#endif
+
+		/**
+		 *	@brief Counters of one thread, read together as a group.
+		 */
+		class ThreadCounters {
+		public:
+			explicit ThreadCounters(bool userOnly) {
+#ifdef SITHCODEC_PERF
+				for( size_t i = 0; i < perfCounterCount; ++i ) {
+					const int fd = openEvent(eventSpecs[i], userOnly, false, leader);
+
+					if( fd < 0 )
+						continue;
+					if( leader < 0 )
+						leader = fd;
+					fds.push_back(fd);
+					indices.push_back(i);
+				}
+#else
+				(void)userOnly;
+#endif
+			}
+
+			~ThreadCounters() {
+#ifdef SITHCODEC_PERF
+				// Members first; closing the leader would detach them
+				for( auto it = fds.rbegin(); it != fds.rend(); ++it )
+					::close(*it);
+#endif
+			}
+
+			ThreadCounters(const ThreadCounters&) = delete;
+			ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+			void read(PerfValues& values) const noexcept {
+				values.fill(0);
+#ifdef SITHCODEC_PERF
+				if( leader < 0 )
+					return;
+
+				uint64_t buffer[3 + perfCounterCount];
+				const auto size = ::read(leader, buffer, sizeof(buffer));
+
+				if( size < static_cast<ssize_t>(3 * sizeof(uint64_t)) )
+					return;
+
+				const auto count = min<uint64_t>(buffer[0], indices.size());
+
+				for( size_t i = 0; i < count; ++i )
+					values[indices[i]] = scale(buffer[3 + i], buffer[1], buffer[2]);
+#endif
+			}
+
+		private:
+#ifdef SITHCODEC_PERF
+			int leader = -1;
+			vector<int> fds;
+			vector<size_t> indices;	///< PerfCounter of each descriptor, in group order
+#endif
+		};
+
+		/**
+		 *	@brief Counters of the whole process, including threads started
+		 *		   after them once those threads have exited.
+		 */
+		class RunCounters {
+		public:
+			RunCounters() { fds.fill(-1); }
+
+			~RunCounters() {
+				close();
+			}
+
+			RunCounters(const RunCounters&) = delete;
+			RunCounters& operator=(const RunCounters&) = delete;
+
+			/**
+			 *	@brief Opens every permitted counter, with kernel mode if allowed.
+			 *
+			 *	@return whether counting is limited to user mode
+			 */
+			bool open() {
+				close();
+#ifdef SITHCODEC_PERF
+				for( const bool userOnly : { false, true } ) {
+					for( size_t i = 0; i < perfCounterCount; ++i )
+						fds[i] = openEvent(eventSpecs[i], userOnly, true, -1);
+					if( any_of(fds.begin(), fds.end(), [](int fd) { return fd >= 0; }) )
+						return userOnly;
+				}
+#endif
+				return false;
+			}
+
+			/**
+			 *	@brief Gets which counters could be opened.
+			 */
+			array<bool, perfCounterCount> available() const {
+				array<bool, perfCounterCount> result;
+
+				for( size_t i = 0; i < perfCounterCount; ++i )
+					result[i] = fds[i] >= 0;
+				return result;
+			}
+
+			PerfValues read() const {
+				PerfValues values{};
+#ifdef SITHCODEC_PERF
+				for( size_t i = 0; i < perfCounterCount; ++i ) {
+					uint64_t buffer[3];
+
+					if( fds[i] >= 0 && ::read(fds[i], buffer, sizeof(buffer)) == sizeof(buffer) )
+						values[i] = scale(buffer[0], buffer[1], buffer[2]);
+				}
+#endif
+				return values;
+			}
+
+			void close() {
+#ifdef SITHCODEC_PERF
+				for( auto& fd : fds )
+					if( fd >= 0 )
+						::close(fd);
+#endif
+				fds.fill(-1);
+			}
+
+		private:
+			array<int, perfCounterCount> fds;
+		};
+
+		/**
+		 *	@brief Every thread's stages, kept after the thread exits.
+		 */
+		struct Registry {
+			mutex guard;
+			vector<shared_ptr<ThreadStages>> threads;
+			atomic<unsigned> generation{ 0 };
+			RunCounters run;
+			PerfValues runStart{};
+			int64_t startTime = 0;
+			bool userOnly = false;
+		};
+
+		Registry& registry() {
+			static Registry instance;
+
+			return instance;
+		}
+
+		struct ThreadState {
+			unique_ptr<ThreadCounters> counters;
+			shared_ptr<ThreadStages> stages;
+		};
+
+		/**
+		 *	@brief Gets the calling thread's counters and stages, opening and
+		 *		   registering them the first time; the only step that takes
+		 *		   a lock.
+		 */
+		ThreadState& threadState() {
+			thread_local ThreadState state;
+
+			if( !state.stages ) {
+				auto& reg = registry();
+				lock_guard lock(reg.guard);
+
+				state.counters = make_unique<ThreadCounters>(reg.userOnly);
+				state.stages = make_shared<ThreadStages>();
+				reg.threads.push_back(state.stages);
+			}
+
+			return state;
+		}
+
+		string formatTime(uint64_t nanoseconds) {
+			ostringstream str;
+
+			str << fixed << setprecision(3) << nanoseconds / 1e6 << " ms";
+			return str.str();
+		}
+	}
+
+	void startCounting() {
+		auto& reg = registry();
+
+		{
+			lock_guard lock(reg.guard);
+
+			++reg.generation;
+			reg.userOnly = reg.run.open();
+			reg.runStart = reg.run.read();
+			reg.startTime = traceClock();
+		}
+		countingEnabled.store(true);
+	}
+
+	void writeCounters(ostream& output) {
+		countingEnabled.store(false);
+
+		auto& reg = registry();
+		lock_guard lock(reg.guard);
+		const auto available = reg.run.available();
+		const bool any = any_of(available.begin(), available.end(), [](bool b) { return b; });
+		vector<StageTotals> stages;
+
+		// Equal names from different threads, or literals, are merged
+		for( const auto& thread : reg.threads ) {
+			if( thread->generation != reg.generation )
+				continue;
+
+			for( const auto& stage : thread->stages ) {
+				auto it = find_if(stages.begin(), stages.end(), [&](const StageTotals& s) { return strcmp(s.name, stage.name) == 0; });
+
+				if( it == stages.end() ) {
+					stages.push_back(stage);
+					continue;
+				}
+				it->calls += stage.calls;
+				it->nanoseconds += stage.nanoseconds;
+				for( size_t i = 0; i < perfCounterCount; ++i )
+					it->values[i] += stage.values[i];
+			}
+			thread->stages.clear();
+		}
+		sort(stages.begin(), stages.end(), [](const auto& a, const auto& b) { return a.nanoseconds > b.nanoseconds; });
+
+		StageTotals run{ "run", 1, static_cast<uint64_t>(traceClock() - reg.startTime) };
+		const auto runEnd = reg.run.read();
+
+		// Scaled counts are estimates, so one can come out below its start
+		for( size_t i = 0; i < perfCounterCount; ++i )
+			run.values[i] = runEnd[i] >= reg.runStart[i] ? runEnd[i] - reg.runStart[i] : 0;
+		stages.insert(stages.begin(), run);
+		reg.run.close();
+
+		const auto flags = output.flags();
+		const auto precision = output.precision();
+
+		output << "Performance counters";
+		if( !any )
+			output << " not permitted, times only";
+		else if( reg.userOnly )
+			output << ", user mode only";
+		output << "\n" << indentLevel1 << left << setw(20) << "stage" << right << setw(10) << "calls" << setw(14) << "time";
+		if( any ) {
+			for( size_t i = 0; i < perfCounterCount; ++i )
+				output << setw(15) << counterNames[i];
+			output << setw(7) << "IPC";
+		}
+		output << '\n';
+
+		const auto cycles = static_cast<size_t>(PerfCounter::Cycles);
+		const auto instructions = static_cast<size_t>(PerfCounter::Instructions);
+
+		for( const auto& stage : stages ) {
+			output << indentLevel1 << left << setw(20) << stage.name << right << setw(10) << stage.calls
+				<< setw(14) << formatTime(stage.nanoseconds);
+			if( any ) {
+				for( size_t i = 0; i < perfCounterCount; ++i ) {
+					if( available[i] )
+						output << setw(15) << stage.values[i];
+					else
+						output << setw(15) << '-';
+				}
+				if( available[cycles] && available[instructions] && stage.values[cycles] > 0 )
+					output << setw(7) << fixed << setprecision(2)
+						<< static_cast<double>(stage.values[instructions]) / stage.values[cycles] << defaultfloat;
+				else
+					output << setw(7) << '-';
+			}
+			output << '\n';
+		}
+
+		output.flags(flags);
+		output.precision(precision);
+	}
+
+	void readThreadCounters(PerfValues& values) noexcept {
+		try {
+			threadState().counters->read(values);
+		}
+		catch( ... ) {
+			values.fill(0);
+		}
+	}
+
+	void recordStage(const char* name, int64_t nanoseconds, const PerfValues& start, const PerfValues& end) noexcept {
+		try {
+			auto& stages = *threadState().stages;
+			const auto generation = registry().generation.load(memory_order_relaxed);
+
+			// Counts left over from an earlier run start afresh
+			if( stages.generation != generation ) {
+				stages.stages.clear();
+				stages.generation = generation;
+			}
+
+			auto it = find_if(stages.stages.begin(), stages.stages.end(), [&](const StageTotals& s) { return s.name == name; });
+
+			if( it == stages.stages.end() )
+				it = stages.stages.insert(stages.stages.end(), StageTotals{ name });
+			++it->calls;
+			it->nanoseconds += static_cast<uint64_t>(max<int64_t>(nanoseconds, 0));
+			for( size_t i = 0; i < perfCounterCount; ++i )
+				it->values[i] += end[i] >= start[i] ? end[i] - start[i] : 0;
+		}
+		catch( ... ) {
+			// A stage lost to memory exhaustion is not worth failing a conversion
+		}
+	}
+}
@@ -0,0 +1,106 @@
+/**
+ *	@file perfcounters.h
+ *	@brief Hardware and software performance counters sampled per stage.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_PERFCOUNTERS_H
+#define SITHCODEC_PERFCOUNTERS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace SithCodec {
+	/**
+	 *	@brief Enumerator of the counters sampled.
+	 */
+	enum class PerfCounter {
+		Cycles,
+		Instructions,
+		CacheMisses,
+		ContextSwitches,
+		PageFaults,
+	};
+
+	constexpr std::size_t perfCounterCount = 5;
+
+	/**
+	 *	@brief Values of every counter, indexed by PerfCounter.
+	 */
+	using PerfValues = std::array<std::uint64_t, perfCounterCount>;
+
+	/**
+	 *	@brief Whether stages are being counted; read through isCounting().
+	 */
+	inline std::atomic<bool> countingEnabled{ false };
+
+	/**
+	 *	@brief Determines whether stages are being counted.
+	 *
+	 *	@return true between startCounting() and writeCounters()
+	 */
+	inline bool isCounting() noexcept {
+		return countingEnabled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 *	@brief Starts counting the whole run and every TraceSpan stage,
+	 *		   discarding any counts from before.
+	 *	@details Counters are opened with perf_event_open(2) on Linux. Those
+	 *			 the system does not permit, such as hardware counters in an
+	 *			 unprivileged container, are left out; kernel-mode counting is
+	 *			 dropped if only user mode is allowed. With no counter at all,
+	 *			 stages are still timed.
+	 */
+	void startCounting();
+
+	/**
+	 *	@brief Stops counting and writes a table of the run and of each stage.
+	 *	@details Must not be called while other threads are still counting.
+	 *
+	 *	@param output output stream
+	 */
+	void writeCounters(std::ostream& output);
+
+	/**
+	 *	@brief Reads the calling thread's counters, opening them the first
+	 *		   time.
+	 *
+	 *	@param values receives the counts; those not available are 0
+	 */
+	void readThreadCounters(PerfValues& values) noexcept;
+
+	/**
+	 *	@brief Adds one pass through a stage to the calling thread's totals.
+	 *
+	 *	@param name		   name of the stage; must outlive the count
+	 *	@param nanoseconds duration
+	 *	@param start	   counters read at the start
+	 *	@param end		   counters read at the end
+	 */
+	void recordStage(const char* name, std::int64_t nanoseconds, const PerfValues& start, const PerfValues& end) noexcept;
+}
+
+#endif
@@ -0,0 +1,201 @@
+/**
+ *	@file progress.cpp
+ *	@brief Live progress of a batch, sampled from its statistics.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "progress.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#ifdef SITHCODEC_POSIX
+#include <unistd.h>
+#endif
+
+namespace SithCodec {
+	using namespace std;
+
+	namespace {
+		/**
+		 *	@brief Weight of the newest sample in the smoothed throughput.
+		 */
+		constexpr double rateSmoothing = 0.3;
+
+		/**
+		 *	@brief Longest time left worth showing, in seconds. While a batch
+		 *		   stalls the smoothed throughput decays towards zero, and the
+		 *		   time left grows without bound.
+		 */
+		constexpr double longestTimeLeft = 1000 * 3600;
+
+		/**
+		 *	@brief Formats seconds as h:mm:ss.
+		 */
+		string formatClock(double seconds) {
+			const auto total = static_cast<uint64_t>(seconds);
+			ostringstream str;
+
+			str << total / 3600 << ':' << setfill('0') << setw(2) << total / 60 % 60 << ':' << setw(2) << total % 60;
+			return str.str();
+		}
+
+		/**
+		 *	@brief Formats a byte count in megabytes, or gigabytes once large.
+		 */
+		string formatBytes(uint64_t bytes) {
+			ostringstream str;
+
+			str << fixed << setprecision(1);
+			if( bytes < 1000000000 )
+				str << bytes / 1e6 << " MB";
+			else
+				str << bytes / 1e9 << " GB";
+			return str.str();
+		}
+
+		double smooth(double rate, double sample) {
+			return rate < 0 ? sample : rate + rateSmoothing * (sample - rate);
+		}
+	}
+
+	ProgressStyle progressStyleFor(const ostream& output) {
+#ifdef SITHCODEC_POSIX
+		int fd = -1;
+
+		if( &output == &cout )
+			fd = STDOUT_FILENO;
+		else if( &output == &cerr || &output == &clog )
+			fd = STDERR_FILENO;
+		if( fd != -1 && ::isatty(fd) )
+			return ProgressStyle::StatusLine;
+#endif
+		return ProgressStyle::Lines;
+	}
+
+	ProgressReport::ProgressReport(ostream& output, const BatchStats& stats, ProgressStyle style, chrono::milliseconds interval)
+		: output(output), stats(stats), style(style), interval(interval) {
+		reporter = thread([this] {
+			unique_lock lock(mutex);
+
+			while( !wake.wait_for(lock, this->interval, [this] { return stopping; }) ) {
+				lock.unlock();
+				report(false);
+				lock.lock();
+			}
+		});
+	}
+
+	ProgressReport::~ProgressReport() {
+		stop();
+	}
+
+	void ProgressReport::finish() {
+		stop();
+		report(true);
+	}
+
+	void ProgressReport::report(bool last) {
+		const auto elapsed = stats.elapsed();
+		const auto bytes = stats.bytesFinished();
+		const auto files = stats.filesFinished();
+
+		// Nothing to say before the batch starts
+		if( elapsed == 0 && !last )
+			return;
+
+		if( elapsed > lastElapsed ) {
+			const auto seconds = elapsed - lastElapsed;
+
+			byteRate = smooth(byteRate, (bytes - lastBytes) / seconds);
+			fileRate = smooth(fileRate, (files - lastFiles) / seconds);
+			lastElapsed = elapsed;
+			lastBytes = bytes;
+			lastFiles = files;
+		}
+
+		const auto text = describe(last);
+
+		if( style == ProgressStyle::Lines ) {
+			output << text << endl;
+			return;
+		}
+
+		// Padded over the previous line, and the cursor left at its start so
+		// that any other output overwrites the status instead of trailing it
+		output << '\r' << text;
+		if( text.size() < lastWidth )
+			output << string(lastWidth - text.size(), ' ');
+		output << (last ? '\n' : '\r') << flush;
+		lastWidth = text.size();
+	}
+
+	void ProgressReport::stop() {
+		{
+			lock_guard lock(mutex);
+
+			stopping = true;
+		}
+		wake.notify_all();
+		if( reporter.joinable() )
+			reporter.join();
+	}
+
+	string ProgressReport::describe(bool last) const {
+		const bool known = stats.isEnumerated();
+		const auto elapsed = stats.elapsed();
+		const auto files = stats.filesFinished();
+		const auto totalFiles = stats.filesQueued();
+		const auto bytes = stats.bytesFinished();
+		const auto totalBytes = stats.bytesQueued();
+		// The last report gives the average over the whole batch
+		const auto rate = last ? (elapsed > 0 ? bytes / elapsed : 0) : max(byteRate, 0.0);
+		const auto filesPerSecond = last ? (elapsed > 0 ? files / elapsed : 0) : max(fileRate, 0.0);
+		const char* more = known ? "" : "+";
+		ostringstream str;
+
+		str
+			<< '[' << formatClock(elapsed) << "] "
+			<< files << '/' << totalFiles << more << " files, "
+			<< formatBytes(bytes) << " / " << formatBytes(totalBytes) << more << ", "
+			<< fixed << setprecision(1) << rate / 1e6 << " MB/s (" << setprecision(0) << filesPerSecond << " files/s)";
+
+		if( last || !known )
+			return str.str();
+
+		// Bytes predict best, but inputs of unknown size leave only files
+		double left = -1;
+
+		if( totalBytes > bytes && rate > 0 )
+			left = (totalBytes - bytes) / rate;
+		else if( totalFiles > files && filesPerSecond > 0 )
+			left = (totalFiles - files) / filesPerSecond;
+
+		if( left >= 0 && left <= longestTimeLeft )
+			str << ", " << formatClock(left) << " left";
+		else if( totalFiles > files )
+			str << ", time left unknown";
+		return str.str();
+	}
+}
@@ -0,0 +1,117 @@
+/**
+ *	@file progress.h
+ *	@brief Live progress of a batch, sampled from its statistics.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_PROGRESS_H
+#define SITHCODEC_PROGRESS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+#include "batchstats.h"
+
+namespace SithCodec {
+	/**
+	 *	@brief Enumerator of ProgressReport layouts.
+	 */
+	enum class ProgressStyle {
+		StatusLine,	///< one line redrawn in place, for a terminal
+		Lines,		///< a new line every interval, for log files
+	};
+
+	/**
+	 *	@brief Chooses the layout suited to a stream.
+	 *
+	 *	@param output output stream
+	 *
+	 *	@return ProgressStyle::StatusLine for a standard stream attached to a
+	 *			terminal, otherwise ProgressStyle::Lines
+	 */
+	ProgressStyle progressStyleFor(const std::ostream& output);
+
+	/**
+	 *	@brief Reports files and bytes done, throughput and the time left
+	 *		   while a batch runs.
+	 *	@details A background thread samples the lock-free counters of
+	 *			 BatchStats every interval, so the workers do nothing extra.
+	 *			 Throughput is smoothed over recent samples. While files are
+	 *			 still being enumerated the totals are shown as lower bounds
+	 *			 and no time left is given.
+	 */
+	class ProgressReport {
+	public:
+		/**
+		 *	@brief Starts reporting.
+		 *
+		 *	@param output	output stream; must outlive this object
+		 *	@param stats	statistics of the batch; must outlive this object
+		 *	@param style	layout
+		 *	@param interval time between reports
+		 */
+		ProgressReport(std::ostream& output, const BatchStats& stats, ProgressStyle style, std::chrono::milliseconds interval);
+
+		/**
+		 *	@brief Stops reporting without a final report.
+		 */
+		~ProgressReport();
+
+		ProgressReport(const ProgressReport&) = delete;
+		ProgressReport& operator=(const ProgressReport&) = delete;
+
+		/**
+		 *	@brief Stops reporting and reports the final counts.
+		 */
+		void finish();
+
+	private:
+		void report(bool last);
+		void stop();
+		std::string describe(bool last) const;
+
+		std::ostream& output;
+		const BatchStats& stats;
+		const ProgressStyle style;
+		const std::chrono::milliseconds interval;
+		std::mutex mutex;
+		std::condition_variable wake;
+		bool stopping = false;
+		std::thread reporter;
+
+		// Owned by whichever thread reports
+		double lastElapsed = 0;
+		std::uint64_t lastBytes = 0;
+		std::uint64_t lastFiles = 0;
+		double byteRate = -1;	///< smoothed bytes per second, or -1 before the first sample
+		double fileRate = -1;	///< smoothed files per second
+		std::size_t lastWidth = 0;	///< length of the status line drawn last
+	};
+}
+
+#endif
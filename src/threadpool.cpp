@@ -0,0 +1,222 @@
+/**
+ *	@file threadpool.cpp
+ *	@brief Work-stealing thread pool used by the batch functions.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "threadpool.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <utility>
+
+namespace SithCodec {
+	using namespace std;
+
+	namespace {
+		thread_local const ThreadPool* currentPool = nullptr;
+		thread_local unsigned currentIndex = 0;
+
+		/**
+		 *	@brief Reads the CPU limit imposed by a cgroup quota.
+		 *
+		 *	@return number of CPUs allowed, or 0 if there is no quota
+		 */
+		unsigned cgroupCpuLimit() {
+			long long quota = -1, period = 0;
+
+			// cgroup v2: "<quota> <period>" or "max <period>"
+			if( ifstream file("/sys/fs/cgroup/cpu.max"); file ) {
+				string str;
+
+				if( file >> str >> period && str != "max" )
+					quota = stoll(str);
+			}
+			// cgroup v1
+			else if( ifstream quotaFile("/sys/fs/cgroup/cpu/cpu.cfs_quota_us"); quotaFile ) {
+				ifstream periodFile("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+
+				if( !(quotaFile >> quota && periodFile >> period) )
+					quota = -1;
+			}
+
+			if( quota <= 0 || period <= 0 )
+				return 0;
+
+			return static_cast<unsigned>(max(1LL, (quota + period - 1) / period));
+		}
+	}
+
+	ThreadPool::ThreadPool(unsigned workers) {
+		if( workers == 0 )
+			workers = defaultWorkerCount();
+
+		queues.reserve(workers);
+		for( unsigned i = 0; i < workers; ++i )
+			queues.push_back(make_unique<Queue>());
+
+		threads.reserve(workers);
+		for( unsigned i = 0; i < workers; ++i )
+			threads.emplace_back(&ThreadPool::run, this, i);
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			unique_lock lock(mutex);
+
+			finished.wait(lock, [this] { return pending == 0; });
+			stopping = true;
+		}
+		available.notify_all();
+
+		for( auto& thread : threads )
+			thread.join();
+	}
+
+	void ThreadPool::submit(Task task) {
+		const unsigned index = currentPool == this
+			? currentIndex
+			: next++ % size();
+
+		++pending;
+		{
+			lock_guard lock(mutex);
+
+			++queued;
+		}
+		{
+			lock_guard lock(queues[index]->mutex);
+
+			queues[index]->tasks.push_back(move(task));
+		}
+		available.notify_one();
+	}
+
+	void ThreadPool::wait() {
+		unique_lock lock(mutex);
+
+		finished.wait(lock, [this] { return pending == 0; });
+
+		if( error )
+			rethrow_exception(exchange(error, nullptr));
+	}
+
+	unsigned ThreadPool::size() const noexcept {
+		return static_cast<unsigned>(threads.size());
+	}
+
+	bool ThreadPool::pop(unsigned index, Task& task) {
+		auto& queue = *queues[index];
+		lock_guard lock(queue.mutex);
+
+		if( queue.tasks.empty() )
+			return false;
+
+		task = move(queue.tasks.back());
+		queue.tasks.pop_back();
+		return true;
+	}
+
+	bool ThreadPool::steal(unsigned index, Task& task) {
+		const auto count = static_cast<unsigned>(queues.size());
+
+		for( unsigned i = 1; i < count; ++i ) {
+			auto& queue = *queues[(index + i) % count];
+			lock_guard lock(queue.mutex);
+
+			if( !queue.tasks.empty() ) {
+				task = move(queue.tasks.front());
+				queue.tasks.pop_front();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void ThreadPool::run(unsigned index) {
+		currentPool = this;
+		currentIndex = index;
+
+		for( ;; ) {
+			Task task;
+
+			if( pop(index, task) || steal(index, task) ) {
+				{
+					lock_guard lock(mutex);
+
+					--queued;
+				}
+
+				try {
+					task();
+				}
+				catch( ... ) {
+					lock_guard lock(mutex);
+
+					if( !error )
+						error = current_exception();
+				}
+
+				if( --pending == 0 ) {
+					lock_guard lock(mutex);
+
+					finished.notify_all();
+				}
+				continue;
+			}
+
+			unique_lock lock(mutex);
+
+			available.wait(lock, [this] { return queued > 0 || stopping; });
+
+			if( stopping && queued == 0 )
+				return;
+		}
+	}
+
+	unsigned defaultWorkerCount() {
+		const unsigned hardware = max(1U, thread::hardware_concurrency());
+		const unsigned quota = cgroupCpuLimit();
+
+		return quota ? min(hardware, quota) : hardware;
+	}
+
+	void parallelFor(size_t count, unsigned workers, const function<void(size_t)>& body) {
+		if( workers == 0 )
+			workers = defaultWorkerCount();
+
+		if( workers == 1 || count < 2 ) {
+			for( size_t i = 0; i < count; ++i )
+				body(i);
+			return;
+		}
+
+		ThreadPool pool(static_cast<unsigned>(min<size_t>(workers, count)));
+
+		for( size_t i = 0; i < count; ++i )
+			pool.submit([&body, i] { body(i); });
+
+		pool.wait();
+	}
+}
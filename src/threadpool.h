@@ -0,0 +1,131 @@
+/**
+ *	@file threadpool.h
+ *	@brief Work-stealing thread pool used by the batch functions.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_THREADPOOL_H
+#define SITHCODEC_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SithCodec {
+	/**
+	 *	@brief Fixed-size pool of worker threads with one task queue per worker.
+	 *	@details Tasks submitted from outside the pool are dealt round-robin to
+	 *			 the worker queues. Tasks submitted from a worker go to that
+	 *			 worker's own queue. A worker takes from the back of its own
+	 *			 queue and, when it runs dry, steals from the front of the others.
+	 */
+	class ThreadPool {
+	public:
+		using Task = std::function<void()>;
+
+		/**
+		 *	@brief Starts the worker threads.
+		 *
+		 *	@param workers number of worker threads, or 0 for defaultWorkerCount()
+		 */
+		explicit ThreadPool(unsigned workers = 0);
+
+		/**
+		 *	@brief Waits for outstanding tasks, then joins the worker threads.
+		 */
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		/**
+		 *	@brief Queues a task for execution.
+		 *
+		 *	@param task task to run
+		 */
+		void submit(Task task);
+
+		/**
+		 *	@brief Blocks until every submitted task has finished.
+		 *
+		 *	@throws the first exception that escaped a task, if any
+		 */
+		void wait();
+
+		/**
+		 *	@brief Gets the number of worker threads.
+		 *
+		 *	@return number of workers
+		 */
+		unsigned size() const noexcept;
+
+	private:
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		bool pop(unsigned index, Task& task);
+		bool steal(unsigned index, Task& task);
+		void run(unsigned index);
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> threads;
+		std::mutex mutex;
+		std::condition_variable available;
+		std::condition_variable finished;
+		std::size_t queued = 0;
+		std::atomic<std::size_t> pending{ 0 };
+		std::atomic<unsigned> next{ 0 };
+		std::exception_ptr error;
+		bool stopping = false;
+	};
+
+	/**
+	 *	@brief Gets the number of CPUs this process may use.
+	 *	@details Honors a cgroup CPU quota when one is set, so containers with
+	 *			 a fractional share of a large machine do not oversubscribe.
+	 *
+	 *	@return number of CPUs, at least 1
+	 */
+	unsigned defaultWorkerCount();
+
+	/**
+	 *	@brief Calls a function once for every index in [0, count).
+	 *	@details Runs inline on the calling thread when only one worker is
+	 *			 requested, otherwise distributes the indices over a ThreadPool.
+	 *
+	 *	@param count   number of indices
+	 *	@param workers number of worker threads, or 0 for defaultWorkerCount()
+	 *	@param body	   function to call with each index
+	 */
+	void parallelFor(std::size_t count, unsigned workers, const std::function<void(std::size_t)>& body);
+}
+
+#endif
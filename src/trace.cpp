@@ -0,0 +1,251 @@
+/**
+ *	@file trace.cpp
+ *	@brief Recording of per-stage timings in Chrome trace-event format.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "trace.h"
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace SithCodec {
+	namespace fs = std::filesystem;
+	using namespace std;
+
+	namespace {
+		struct Event {
+			const char* name;
+			string file;
+			int64_t start;
+			int64_t end;
+			bool async;
+		};
+
+		/**
+		 *	@brief Events of one thread. Only the owning thread appends, so
+		 *		   no lock is needed until the trace is written.
+		 */
+		struct ThreadBuffer {
+			explicit ThreadBuffer(unsigned id) : id(id) {}
+
+			unsigned id;
+			unsigned generation = 0;	///< trace the events belong to
+			deque<Event> events;
+		};
+
+		/**
+		 *	@brief Every thread's buffer, kept after the thread exits.
+		 */
+		struct Registry {
+			mutex guard;
+			vector<shared_ptr<ThreadBuffer>> buffers;
+			atomic<unsigned> generation{ 0 };
+			int64_t origin = 0;
+			unsigned mainThread = 0;	///< thread that started the trace
+		};
+
+		Registry& registry() {
+			static Registry instance;
+
+			return instance;
+		}
+
+		/**
+		 *	@brief Gets the calling thread's buffer, registering it the first
+		 *		   time; the only step that takes a lock.
+		 */
+		ThreadBuffer& threadBuffer() {
+			thread_local shared_ptr<ThreadBuffer> buffer;
+
+			if( !buffer ) {
+				auto& reg = registry();
+				lock_guard lock(reg.guard);
+
+				buffer = make_shared<ThreadBuffer>(static_cast<unsigned>(reg.buffers.size()) + 1);
+				reg.buffers.push_back(buffer);
+			}
+
+			return *buffer;
+		}
+
+		void append(const char* name, const fs::path* file, int64_t start, int64_t end, bool async) noexcept {
+			try {
+				auto& buffer = threadBuffer();
+				const auto generation = registry().generation.load(memory_order_relaxed);
+
+				// A buffer left over from an earlier trace starts afresh
+				if( buffer.generation != generation ) {
+					buffer.events.clear();
+					buffer.generation = generation;
+				}
+
+				buffer.events.push_back({ name, file ? file->string() : string(), start, end, async });
+			}
+			catch( ... ) {
+				// A span lost to memory exhaustion is not worth failing a conversion
+			}
+		}
+
+		void appendJsonString(ostream& output, const string& str) {
+			output << '"';
+			for( const char ch : str ) {
+				const auto byte = static_cast<unsigned char>(ch);
+
+				if( ch == '"' || ch == '\\' )
+					output << '\\' << ch;
+				else if( byte < 0x20 )
+					output << "\\u00" << "0123456789abcdef"[byte >> 4] << "0123456789abcdef"[byte & 0xf];
+				else
+					output << ch;
+			}
+			output << '"';
+		}
+
+		/**
+		 *	@brief Writes a time in the microseconds trace events use.
+		 */
+		void appendMicroseconds(ostream& output, int64_t nanoseconds) {
+			const char* sign = nanoseconds < 0 ? "-" : "";
+			const auto magnitude = nanoseconds < 0 ? -nanoseconds : nanoseconds;
+			auto fraction = to_string(magnitude % 1000);
+
+			fraction.insert(0, 3 - fraction.size(), '0');
+			output << sign << magnitude / 1000 << '.' << fraction;
+		}
+	}
+
+	void startTrace() {
+		auto& reg = registry();
+		const auto thread = threadBuffer().id;
+
+		{
+			lock_guard lock(reg.guard);
+
+			reg.mainThread = thread;
+			++reg.generation;
+			reg.origin = traceClock();
+		}
+		tracingEnabled.store(true);
+	}
+
+	void writeTrace(ostream& output) {
+		tracingEnabled.store(false);
+
+		auto& reg = registry();
+		lock_guard lock(reg.guard);
+		bool first = true;
+		uint64_t asyncId = 0;
+
+		const auto separator = [&] {
+			output << (first ? "\n" : ",\n");
+			first = false;
+		};
+
+		output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+		for( const auto& buffer : reg.buffers ) {
+			if( buffer->generation != reg.generation || buffer->events.empty() )
+				continue;
+
+			separator();
+			output << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+				<< ",\"args\":{\"name\":\"" << (buffer->id == reg.mainThread ? "main" : "thread " + to_string(buffer->id)) << "\"}}";
+
+			for( const auto& event : buffer->events ) {
+				const auto start = event.start - reg.origin;
+
+				separator();
+				if( event.async ) {
+					// Overlapping spans on one thread need a begin/end pair with an id
+					++asyncId;
+					output << "{\"name\":\"" << event.name << "\",\"cat\":\"file\",\"ph\":\"b\",\"id\":" << asyncId
+						<< ",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":";
+					appendMicroseconds(output, start);
+					output << ",\"args\":{\"file\":";
+					appendJsonString(output, event.file);
+					output << "}},\n{\"name\":\"" << event.name << "\",\"cat\":\"file\",\"ph\":\"e\",\"id\":" << asyncId
+						<< ",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":";
+					appendMicroseconds(output, event.end - reg.origin);
+					output << '}';
+					continue;
+				}
+
+				output << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":";
+				appendMicroseconds(output, start);
+				output << ",\"dur\":";
+				appendMicroseconds(output, event.end - event.start);
+				if( !event.file.empty() ) {
+					output << ",\"args\":{\"file\":";
+					appendJsonString(output, event.file);
+					output << '}';
+				}
+				output << '}';
+			}
+
+			buffer->events = deque<Event>();
+		}
+
+		output << "\n]}\n";
+	}
+
+	int64_t traceClock() noexcept {
+		return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void TraceSpan::begin() noexcept {
+		traced = isTracing();
+		counted = isCounting();
+		allocationsCounted = isCountingAllocations();
+		if( counted )
+			readThreadCounters(counters);
+		if( allocationsCounted ) {
+			peakResident = peakResidentBytes();
+			allocations = threadAllocations();
+		}
+		start = traceClock();
+	}
+
+	void TraceSpan::record() noexcept {
+		const auto end = traceClock();
+
+		if( traced )
+			append(name, file, start, end, false);
+		if( counted ) {
+			PerfValues now;
+
+			readThreadCounters(now);
+			recordStage(name, end - start, counters, now);
+		}
+		if( allocationsCounted )
+			recordAllocationStage(name, allocations, threadAllocations(), peakResident, peakResidentBytes());
+	}
+
+	void recordAsyncSpan(const char* name, const fs::path& file, int64_t start, int64_t end) noexcept {
+		if( isTracing() )
+			append(name, &file, start, end, true);
+	}
+}
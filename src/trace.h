@@ -0,0 +1,146 @@
+/**
+ *	@file trace.h
+ *	@brief Recording of per-stage timings in Chrome trace-event format.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_TRACE_H
+#define SITHCODEC_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+
+#include "allocstats.h"
+#include "perfcounters.h"
+
+namespace SithCodec {
+	/**
+	 *	@brief Whether spans are being recorded; read through isTracing().
+	 */
+	inline std::atomic<bool> tracingEnabled{ false };
+
+	/**
+	 *	@brief Determines whether spans are being recorded.
+	 *
+	 *	@return true between startTrace() and writeTrace()
+	 */
+	inline bool isTracing() noexcept {
+		return tracingEnabled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 *	@brief Starts recording spans, discarding any recorded before.
+	 */
+	void startTrace();
+
+	/**
+	 *	@brief Stops recording and writes every span in Chrome trace-event
+	 *		   JSON, which Perfetto and chrome://tracing load.
+	 *	@details Must not be called while other threads are still recording.
+	 *
+	 *	@param output output stream
+	 */
+	void writeTrace(std::ostream& output);
+
+	/**
+	 *	@brief Gets the time spans are measured in.
+	 *
+	 *	@return nanoseconds on a monotonic clock
+	 */
+	std::int64_t traceClock() noexcept;
+
+	/**
+	 *	@brief Records the time between its construction and destruction as
+	 *		   one span on the calling thread.
+	 *	@details Does nothing but test three flags when tracing and both
+	 *			 kinds of counting are off. When tracing, the span is appended
+	 *			 to a buffer owned by the calling thread, so recording takes
+	 *			 no lock. When counting, the thread's performance counters, or
+	 *			 its allocations, are read at both ends and added to the
+	 *			 stage's totals.
+	 */
+	class TraceSpan {
+	public:
+		/**
+		 *	@brief Starts a span.
+		 *
+		 *	@param name name of the stage; must outlive the trace, e.g. a literal
+		 */
+		explicit TraceSpan(const char* name) noexcept
+			: name(name) {
+			if( isTracing() || isCounting() || isCountingAllocations() )
+				begin();
+		}
+
+		/**
+		 *	@brief Starts a span for a file, which is shown with the span.
+		 *
+		 *	@param name name of the stage; must outlive the trace
+		 *	@param file path of file; must outlive the span
+		 */
+		TraceSpan(const char* name, const std::filesystem::path& file) noexcept
+			: name(name), file(&file) {
+			if( isTracing() || isCounting() || isCountingAllocations() )
+				begin();
+		}
+
+		TraceSpan(const char* name, std::filesystem::path&& file) = delete;
+
+		TraceSpan(const TraceSpan&) = delete;
+		TraceSpan& operator=(const TraceSpan&) = delete;
+
+		~TraceSpan() {
+			if( start >= 0 )
+				record();
+		}
+
+	private:
+		void begin() noexcept;
+		void record() noexcept;
+
+		const char* name;
+		const std::filesystem::path* file = nullptr;
+		std::int64_t start = -1;
+		bool traced = false;
+		bool counted = false;
+		bool allocationsCounted = false;
+		PerfValues counters;
+		AllocationCounts allocations;
+		std::uint64_t peakResident = 0;
+	};
+
+	/**
+	 *	@brief Records a span whose start and end were measured separately,
+	 *		   such as a file in flight on io_uring. Such spans may overlap
+	 *		   others on the same thread.
+	 *
+	 *	@param name	 name of the stage; must outlive the trace
+	 *	@param file	 path of file
+	 *	@param start start time from traceClock()
+	 *	@param end	 end time from traceClock()
+	 */
+	void recordAsyncSpan(const char* name, const std::filesystem::path& file, std::int64_t start, std::int64_t end) noexcept;
+}
+
+#endif
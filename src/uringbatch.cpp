@@ -0,0 +1,629 @@
+/**
+ *	@file uringbatch.cpp
+ *	@brief Whole-tree conversion driven by a single io_uring instance.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include "uringbatch.h"
+
+#ifdef SITHCODEC_URING
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "trace.h"
+#endif
+
+namespace SithCodec {
+	namespace fs = std::filesystem;
+	using namespace std;
+
+#ifdef SITHCODEC_URING
+	namespace {
+		/**
+		 *	@brief Minimal io_uring submission/completion ring.
+		 */
+		class Ring {
+		public:
+			explicit Ring(unsigned entries) {
+				io_uring_params params{};
+
+				fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+
+				if( fd < 0 )
+					return;
+
+				sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+				cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+				const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+
+				if( single )
+					sqSize = cqSize = max(sqSize, cqSize);
+
+				sq = ::mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+				cq = single ? sq : ::mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+				sqeSize = params.sq_entries * sizeof(io_uring_sqe);
+				sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, sqeSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+
+				if( sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED )
+					return;
+
+				auto* sqBase = static_cast<char*>(sq);
+				auto* cqBase = static_cast<char*>(cq);
+
+				sqHead = reinterpret_cast<unsigned*>(sqBase + params.sq_off.head);
+				sqTail = reinterpret_cast<unsigned*>(sqBase + params.sq_off.tail);
+				sqMask = *reinterpret_cast<unsigned*>(sqBase + params.sq_off.ring_mask);
+				sqArray = reinterpret_cast<unsigned*>(sqBase + params.sq_off.array);
+				sqEntries = params.sq_entries;
+				cqHead = reinterpret_cast<unsigned*>(cqBase + params.cq_off.head);
+				cqTail = reinterpret_cast<unsigned*>(cqBase + params.cq_off.tail);
+				cqMask = *reinterpret_cast<unsigned*>(cqBase + params.cq_off.ring_mask);
+				cqes = reinterpret_cast<io_uring_cqe*>(cqBase + params.cq_off.cqes);
+				tail = *sqTail;
+				ready = true;
+			}
+
+			~Ring() {
+				if( sqes && sqes != MAP_FAILED )
+					::munmap(sqes, sqeSize);
+				if( cq && cq != MAP_FAILED && cq != sq )
+					::munmap(cq, cqSize);
+				if( sq && sq != MAP_FAILED )
+					::munmap(sq, sqSize);
+				if( fd >= 0 )
+					::close(fd);
+			}
+
+			Ring(const Ring&) = delete;
+			Ring& operator=(const Ring&) = delete;
+
+			/**
+			 *	@brief Whether the ring was set up and supports every operation.
+			 */
+			bool supports(initializer_list<int> opcodes) const {
+				if( !ready )
+					return false;
+
+				constexpr unsigned count = 256;
+				vector<unsigned char> buffer(sizeof(io_uring_probe) + count * sizeof(io_uring_probe_op));
+				auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+
+				if( ::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, count) < 0 )
+					return false;
+
+				for( int opcode : opcodes )
+					if( opcode > probe->last_op || !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) )
+						return false;
+
+				return true;
+			}
+
+			/**
+			 *	@brief Claims the next submission entry.
+			 *
+			 *	@return zeroed entry, or nullptr if the queue is full
+			 */
+			io_uring_sqe* next() {
+				if( tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries )
+					return nullptr;
+
+				const unsigned index = tail & sqMask;
+				auto* sqe = &sqes[index];
+
+				memset(sqe, 0, sizeof(*sqe));
+				sqArray[index] = index;
+				++tail;
+				++unsubmitted;
+				return sqe;
+			}
+
+			/**
+			 *	@brief Submits queued entries and waits for at least one completion.
+			 *
+			 *	@return false on an unrecoverable ring error
+			 */
+			bool submitAndWait() {
+				__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+				for( ;; ) {
+					const auto n = ::syscall(__NR_io_uring_enter, fd, unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+					if( n >= 0 ) {
+						unsubmitted -= static_cast<unsigned>(n);
+						return true;
+					}
+					if( errno != EINTR && errno != EAGAIN && errno != EBUSY )
+						return false;
+				}
+			}
+
+			/**
+			 *	@brief Hands every available completion to a function.
+			 *
+			 *	@param handle function taking the user data and result
+			 */
+			template<class Handler>
+			void reap(Handler&& handle) {
+				unsigned head = *cqHead;
+
+				for( ;; ) {
+					if( head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE) )
+						break;
+
+					const auto& cqe = cqes[head & cqMask];
+					const auto userData = cqe.user_data;
+					const auto result = cqe.res;
+
+					__atomic_store_n(cqHead, ++head, __ATOMIC_RELEASE);
+					handle(userData, result);
+				}
+			}
+
+		private:
+			int fd = -1;
+			void* sq = nullptr;
+			void* cq = nullptr;
+			io_uring_sqe* sqes = nullptr;
+			size_t sqSize = 0, cqSize = 0, sqeSize = 0;
+			unsigned *sqHead = nullptr, *sqTail = nullptr, *sqArray = nullptr;
+			unsigned *cqHead = nullptr, *cqTail = nullptr;
+			unsigned sqMask = 0, sqEntries = 0, cqMask = 0;
+			io_uring_cqe* cqes = nullptr;
+			unsigned tail = 0, unsubmitted = 0;
+			bool ready = false;
+		};
+
+		/**
+		 *	@brief Steps a file goes through, each one a single ring operation.
+		 */
+		enum class Stage {
+			OpenInput,
+			Probe,
+			OpenOutput,
+			WriteHeader,
+			Write,
+			Read,
+			CloseInput,
+			CloseOutput,
+			Rename,
+			Unlink,
+		};
+
+		/**
+		 *	@brief State of one file in flight.
+		 */
+		struct Slot {
+			FileOperation operation;
+			Stage stage = Stage::OpenInput;
+			AudioFormat format = AudioFormat::None;
+			int input = -1, output = -1;
+			string inputPath, outputPath, finalPath, stagingPath;
+			vector<char> buffer;
+			size_t start = 0, end = 0, headerWritten = 0;
+			uint64_t readOffset = 0, writeOffset = 0;
+			bool eof = false, staged = false, retried = false;
+			int64_t started = 0;	///< traceClock() at start
+		};
+
+		/**
+		 *	@brief Runs the batch through a ring.
+		 */
+		class Batch {
+		public:
+			using Accept = function<bool(FileOperation&, const fs::path&)>;
+			using Finish = function<void(FileOperation&, const FileConversion&, uint64_t)>;
+
+			Batch(Ring& ring, BoundedQueue<FileOperation>& queue, const fs::path& inputPath, const fs::path& outputDirectory,
+				optional<AudioFormat> encodeFormat, unsigned queueDepth, const Accept& accept, const Finish& finish)
+				: ring(ring), queue(queue), inputPath(inputPath), outputDirectory(outputDirectory),
+				encodeFormat(encodeFormat), accept(accept), finish(finish), slots(queueDepth) {
+				for( auto& slot : slots )
+					slot.buffer.resize(max<size_t>(uringChunkSize, Header::maxSize));
+			}
+
+			/**
+			 *	@brief Converts files until the queue is drained or the ring fails.
+			 */
+			void run() {
+				unsigned active = 0;
+				bool more = true;
+				vector<size_t> idle;
+
+				for( size_t i = slots.size(); i > 0; --i )
+					idle.push_back(i - 1);
+
+				while( more || active > 0 ) {
+					// Only block on the queue when there is nothing to wait for in the ring
+					while( more && !idle.empty() ) {
+						auto operation = active == 0 ? queue.pop() : queue.tryPop();
+
+						if( !operation ) {
+							more = !queue.drained();
+							break;
+						}
+
+						if( !start(idle.back(), move(*operation)) )
+							continue;
+						idle.pop_back();
+						++active;
+					}
+
+					if( active == 0 )
+						continue;
+
+					if( !ring.submitAndWait() ) {
+						// Files already started cannot be handed back half done
+						for( size_t i = 0; i < slots.size(); ++i )
+							if( find(idle.begin(), idle.end(), i) == idle.end() )
+								fail(slots[i], CodecErrc::Write, 0);
+						return;
+					}
+
+					ring.reap([&](uint64_t userData, int result) {
+						if( !advance(slots[userData], result) ) {
+							idle.push_back(userData);
+							--active;
+						}
+					});
+				}
+			}
+
+		private:
+			/**
+			 *	@brief Submits the first step of a file.
+			 *
+			 *	@return false if the file was skipped and the slot is still free
+			 */
+			bool start(size_t id, FileOperation&& operation) {
+				auto& slot = slots[id];
+
+				slot.operation = move(operation);
+
+				const auto& path = slot.operation.path;
+				const auto outputPath = outputDirectory / getRelativePath(path, inputPath);
+
+				if( !accept(slot.operation, outputPath) )
+					return false;
+
+				slot.stage = Stage::OpenInput;
+				slot.format = encodeFormat.value_or(AudioFormat::None);
+				slot.input = slot.output = -1;
+				slot.inputPath = path.string();
+				slot.outputPath = outputPath.string();
+				slot.start = slot.end = slot.headerWritten = 0;
+				slot.readOffset = slot.writeOffset = 0;
+				slot.eof = slot.staged = slot.retried = false;
+				slot.started = traceClock();
+				submit(id, [&](io_uring_sqe& sqe) {
+					sqe.opcode = IORING_OP_OPENAT;
+					sqe.fd = AT_FDCWD;
+					sqe.addr = reinterpret_cast<uint64_t>(slot.inputPath.c_str());
+					sqe.open_flags = O_RDONLY | O_CLOEXEC;
+				});
+				return true;
+			}
+
+			/**
+			 *	@brief Handles the completion of a slot's current step.
+			 *
+			 *	@return false once the file is finished, successfully or not
+			 */
+			bool advance(Slot& slot, int result) {
+				const size_t id = static_cast<size_t>(&slot - slots.data());
+
+				switch( slot.stage ) {
+				case Stage::OpenInput:
+					if( result < 0 )
+						return fail(slot, CodecErrc::Open, result);
+					slot.input = result;
+					slot.stage = Stage::Probe;
+					read(id);
+					return true;
+
+				case Stage::Probe:
+					if( result < 0 )
+						return fail(slot, CodecErrc::Read, result);
+					slot.end += static_cast<size_t>(result);
+					slot.readOffset += static_cast<uint64_t>(result);
+					slot.eof = result == 0;
+					// formatOf needs a full header's worth of bytes unless the file is shorter
+					if( !slot.eof && slot.end < static_cast<size_t>(Header::maxSize) ) {
+						read(id);
+						return true;
+					}
+					if( !encodeFormat ) {
+						slot.format = formatOf(slot.buffer.data(), slot.end);
+						slot.start = slot.format == AudioFormat::None ? 0 : static_cast<size_t>(sizeOfHeader(slot.format));
+					}
+					slot.finalPath = fs::path(slot.outputPath).replace_extension(encodeFormat
+						? getEncodeExtension(slot.format)
+						: getDecodeExtension(slot.format)).string();
+					openOutput(id);
+					return true;
+
+				case Stage::OpenOutput:
+					if( result == -EEXIST ) {
+						openOutput(id);
+						return true;
+					}
+					if( result == -ENOENT && !slot.retried ) {
+						error_code error;
+
+						slot.retried = true;
+						create_directories(fs::path(slot.finalPath).parent_path(), error);
+						openOutput(id);
+						return true;
+					}
+					if( result < 0 )
+						return fail(slot, CodecErrc::Write, result);
+					slot.output = result;
+					slot.staged = true;
+					if( encodeFormat ) {
+						slot.stage = Stage::WriteHeader;
+						writeHeader(id);
+					}
+					else {
+						writeOrRead(id);
+					}
+					return true;
+
+				case Stage::WriteHeader:
+					// Nothing written would resubmit the same write forever
+					if( result <= 0 )
+						return fail(slot, CodecErrc::Write, result < 0 ? result : -EIO);
+					slot.headerWritten += static_cast<size_t>(result);
+					slot.writeOffset += static_cast<uint64_t>(result);
+					if( slot.headerWritten < static_cast<size_t>(sizeOfHeader(slot.format)) )
+						writeHeader(id);
+					else
+						writeOrRead(id);
+					return true;
+
+				case Stage::Write:
+					// Nothing written would resubmit the same write forever
+					if( result <= 0 )
+						return fail(slot, CodecErrc::Write, result < 0 ? result : -EIO);
+					slot.start += static_cast<size_t>(result);
+					slot.writeOffset += static_cast<uint64_t>(result);
+					writeOrRead(id);
+					return true;
+
+				case Stage::Read:
+					if( result < 0 )
+						return fail(slot, CodecErrc::Read, result);
+					slot.end = static_cast<size_t>(result);
+					slot.readOffset += static_cast<uint64_t>(result);
+					slot.eof = result == 0;
+					writeOrRead(id);
+					return true;
+
+				case Stage::CloseInput:
+					slot.input = -1;
+					slot.stage = Stage::CloseOutput;
+					submit(id, [&](io_uring_sqe& sqe) {
+						sqe.opcode = IORING_OP_CLOSE;
+						sqe.fd = slot.output;
+					});
+					return true;
+
+				case Stage::CloseOutput:
+					slot.output = -1;
+					if( result < 0 )
+						return fail(slot, CodecErrc::Write, result);
+					slot.stage = Stage::Rename;
+					submit(id, [&](io_uring_sqe& sqe) {
+						sqe.opcode = IORING_OP_RENAMEAT;
+						sqe.fd = AT_FDCWD;
+						sqe.addr = reinterpret_cast<uint64_t>(slot.stagingPath.c_str());
+						sqe.len = static_cast<uint32_t>(AT_FDCWD);
+						sqe.addr2 = reinterpret_cast<uint64_t>(slot.finalPath.c_str());
+					});
+					return true;
+
+				case Stage::Rename:
+					if( result < 0 )
+						return fail(slot, CodecErrc::Write, result);
+					slot.staged = false;
+					// Matches removeReplaced() in the synchronous path
+					if( slot.outputPath == slot.finalPath )
+						return complete(slot);
+					slot.stage = Stage::Unlink;
+					submit(id, [&](io_uring_sqe& sqe) {
+						sqe.opcode = IORING_OP_UNLINKAT;
+						sqe.fd = AT_FDCWD;
+						sqe.addr = reinterpret_cast<uint64_t>(slot.outputPath.c_str());
+					});
+					return true;
+
+				case Stage::Unlink:
+					if( result < 0 && result != -ENOENT )
+						return fail(slot, CodecErrc::Delete, result);
+					return complete(slot);
+				}
+
+				return false;
+			}
+
+			template<class Prepare>
+			void submit(size_t id, Prepare&& prepare) {
+				auto* sqe = ring.next();
+
+				// One entry per slot is in flight at most, and the ring has at
+				// least as many entries as there are slots
+				prepare(*sqe);
+				sqe->user_data = id;
+			}
+
+			void read(size_t id) {
+				auto& slot = slots[id];
+
+				submit(id, [&](io_uring_sqe& sqe) {
+					sqe.opcode = IORING_OP_READ;
+					sqe.fd = slot.input;
+					sqe.addr = reinterpret_cast<uint64_t>(slot.buffer.data() + slot.end);
+					sqe.len = static_cast<uint32_t>(slot.buffer.size() - slot.end);
+					sqe.off = slot.readOffset;
+				});
+			}
+
+			void openOutput(size_t id) {
+				auto& slot = slots[id];
+
+				slot.stage = Stage::OpenOutput;
+				slot.stagingPath = getStagingPath(slot.finalPath).string();
+				submit(id, [&](io_uring_sqe& sqe) {
+					sqe.opcode = IORING_OP_OPENAT;
+					sqe.fd = AT_FDCWD;
+					sqe.addr = reinterpret_cast<uint64_t>(slot.stagingPath.c_str());
+					sqe.len = 0666;
+					sqe.open_flags = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC;
+				});
+			}
+
+			void writeHeader(size_t id) {
+				auto& slot = slots[id];
+
+				submit(id, [&](io_uring_sqe& sqe) {
+					sqe.opcode = IORING_OP_WRITE;
+					sqe.fd = slot.output;
+					sqe.addr = reinterpret_cast<uint64_t>(getHeader(slot.format) + slot.headerWritten);
+					sqe.len = static_cast<uint32_t>(sizeOfHeader(slot.format) - static_cast<streamsize>(slot.headerWritten));
+					sqe.off = slot.writeOffset;
+				});
+			}
+
+			void writeOrRead(size_t id) {
+				auto& slot = slots[id];
+
+				if( slot.start < slot.end ) {
+					slot.stage = Stage::Write;
+					submit(id, [&](io_uring_sqe& sqe) {
+						sqe.opcode = IORING_OP_WRITE;
+						sqe.fd = slot.output;
+						sqe.addr = reinterpret_cast<uint64_t>(slot.buffer.data() + slot.start);
+						sqe.len = static_cast<uint32_t>(slot.end - slot.start);
+						sqe.off = slot.writeOffset;
+					});
+				}
+				else if( slot.eof ) {
+					slot.stage = Stage::CloseInput;
+					submit(id, [&](io_uring_sqe& sqe) {
+						sqe.opcode = IORING_OP_CLOSE;
+						sqe.fd = slot.input;
+					});
+				}
+				else {
+					slot.start = slot.end = 0;
+					slot.stage = Stage::Read;
+					read(id);
+				}
+			}
+
+			/**
+			 *	@brief Reports a file converted successfully.
+			 *
+			 *	@return false, so the slot is released
+			 */
+			bool complete(Slot& slot) {
+				release(slot, { slot.finalPath, slot.format, slot.readOffset, slot.writeOffset });
+				return false;
+			}
+
+			/**
+			 *	@brief Hands a finished file to the caller and records it as one
+			 *		   span, since its steps overlap those of other files on the
+			 *		   ring thread.
+			 */
+			void release(Slot& slot, const FileConversion& conversion) {
+				const auto ended = traceClock();
+
+				finish(slot.operation, conversion, static_cast<uint64_t>(ended - slot.started));
+				recordAsyncSpan(encodeFormat ? "encode" : "decode", slot.operation.path, slot.started, ended);
+			}
+
+			/**
+			 *	@brief Records an error and releases whatever the file holds.
+			 *
+			 *	@param slot	  slot of the file
+			 *	@param code	  what failed
+			 *	@param result negated errno of the failed step, or 0
+			 *
+			 *	@return false, so the slot is released
+			 */
+			bool fail(Slot& slot, CodecErrc code, int result) {
+				if( slot.input >= 0 )
+					::close(slot.input);
+				if( slot.output >= 0 )
+					::close(slot.output);
+				if( slot.staged )
+					::unlink(slot.stagingPath.c_str());
+
+				slot.input = slot.output = -1;
+				slot.staged = false;
+				slot.operation.error = { code, -result };
+				release(slot, { {}, slot.format });
+				return false;
+			}
+
+			Ring& ring;
+			BoundedQueue<FileOperation>& queue;
+			const fs::path& inputPath;
+			const fs::path& outputDirectory;
+			optional<AudioFormat> encodeFormat;
+			const Accept& accept;
+			const Finish& finish;
+			vector<Slot> slots;
+		};
+	}
+#endif
+
+	bool uringConvertAll(BoundedQueue<FileOperation>& queue, const fs::path& inputPath, const fs::path& outputDirectory,
+		optional<AudioFormat> encodeFormat, unsigned queueDepth,
+		const function<bool(FileOperation&, const fs::path&)>& accept,
+		const function<void(FileOperation&, const FileConversion&, uint64_t)>& finish) {
+#ifdef SITHCODEC_URING
+		queueDepth = max(1U, queueDepth);
+
+		Ring ring(queueDepth);
+
+		if( !ring.supports({ IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE,
+			IORING_OP_RENAMEAT, IORING_OP_UNLINKAT }) )
+			return false;
+
+		Batch(ring, queue, inputPath, outputDirectory, encodeFormat, queueDepth, accept, finish).run();
+		return true;
+#else
+		return false;
+#endif
+	}
+}
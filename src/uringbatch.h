@@ -0,0 +1,78 @@
+/**
+ *	@file uringbatch.h
+ *	@brief Whole-tree conversion driven by a single io_uring instance.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_URINGBATCH_H
+#define SITHCODEC_URINGBATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+
+#include "boundedqueue.h"
+#include "codec.h"
+
+#if defined(SITHCODEC_LINUX) && __has_include(<linux/io_uring.h>)
+#define SITHCODEC_URING 1
+#endif
+
+namespace SithCodec {
+	/**
+	 *	@brief Size of the per-file buffer used by the io_uring engine.
+	 */
+	constexpr std::size_t uringChunkSize = 128 * 1024;
+
+	/**
+	 *	@brief Encodes or decodes a stream of files with io_uring.
+	 *	@details Keeps up to queueDepth files in flight at once. Every step of a
+	 *			 file - opening the input, the header probe read, the payload
+	 *			 copy, closing, and the final rename into place - is submitted
+	 *			 to the ring, so one thread drives the whole batch. Outputs are
+	 *			 staged beside their destination as with StagedFile.
+	 *
+	 *	@param queue		   files to convert, until the queue is closed;
+	 *						   outcomes are passed to finish
+	 *	@param inputPath	   path the operations were loaded from
+	 *	@param outputDirectory directory receiving the outputs
+	 *	@param encodeFormat	   format to encode in, or nothing to decode
+	 *	@param queueDepth	   maximum number of files in flight
+	 *	@param accept		   function called with each file and its output
+	 *						   path before any I/O; returning false skips it
+	 *	@param finish		   function called with each finished file, failed
+	 *						   or not, its conversion and the nanoseconds it took
+	 *
+	 *	@return false if io_uring or one of the operations it needs is not
+	 *			available, in which case nothing was taken from the queue;
+	 *			if the ring fails midway, the files not yet taken are left in
+	 *			the queue for the caller
+	 */
+	bool uringConvertAll(BoundedQueue<FileOperation>& queue, const std::filesystem::path& inputPath,
+		const std::filesystem::path& outputDirectory, std::optional<AudioFormat> encodeFormat, unsigned queueDepth,
+		const std::function<bool(FileOperation&, const std::filesystem::path&)>& accept,
+		const std::function<void(FileOperation&, const FileConversion&, std::uint64_t)>& finish);
+}
+
+#endif
@@ -0,0 +1,236 @@
+/**
+ *	@file allocstats.cpp
+ *	@brief Tests of counting heap allocations.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "allocstats.h"
+#include "check.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief Where allocations are stored, so the compiler cannot leave
+	 *		   them out.
+	 */
+	void* volatile sink;
+
+	/**
+	 *	@brief Allocates and frees a block with plain operator new.
+	 */
+	void allocate(size_t size) {
+		auto* block = new char[size];
+
+		sink = block;
+		delete[] block;
+	}
+
+	/**
+	 *	@brief Gets the allocations made by a call on the calling thread.
+	 */
+	template<typename Call>
+	AllocationCounts countOf(Call call) {
+		const auto before = threadAllocations();
+
+		call();
+
+		const auto after = threadAllocations();
+
+		return { after.allocations - before.allocations, after.bytes - before.bytes };
+	}
+
+	/**
+	 *	@brief Splits the rows of the stage table into their fields.
+	 */
+	vector<vector<string>> stageRows() {
+		ostringstream output;
+
+		writeAllocationStages(output);
+
+		istringstream input(output.str());
+		string line;
+		vector<vector<string>> rows;
+
+		// Skip the title and the column headings
+		getline(input, line);
+		getline(input, line);
+		while( getline(input, line) ) {
+			istringstream fields(line);
+			vector<string> row;
+			string field;
+
+			while( fields >> field )
+				row.push_back(field);
+			rows.push_back(row);
+		}
+		return rows;
+	}
+}
+
+/**
+ *	@brief Every form of operator new is counted with its size while
+ *		   counting, and none before or after.
+ */
+void testCounting() {
+	CHECK(canCountAllocations());
+
+	CHECK(countOf([] { allocate(100); }).allocations == 0);
+
+	startAllocationCounting();
+	CHECK(isCountingAllocations());
+	CHECK(processAllocations().allocations == 0);
+
+	const auto plain = countOf([] { allocate(100); });
+
+	CHECK(plain.allocations == 1 && plain.bytes == 100);
+
+	struct alignas(64) Aligned {
+		char bytes[128];
+	};
+
+	const auto aligned = countOf([] {
+		auto* block = new Aligned;
+
+		sink = block;
+		CHECK(reinterpret_cast<uintptr_t>(block) % 64 == 0);
+		delete block;
+	});
+
+	CHECK(aligned.allocations == 1 && aligned.bytes == sizeof(Aligned));
+
+	const auto unthrowing = countOf([] {
+		auto* block = new(std::nothrow) char[10];
+
+		sink = block;
+		delete[] block;
+	});
+
+	CHECK(unthrowing.allocations == 1 && unthrowing.bytes == 10);
+
+	// Other threads count towards the process, not this thread
+	const auto before = processAllocations();
+	const auto own = countOf([] {
+		thread other([] {
+			for( int i = 0; i < 50; ++i )
+				allocate(1000);
+		});
+
+		other.join();
+	});
+	const auto after = processAllocations();
+
+	CHECK(after.allocations - before.allocations >= 50 + own.allocations);
+	CHECK(after.bytes - before.bytes >= 50000 + own.bytes);
+
+	stopAllocationCounting();
+	CHECK(!isCountingAllocations());
+	CHECK(countOf([] { allocate(100); }).allocations == 0);
+	CHECK(processAllocations().allocations == after.allocations);
+}
+
+/**
+ *	@brief Stages are merged by name across threads and listed with the
+ *		   most allocations first; recording them allocates nothing that
+ *		   is counted, and a new run drops the old stages.
+ */
+void testStages() {
+	startAllocationCounting();
+
+	static const char first[] = "convert";
+	static const char second[] = "convert";
+
+	const auto record = [](const char* name, int count) {
+		const auto start = threadAllocations();
+
+		for( int i = 0; i < count; ++i )
+			allocate(2048);
+
+		const auto end = threadAllocations();
+
+		// The first record of a thread grows its own bookkeeping
+		CHECK(countOf([&] { recordAllocationStage(name, start, end, 0, 0); }).allocations == 0);
+	};
+
+	record("old", 1);
+	startAllocationCounting();
+	record(first, 3);
+	record("walk", 1);
+	record("walk", 1);
+	thread([&] { record(second, 5); }).join();
+	stopAllocationCounting();
+
+	const auto rows = stageRows();
+
+	if( !CHECK(rows.size() == 2) )
+		return;
+	CHECK((rows[0] == vector<string>{ "convert", "2", "8", "4.0", "16.0", "KB", "0.0", "KB" }));
+	CHECK((rows[1] == vector<string>{ "walk", "2", "2", "1.0", "4.0", "KB", "0.0", "KB" }));
+
+	// Nothing is written before any stage is recorded
+	startAllocationCounting();
+	stopAllocationCounting();
+	CHECK(stageRows().empty());
+}
+
+/**
+ *	@brief The resident set is reported and grows with memory touched.
+ */
+void testResident() {
+#ifdef SITHCODEC_LINUX
+	const auto before = currentResidentBytes();
+	const size_t size = 64 * 1024 * 1024;
+	auto block = make_unique<char[]>(size);
+
+	memset(block.get(), 1, size);
+	sink = block.get();
+
+	const auto after = currentResidentBytes();
+
+	CHECK(before > 0);
+	CHECK(after >= before + size / 2);
+	// The peak is kept by separate, lazily updated counters, so it is only
+	// compared with what was touched
+	CHECK(peakResidentBytes() >= size);
+#else
+	CHECK(currentResidentBytes() == 0);
+#endif
+}
+
+int main() {
+	testCounting();
+	testStages();
+	testResident();
+	return finish("allocstats");
+}
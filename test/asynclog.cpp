@@ -0,0 +1,245 @@
+/**
+ *	@file asynclog.cpp
+ *	@brief Tests of the asynchronous batch log.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asynclog.h"
+#include "check.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief Makes a successful record with a given sequence number.
+	 */
+	LogRecord recordOf(size_t sequence) {
+		LogRecord record;
+
+		record.sequence = sequence;
+		return record;
+	}
+
+	/**
+	 *	@brief Gets the paths of a text log, one per line.
+	 */
+	vector<string> pathsIn(const string& text) {
+		istringstream lines(text);
+		vector<string> paths;
+		string path, outcome;
+
+		while( lines >> path >> outcome )
+			paths.push_back(path);
+		return paths;
+	}
+}
+
+/**
+ *	@brief Records pushed from several threads, out of order and far ahead
+ *		   of a small ring, are written in sequence order.
+ */
+void testOrder() {
+	const size_t count = 20000;
+
+	for( unsigned round = 0; round < 10; ++round ) {
+		ostringstream output;
+		vector<size_t> order(count);
+
+		for( size_t i = 0; i < count; ++i )
+			order[i] = i;
+
+		mt19937 random(round);
+
+		// Each file finishes within a window of its neighbours, as in a batch
+		for( size_t i = 0; i + 50 <= count; i += 50 )
+			shuffle(order.begin() + static_cast<ptrdiff_t>(i), order.begin() + static_cast<ptrdiff_t>(i + 50), random);
+
+		{
+			AsyncLog log(output, LogFormat::Text, 8);
+			vector<thread> workers;
+
+			for( size_t t = 0; t < 6; ++t ) {
+				workers.emplace_back([&, t] {
+					for( size_t i = t; i < count; i += 6 ) {
+						log.push(recordOf(order[i]), "f" + to_string(order[i]));
+						if( i % 3000 == 0 )
+							log.flush();
+					}
+				});
+			}
+			for( auto& worker : workers )
+				worker.join();
+		}
+
+		const auto paths = pathsIn(output.str());
+		bool ordered = paths.size() == count;
+
+		for( size_t i = 0; ordered && i < count; ++i )
+			ordered = paths[i] == "f" + to_string(i);
+		if( !CHECK(ordered) )
+			break;
+	}
+}
+
+/**
+ *	@brief flush() writes every record up to the first one missing, and
+ *		   destruction writes the rest around the gaps.
+ */
+void testFlushAndGaps() {
+	ostringstream output;
+
+	{
+		AsyncLog log(output, LogFormat::Text, 4);
+
+		for( const size_t sequence : { 0, 1, 3, 12, 4 } )
+			log.push(recordOf(sequence), "g" + to_string(sequence));
+		log.flush();
+		CHECK(pathsIn(output.str()) == (vector<string>{ "g0", "g1" }));
+	}
+	CHECK(pathsIn(output.str()) == (vector<string>{ "g0", "g1", "g3", "g4", "g12" }));
+
+	ostringstream empty;
+
+	{
+		AsyncLog log(empty, LogFormat::JsonLines);
+
+		log.flush();
+	}
+	CHECK(empty.str().empty());
+}
+
+/**
+ *	@brief Text lines match what the console prints, and a failed write
+ *		   names the output of the input.
+ */
+void testTextLayout() {
+	ostringstream output;
+
+	{
+		AsyncLog log(output, LogFormat::Text);
+		auto upToDate = recordOf(1);
+		auto failed = recordOf(2);
+
+		upToDate.outcome = FileOutcome::UpToDate;
+		failed.outcome = FileOutcome::Failed;
+		failed.error = { CodecErrc::Write, 0 };
+
+		log.push(recordOf(0), "a.wav");
+		log.push(upToDate, "b.wav");
+		log.push(failed, "c.wav");
+	}
+
+	const auto expected = string(indentLevel1) + "a.wav " + successMsg + "\n"
+		+ indentLevel1 + "b.wav " + upToDateMsg + "\n"
+		+ indentLevel1 + "c.wav " + failMsg + "\n"
+		+ indentLevel2 + "Failed to write the output of \"c.wav\".\n";
+
+	CHECK(output.str() == expected);
+}
+
+/**
+ *	@brief JSON lines carry the sizes and error, with paths escaped.
+ */
+void testJsonLayout() {
+	ostringstream output;
+
+	{
+		AsyncLog log(output, LogFormat::JsonLines);
+		auto done = recordOf(0);
+		auto failed = recordOf(1);
+
+		done.format = AudioFormat::SFX;
+		done.bytesRead = 10;
+		done.bytesWritten = 20;
+		done.nanoseconds = 30;
+		failed.outcome = FileOutcome::Failed;
+		failed.error = { CodecErrc::Open, 2 };
+
+		log.push(done, "quote\"back\\slash\ttab.wav");
+		log.push(failed, "a.wav");
+	}
+
+	auto openError = openErrorMsg("a.wav");
+
+	for( size_t pos = 0; (pos = openError.find('"', pos)) != string::npos; pos += 2 )
+		openError.insert(pos, 1, '\\');
+
+	const string expected =
+		"{\"path\":\"quote\\\"back\\\\slash\\u0009tab.wav\",\"outcome\":\"done\",\"format\":\"" + string(getFormatName(AudioFormat::SFX))
+		+ "\",\"bytes_read\":10,\"bytes_written\":20,\"duration_ns\":30}\n"
+		"{\"path\":\"a.wav\",\"outcome\":\"failed\",\"format\":\"" + getFormatName(AudioFormat::None)
+		+ "\",\"bytes_read\":0,\"bytes_written\":0,\"duration_ns\":0,\"code\":\"open\",\"errno\":2,\"error\":\"" + openError + "\"}\n";
+
+	if( !CHECK(output.str() == expected) )
+		cerr << output.str();
+}
+
+/**
+ *	@brief A batch logged through sink() lists every file once, in the
+ *		   order the files were enumerated.
+ */
+void testSink() {
+	TemporaryDirectory directory;
+	const auto input = directory.path() / "in";
+
+	for( int i = 0; i < 200; ++i )
+		writeFile(input / ("d" + to_string(i % 7)) / ("f" + to_string(i) + ".wav"), string(static_cast<size_t>(i), 'x'));
+
+	ostringstream output;
+	BatchOptions options;
+
+	options.jobs = 8;
+
+	{
+		AsyncLog log(output, LogFormat::Text, 16);
+
+		encodeAll(input, AudioFormat::SFX, directory.path() / "out", options, log.sink());
+	}
+
+	const auto paths = pathsIn(output.str());
+	vector<string> expected;
+
+	for( const auto& entry : fs::recursive_directory_iterator(input) ) {
+		if( entry.is_regular_file() )
+			expected.push_back(entry.path().string());
+	}
+	CHECK(paths == expected);
+}
+
+int main() {
+	testOrder();
+	testFlushAndGaps();
+	testTextLayout();
+	testJsonLayout();
+	testSink();
+	return finish("asynclog");
+}
@@ -0,0 +1,186 @@
+/**
+ *	@file batchsink.cpp
+ *	@brief Tests of batches that stream their results to a sink.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "codec.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief What a sink received for one file.
+	 */
+	struct Result {
+		size_t calls = 0;
+		fs::path path;
+		FileOutcome outcome = FileOutcome::Done;
+		FileError error;
+		AudioFormat format = AudioFormat::None;
+		uintmax_t bytesWritten = 0;
+	};
+
+	/**
+	 *	@brief Sink storing results by sequence number; indices out of range
+	 *		   are counted instead.
+	 */
+	class Collector {
+	public:
+		explicit Collector(size_t count) : results(count) {}
+
+		BatchSink sink() {
+			return [this](const FileOperation& operation, FileOutcome outcome, const FileConversion& conversion, uint64_t) {
+				lock_guard lock(mutex);
+
+				if( operation.index >= results.size() ) {
+					++outOfRange;
+					return;
+				}
+
+				auto& result = results[operation.index];
+
+				++result.calls;
+				result.path = operation.path;
+				result.outcome = outcome;
+				result.error = operation.error;
+				result.format = conversion.format;
+				result.bytesWritten = conversion.bytesWritten;
+			};
+		}
+
+		vector<Result> results;
+		size_t outOfRange = 0;
+
+	private:
+		std::mutex mutex;
+	};
+
+	/**
+	 *	@brief Checks that every file arrived once, under the sequence number
+	 *		   of its place in loadOperations().
+	 */
+	void checkEveryFileOnce(const Collector& collector, const OperationTable& operations) {
+		bool once = collector.outOfRange == 0;
+
+		for( size_t i = 0; i < operations.size(); ++i )
+			once = once && collector.results[i].calls == 1 && collector.results[i].path == operations.path(i);
+		CHECK(once);
+	}
+}
+
+/**
+ *	@brief Each engine and thread count hands every file to the sink once,
+ *		   numbered in enumeration order.
+ */
+void testEveryFileOnce() {
+	TemporaryDirectory directory;
+	const auto input = directory.path() / "in";
+
+	for( int i = 0; i < 500; ++i )
+		writeFile(input / ("d" + to_string(i % 9)) / ("f" + to_string(i) + ".wav"), string(static_cast<size_t>(i % 37), 'x'));
+
+	const auto operations = loadOperations(input);
+	vector<BatchOptions> settings(3);
+
+	settings[0].jobs = 1;
+	settings[1].jobs = 8;
+	settings[1].engine = IoEngine::Block;
+#ifdef SITHCODEC_URING
+	settings.emplace_back();
+	settings.back().engine = IoEngine::Uring;
+	settings.back().queueDepth = 4;
+#endif
+
+	const auto sfxSize = headerOf(AudioFormat::SFX).size();
+
+	for( size_t s = 0; s < settings.size(); ++s ) {
+		Collector collector(operations.size());
+		const auto output = directory.path() / ("out" + to_string(s));
+
+		encodeAll(input, AudioFormat::SFX, output, settings[s], collector.sink());
+		checkEveryFileOnce(collector, operations);
+
+		bool written = true;
+
+		for( size_t i = 0; i < operations.size(); ++i ) {
+			const auto& result = collector.results[i];
+
+			written = written && result.outcome == FileOutcome::Done && result.format == AudioFormat::SFX
+				&& result.bytesWritten == sfxSize + fs::file_size(operations.path(i));
+		}
+		if( !CHECK(written) )
+			cerr << "  with settings " << s << '\n';
+	}
+}
+
+/**
+ *	@brief Failed and up-to-date files reach the sink too, with their error
+ *		   and the format they were to be encoded in.
+ */
+void testOutcomes() {
+	TemporaryDirectory directory;
+	const auto input = directory.path() / "in";
+	const auto output = directory.path() / "out";
+
+	for( int i = 0; i < 20; ++i )
+		writeFile(input / ("f" + to_string(i) + ".wav"), "payload");
+	// A directory where an output should go cannot be replaced
+	for( int i = 0; i < 20; i += 5 )
+		fs::create_directories(output / ("f" + to_string(i) + ".wav"));
+
+	const auto operations = loadOperations(input);
+	BatchOptions options;
+
+	options.jobs = 4;
+	options.manifest = directory.path() / "manifest";
+
+	for( const auto expected : { FileOutcome::Done, FileOutcome::UpToDate } ) {
+		Collector collector(operations.size());
+
+		encodeAll(input, AudioFormat::VO, output, options, collector.sink());
+		checkEveryFileOnce(collector, operations);
+
+		for( size_t i = 0; i < operations.size(); ++i ) {
+			const auto& result = collector.results[i];
+			const bool blocked = fs::is_directory(output / operations.path(i).filename());
+
+			CHECK(result.outcome == (blocked ? FileOutcome::Failed : expected));
+			CHECK(result.error.code == (blocked ? CodecErrc::Write : CodecErrc::None));
+			CHECK(result.format == AudioFormat::VO);
+		}
+	}
+}
+
+int main() {
+	testEveryFileOnce();
+	testOutcomes();
+	return finish("batchsink");
+}
@@ -0,0 +1,249 @@
+/**
+ *	@file batchstats.cpp
+ *	@brief Tests of the batch statistics and latency percentiles.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batchstats.h"
+#include "check.h"
+#include "operationtable.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief Records a file converted from or to a format.
+	 */
+	void recordFile(BatchStats& stats, const string& name, AudioFormat format, FileOutcome outcome, uint64_t nanoseconds,
+		uintmax_t bytesRead = 0, uintmax_t bytesWritten = 0) {
+		FileConversion conversion;
+
+		conversion.format = format;
+		conversion.bytesRead = bytesRead;
+		conversion.bytesWritten = bytesWritten;
+		stats.recordFile({ name, {} }, outcome, conversion, nanoseconds);
+	}
+}
+
+/**
+ *	@brief Percentiles pick the value at their rank, an empty histogram
+ *		   gives 0, and the extremes give the smallest and largest values.
+ */
+void testPercentiles() {
+	auto histogram = make_unique<LatencyHistogram>();
+
+	CHECK(histogram->count() == 0);
+	CHECK(histogram->percentile(50) == 0);
+	CHECK(histogram->max() == 0);
+
+	// Below the first power of two beyond the linear range, values are exact
+	for( uint64_t value = 100; value >= 1; --value )
+		histogram->record(value);
+
+	CHECK(histogram->count() == 100);
+	CHECK(histogram->percentile(0) == 1);
+	CHECK(histogram->percentile(50) == 50);
+	CHECK(histogram->percentile(90) == 90);
+	CHECK(histogram->percentile(99) == 99);
+	CHECK(histogram->percentile(99.5) == 100);
+	CHECK(histogram->percentile(100) == 100);
+	CHECK(histogram->max() == 100);
+}
+
+/**
+ *	@brief Every value is reported to within 1/64 above itself, across
+ *		   the bucket boundaries of every power of two.
+ */
+void testPrecision() {
+	vector<uint64_t> values = { 0, 1, 127, 128, 129, 255, 256, 1000, 999999, numeric_limits<uint64_t>::max() - 1 };
+
+	for( unsigned exponent = 7; exponent < 64; ++exponent ) {
+		const auto power = uint64_t(1) << exponent;
+
+		values.insert(values.end(), { power - 1, power, power + 1, power + power / 3 });
+	}
+
+	for( const auto value : values ) {
+		auto histogram = make_unique<LatencyHistogram>();
+
+		// A larger value keeps the result from being clamped to the maximum
+		histogram->record(value);
+		histogram->record(numeric_limits<uint64_t>::max());
+
+		const auto reported = histogram->percentile(50);
+
+		if( !CHECK(reported >= value && reported - value <= value / 64) )
+			cerr << "  " << value << " reported as " << reported << '\n';
+	}
+
+	auto histogram = make_unique<LatencyHistogram>();
+
+	histogram->record(1000);
+	CHECK(histogram->percentile(100) == 1000);
+	histogram->record(numeric_limits<uint64_t>::max());
+	CHECK(histogram->percentile(100) == numeric_limits<uint64_t>::max());
+}
+
+/**
+ *	@brief Values recorded from several threads are all counted.
+ */
+void testConcurrentRecords() {
+	auto histogram = make_unique<LatencyHistogram>();
+	vector<thread> threads;
+
+	for( uint64_t t = 0; t < 4; ++t )
+		threads.emplace_back([&histogram, t] {
+			for( uint64_t i = 0; i < 10000; ++i )
+				histogram->record(i * 4 + t);
+		});
+	for( auto& thread : threads )
+		thread.join();
+
+	CHECK(histogram->count() == 40000);
+	CHECK(histogram->max() == 39999);
+	CHECK(histogram->percentile(100) == 39999);
+}
+
+/**
+ *	@brief Counts and bytes are kept per format and outcome, and files
+ *		   found up to date take no time.
+ */
+void testCounters() {
+	BatchStats stats;
+
+	for( int i = 0; i < 3; ++i )
+		stats.fileQueued(10);
+	CHECK(stats.filesQueued() == 3 && stats.bytesQueued() == 30);
+	CHECK(!stats.isEnumerated());
+	stats.enumerationFinished();
+	CHECK(stats.isEnumerated());
+	CHECK(stats.queueDepth() == 3);
+
+	stats.fileTaken();
+	stats.fileTaken();
+	CHECK(stats.queueDepth() == 1);
+	CHECK(stats.activeFiles() == 2);
+
+	recordFile(stats, "a.wav", AudioFormat::SFX, FileOutcome::Done, 100, 10, 18);
+	recordFile(stats, "b.wav", AudioFormat::VO, FileOutcome::Failed, 200, 10, 18);
+	CHECK(stats.activeFiles() == 0);
+
+	stats.fileTaken();
+	recordFile(stats, "c.wav", AudioFormat::None, FileOutcome::UpToDate, 300);
+
+	CHECK(stats.queueDepth() == 0);
+	CHECK(stats.filesFinished() == 3);
+	CHECK(stats.files(FileOutcome::Done) == 1);
+	CHECK(stats.files(FileOutcome::Failed) == 1);
+	CHECK(stats.files(FileOutcome::UpToDate) == 1);
+	CHECK(stats.files(AudioFormat::SFX) == 1);
+	CHECK(stats.files(AudioFormat::VO) == 0);
+	CHECK(stats.files(AudioFormat::VO, FileOutcome::Failed) == 1);
+
+	// Only converted files count their bytes
+	CHECK(stats.bytesRead() == 10 && stats.bytesWritten() == 18);
+	CHECK(stats.bytesRead(AudioFormat::VO) == 0);
+
+	CHECK(stats.latency().count() == 2);
+	CHECK(stats.stageTime(BatchStage::Convert) == 300);
+	CHECK(stats.slowest().size() == 2);
+	CHECK(stats.elapsed() == 0);
+}
+
+/**
+ *	@brief Only the slowest files are kept, slowest first, and none when
+ *		   none are asked for.
+ */
+void testSlowest() {
+	BatchStats stats(3);
+	BatchStats none(0);
+
+	for( const uint64_t nanoseconds : { 50, 10, 70, 20, 60, 70, 30 } ) {
+		const auto name = to_string(nanoseconds) + ".wav";
+
+		recordFile(stats, name, AudioFormat::SFX, FileOutcome::Done, nanoseconds);
+		recordFile(none, name, AudioFormat::SFX, FileOutcome::Done, nanoseconds);
+	}
+
+	const auto slow = stats.slowest();
+
+	CHECK(slow.size() == 3);
+	CHECK(slow.size() == 3 && slow[0].first == 70 && slow[1].first == 70 && slow[2].first == 60);
+	CHECK(slow.size() == 3 && slow[2].second == "60.wav");
+	CHECK(none.slowest().empty());
+	CHECK(none.latency().count() == 7);
+}
+
+/**
+ *	@brief The summary shows the totals, the percentiles and the slowest
+ *		   files, and leaves the stream's formatting as it was.
+ */
+void testSummary() {
+	BatchStats stats(2);
+
+	for( uint64_t nanoseconds = 1; nanoseconds <= 100; ++nanoseconds )
+		recordFile(stats, to_string(nanoseconds) + ".wav", AudioFormat::VO, FileOutcome::Done, nanoseconds, 1000000, 2000000);
+	recordFile(stats, "failed.wav", AudioFormat::VO, FileOutcome::Failed, 1);
+
+	ostringstream output;
+
+	output.precision(4);
+	stats.printSummary(output);
+
+	const auto text = output.str();
+
+	CHECK(text.find(string(indentLevel1) + "100 done, 1 failed, 0 ") != string::npos);
+	CHECK(text.find(string(indentLevel1) + "VO: 100 files, 100.0 MB read, 200.0 MB written\n") != string::npos);
+	CHECK(text.find("SFX:") == string::npos);
+	CHECK(text.find(string(indentLevel1) + "latency p50 50 ns, p90 90 ns, p99 99 ns, max 100 ns\n") != string::npos);
+	CHECK(text.find(string(indentLevel1) + "slowest files\n" + indentLevel2 + "    100 ns  100.wav\n" + indentLevel2 + "     99 ns  99.wav\n")
+		!= string::npos);
+	CHECK(output.precision() == 4);
+	CHECK(!(output.flags() & ios::fixed));
+
+	ostringstream empty;
+
+	BatchStats().printSummary(empty);
+	CHECK(empty.str().find("latency") == string::npos);
+	CHECK(empty.str().find("slowest") == string::npos);
+}
+
+int main() {
+	testPercentiles();
+	testPrecision();
+	testConcurrentRecords();
+	testCounters();
+	testSlowest();
+	testSummary();
+	return finish("batchstats");
+}
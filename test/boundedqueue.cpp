@@ -0,0 +1,201 @@
+/**
+ *	@file boundedqueue.cpp
+ *	@brief Tests of BoundedQueue and of the streaming batch it feeds.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boundedqueue.h"
+#include "check.h"
+#include "codec.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+/**
+ *	@brief Elements come out in the order they went in, and tryPop never
+ *		   waits.
+ */
+void testFifo() {
+	BoundedQueue<int> queue(4);
+
+	CHECK(!queue.tryPop());
+	for( int i = 0; i < 4; ++i )
+		CHECK(queue.push(i));
+	CHECK(queue.size() == 4);
+	for( int i = 0; i < 4; ++i )
+		CHECK(queue.pop() == i);
+	CHECK(!queue.tryPop());
+	CHECK(!queue.drained());
+}
+
+/**
+ *	@brief A producer waits while the queue is full and goes on once an
+ *		   element is taken.
+ */
+void testProducerWaitsWhenFull() {
+	BoundedQueue<int> queue(1);
+	atomic<bool> pushed{ false };
+
+	queue.push(1);
+
+	thread producer([&] {
+		queue.push(2);
+		pushed = true;
+	});
+
+	this_thread::sleep_for(chrono::milliseconds(50));
+	CHECK(!pushed);
+	CHECK(queue.pop() == 1);
+	producer.join();
+	CHECK(pushed);
+	CHECK(queue.pop() == 2);
+}
+
+/**
+ *	@brief Closing the queue releases a producer blocked on a full queue,
+ *		   whose push fails, while consumers still drain what was queued.
+ */
+void testCloseWhileProducerBlocked() {
+	BoundedQueue<int> queue(2);
+	atomic<int> result{ -1 };
+
+	queue.push(1);
+	queue.push(2);
+
+	thread producer([&] { result = queue.push(3) ? 1 : 0; });
+
+	this_thread::sleep_for(chrono::milliseconds(50));
+	CHECK(result == -1);
+	queue.close();
+	producer.join();
+
+	CHECK(result == 0);
+	CHECK(!queue.drained());
+	CHECK(queue.pop() == 1);
+	CHECK(queue.pop() == 2);
+	CHECK(!queue.pop());
+	CHECK(queue.drained());
+	CHECK(!queue.push(4));
+}
+
+/**
+ *	@brief Closing releases every consumer waiting on an empty queue.
+ */
+void testCloseReleasesConsumers() {
+	BoundedQueue<int> queue(2);
+	atomic<int> released{ 0 };
+	vector<thread> consumers;
+
+	for( int i = 0; i < 3; ++i ) {
+		consumers.emplace_back([&] {
+			if( !queue.pop() )
+				++released;
+		});
+	}
+	this_thread::sleep_for(chrono::milliseconds(50));
+	queue.close();
+	for( auto& consumer : consumers )
+		consumer.join();
+	CHECK(released == 3);
+}
+
+/**
+ *	@brief Many producers and consumers pass every element exactly once.
+ */
+void testManyProducersAndConsumers() {
+	BoundedQueue<int> queue(8);
+	vector<atomic<int>> seen(4000);
+	vector<thread> producers, consumers;
+
+	for( int p = 0; p < 4; ++p ) {
+		producers.emplace_back([&, p] {
+			for( int i = p; i < 4000; i += 4 )
+				queue.push(i);
+		});
+	}
+	for( int c = 0; c < 3; ++c ) {
+		consumers.emplace_back([&] {
+			while( auto value = queue.pop() )
+				++seen[static_cast<size_t>(*value)];
+		});
+	}
+	for( auto& producer : producers )
+		producer.join();
+	queue.close();
+	for( auto& consumer : consumers )
+		consumer.join();
+
+	bool once = true;
+
+	for( const auto& count : seen )
+		once = once && count == 1;
+	CHECK(once);
+}
+
+/**
+ *	@brief An in-place batch streams and still converts each file exactly
+ *		   once, and an output directory inside the input folder is left
+ *		   out of the walk.
+ */
+void testOverlappingOutputs() {
+	TemporaryDirectory directory;
+	const auto input = directory.path() / "in";
+	const auto sfx = headerOf(AudioFormat::SFX);
+
+	for( int i = 0; i < 300; ++i )
+		writeFile(input / ("d" + to_string(i % 5)) / ("f" + to_string(i) + ".wav"), "payload");
+	writeFile(input / "out" / "old.wav", "payload");
+
+	BatchOptions options;
+
+	options.jobs = 4;
+
+	const auto inPlace = encodeAll(input, AudioFormat::SFX, "", options);
+
+	CHECK(inPlace.size() == 301);
+	CHECK(inPlace.count(FileStatus::Done) == 301);
+	CHECK(readFile(input / "d0" / "f0.wav") == sfx + "payload");
+
+	const auto inside = encodeAll(input, AudioFormat::SFX, input / "out", options);
+
+	CHECK(inside.size() == 300);
+	CHECK(readFile(input / "out" / "d0" / "f0.wav") == sfx + sfx + "payload");
+	CHECK(!fs::exists(input / "out" / "out"));
+}
+
+int main() {
+	testFifo();
+	testProducerWaitsWhenFull();
+	testCloseWhileProducerBlocked();
+	testCloseReleasesConsumers();
+	testManyProducersAndConsumers();
+	testOverlappingOutputs();
+	return finish("boundedqueue");
+}
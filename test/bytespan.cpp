@@ -0,0 +1,160 @@
+/**
+ *	@file bytespan.cpp
+ *	@brief Tests of encoding and decoding audio held in memory.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "codec.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief Views the bytes of a string.
+	 */
+	ByteSpan bytesOf(const string& str) {
+		return { reinterpret_cast<const byte*>(str.data()), str.size() };
+	}
+
+	/**
+	 *	@brief Copies bytes into a string, for comparisons.
+	 */
+	string stringOf(ByteSpan bytes) {
+		return { reinterpret_cast<const char*>(bytes.data()), bytes.size() };
+	}
+
+	/**
+	 *	@brief Gets the message a call throws, or an empty string if it
+	 *		   does not throw.
+	 */
+	string thrownMessage(const function<void()>& call) {
+		try {
+			call();
+		}
+		catch( const runtime_error& ex ) {
+			return ex.what();
+		}
+		return {};
+	}
+}
+
+/**
+ *	@brief Encoding then decoding gives back the payload and format, and
+ *		   matches what encoding a file writes.
+ */
+void testRoundTrip() {
+	TemporaryDirectory directory;
+
+	for( const auto format : { AudioFormat::SFX, AudioFormat::VO } ) {
+		for( const size_t size : { size_t(0), size_t(1), size_t(4096), size_t(1) << 20 } ) {
+			string payload(size, '\0');
+
+			for( size_t i = 0; i < size; ++i )
+				payload[i] = static_cast<char>(i * 7);
+
+			vector<byte> buffer(encodedSize(format, size));
+			const auto written = encode(bytesOf(payload), format, { buffer.data(), buffer.size() });
+			const auto decoded = decode(ByteSpan(buffer.data(), written));
+
+			CHECK(written == buffer.size());
+			CHECK(decoded.format == format);
+			CHECK(stringOf(decoded.payload) == payload);
+			CHECK(decoded.payload.data() == buffer.data() + (written - size));
+
+			const auto pieces = encodeScattered(bytesOf(payload), format);
+
+			CHECK(stringOf(pieces[0]) + stringOf(pieces[1]) == stringOf({ buffer.data(), written }));
+			CHECK(pieces[1].data() == bytesOf(payload).data());
+
+			const auto input = directory.path() / "in.wav";
+			const auto output = directory.path() / "out.wav";
+
+			writeFile(input, payload);
+
+			const auto conversion = encode(input, format, output);
+
+			CHECK(readFile(conversion.outputPath) == stringOf({ buffer.data(), written }));
+		}
+	}
+}
+
+/**
+ *	@brief Data without a whole header, including a header cut short, is
+ *		   handed back entire with no format.
+ */
+void testTruncatedHeaders() {
+	for( const auto format : { AudioFormat::SFX, AudioFormat::VO } ) {
+		const auto header = headerOf(format);
+
+		for( size_t length = 0; length < header.size(); ++length ) {
+			const auto truncated = header.substr(0, length);
+			const auto decoded = decode(bytesOf(truncated));
+
+			CHECK(decoded.format == AudioFormat::None);
+			CHECK(decoded.payload.size() == length);
+			CHECK(formatOf(bytesOf(truncated)) == AudioFormat::None);
+		}
+
+		const auto exact = decode(bytesOf(header));
+
+		CHECK(exact.format == format);
+		CHECK(exact.payload.empty());
+	}
+
+	const string plain = "RIFF plain audio";
+
+	CHECK(decode(bytesOf(plain)).format == AudioFormat::None);
+	CHECK(stringOf(decode(bytesOf(plain)).payload) == plain);
+	CHECK(decode(ByteSpan()).payload.empty());
+}
+
+/**
+ *	@brief A buffer one byte short is refused, and encoding needs a format.
+ */
+void testErrors() {
+	const string payload = "payload";
+	const auto size = encodedSize(AudioFormat::SFX, payload.size());
+	vector<byte> buffer(size + 1);
+
+	CHECK(thrownMessage([&] { encode(bytesOf(payload), AudioFormat::SFX, { buffer.data(), size - 1 }); }) == bufferErrorMsg);
+	CHECK(thrownMessage([&] { encode(bytesOf(payload), AudioFormat::SFX, { buffer.data(), size + 1 }); }).empty());
+	CHECK(thrownMessage([&] { encode(bytesOf(payload), AudioFormat::None, { buffer.data(), buffer.size() }); }) == formatErrorMsg);
+	CHECK(thrownMessage([&] { encodedSize(AudioFormat::None, 1); }) == formatErrorMsg);
+	CHECK(thrownMessage([&] { encodeScattered(bytesOf(payload), AudioFormat::None); }) == formatErrorMsg);
+}
+
+int main() {
+	testRoundTrip();
+	testTruncatedHeaders();
+	testErrors();
+	return finish("bytespan");
+}
@@ -0,0 +1,134 @@
+/**
+ *	@file check.h
+ *	@brief Minimal assertions and fixtures shared by the tests.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#ifndef SITHCODEC_CHECK_H
+#define SITHCODEC_CHECK_H
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "codec.h"
+
+/**
+ *	@brief Checks a condition, reporting it with its location when false.
+ *		   The test carries on, so one run lists every failure.
+ */
+#define CHECK(condition) SithCodec::Test::check(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
+
+namespace SithCodec::Test {
+	/**
+	 *	@brief Number of failed checks so far.
+	 */
+	inline int failures = 0;
+
+	/**
+	 *	@brief Records the outcome of one check; use CHECK() instead.
+	 *
+	 *	@return condition, so a test can stop when later checks depend on it
+	 */
+	inline bool check(bool condition, const char* expression, const char* file, int line) {
+		if( !condition ) {
+			++failures;
+			std::cerr << file << ':' << line << ": check failed: " << expression << '\n';
+		}
+		return condition;
+	}
+
+	/**
+	 *	@brief Reports the result of a test program.
+	 *
+	 *	@param name name of the test
+	 *
+	 *	@return exit status of main(): 0 if every check passed
+	 */
+	inline int finish(const char* name) {
+		if( failures )
+			std::cerr << name << ": " << failures << " check(s) failed\n";
+		else
+			std::cout << name << ": passed\n";
+		return failures ? 1 : 0;
+	}
+
+	/**
+	 *	@brief Directory under the system temporary directory that is
+	 *		   removed with everything in it when the object is destroyed.
+	 */
+	class TemporaryDirectory {
+	public:
+		TemporaryDirectory() : root(getTempPath()) {
+			std::filesystem::create_directories(root);
+		}
+
+		~TemporaryDirectory() {
+			std::error_code error;
+
+			std::filesystem::remove_all(root, error);
+		}
+
+		TemporaryDirectory(const TemporaryDirectory&) = delete;
+		TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+		const std::filesystem::path& path() const noexcept { return root; }
+
+	private:
+		std::filesystem::path root;
+	};
+
+	/**
+	 *	@brief Writes a file, creating its parent directories.
+	 */
+	inline void writeFile(const std::filesystem::path& path, std::string_view contents) {
+		if( path.has_parent_path() )
+			std::filesystem::create_directories(path.parent_path());
+
+		std::ofstream file(path, std::ios::binary);
+
+		file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+	}
+
+	/**
+	 *	@brief Reads a whole file, or gives an empty string if it cannot be
+	 *		   opened.
+	 */
+	inline std::string readFile(const std::filesystem::path& path) {
+		std::ifstream file(path, std::ios::binary);
+
+		return std::string(std::istreambuf_iterator<char>(file), {});
+	}
+
+	/**
+	 *	@brief Gets the header of a format as a string.
+	 */
+	inline std::string headerOf(AudioFormat format) {
+		return std::string(getHeader(format), static_cast<std::size_t>(sizeOfHeader(format)));
+	}
+}
+
+#endif
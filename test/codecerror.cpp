@@ -0,0 +1,191 @@
+/**
+ *	@file codecerror.cpp
+ *	@brief Tests of the error codes of conversions and their messages.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <cerrno>
+#include <functional>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include "check.h"
+#include "codec.h"
+#include "codecerror.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	const CodecErrc codes[] = {
+		CodecErrc::None,
+		CodecErrc::Open,
+		CodecErrc::Read,
+		CodecErrc::Write,
+		CodecErrc::Delete,
+		CodecErrc::Format,
+		CodecErrc::Memory,
+		CodecErrc::Other,
+	};
+
+	/**
+	 *	@brief Gets the message a call throws, or an empty string if it
+	 *		   does not throw.
+	 */
+	string thrownMessage(const function<void()>& call) {
+		try {
+			call();
+		}
+		catch( const runtime_error& ex ) {
+			return ex.what();
+		}
+		return {};
+	}
+}
+
+/**
+ *	@brief Every code has its own name and message, and converts to a
+ *		   std::error_code of the codec category.
+ */
+void testCategory() {
+	set<string> names, messages;
+
+	for( const auto code : codes ) {
+		const error_code error = code;
+
+		names.insert(getErrorName(code));
+		messages.insert(error.message());
+		CHECK(error == code);
+		CHECK(error.category() == codecCategory());
+		CHECK(static_cast<bool>(error) == (code != CodecErrc::None));
+	}
+	CHECK(names.size() == size(codes));
+	CHECK(messages.size() == size(codes));
+
+	CHECK(string(getErrorName(CodecErrc::Open)) == "open");
+	CHECK(string(getErrorName(CodecErrc::Read)) == "read");
+	CHECK(string(codecCategory().name()) == "sithcodec");
+	CHECK(make_error_code(CodecErrc::Read) != CodecErrc::Open);
+	CHECK(make_error_code(CodecErrc::Open) != make_error_code(errc::no_such_file_or_directory));
+}
+
+/**
+ *	@brief Each code renders the message of the throwing API, naming the
+ *		   output of a batch file for write and delete failures.
+ */
+void testMessages() {
+	const fs::path path = "a.wav";
+
+	CHECK(errorMessage({ CodecErrc::None }, path).empty());
+	CHECK(errorMessage({ CodecErrc::Open, ENOENT }, path) == openErrorMsg(path));
+	CHECK(errorMessage({ CodecErrc::Read, EIO }, path) == readErrorMsg(path));
+	CHECK(errorMessage({ CodecErrc::Write }, path) == writeErrorMsg(path));
+	CHECK(errorMessage({ CodecErrc::Delete }, path) == deleteErrorMsg(path));
+	CHECK(errorMessage({ CodecErrc::Format }, path) == formatErrorMsg);
+	CHECK(errorMessage({ CodecErrc::Memory }, path).find("memory") != string::npos);
+
+	const auto withErrno = errorMessage({ CodecErrc::Other, ENOSPC }, path);
+	const auto withoutErrno = errorMessage({ CodecErrc::Other }, path);
+
+	CHECK(withErrno.find(system_category().message(ENOSPC)) != string::npos);
+	CHECK(withoutErrno.find(path.string()) != string::npos);
+	CHECK(withErrno != withoutErrno);
+
+	CHECK(errorMessage(FileOperation{ path, { CodecErrc::Write } }) == "Failed to write the output of \"a.wav\".");
+	CHECK(errorMessage(FileOperation{ path, { CodecErrc::Open } }) == openErrorMsg(path));
+	CHECK(errorMessage(FileOperation{ path, {} }).empty());
+}
+
+/**
+ *	@brief The throwing API names the input for open and read failures, the
+ *		   output for write failures, and rejects a missing format.
+ */
+void testThrowingApi() {
+	TemporaryDirectory directory;
+	const auto missing = directory.path() / "missing.wav";
+	const auto input = directory.path() / "a.wav";
+	const auto folder = directory.path() / "folder";
+
+	writeFile(input, "payload");
+	writeFile(directory.path() / "file", "");
+	fs::create_directories(folder);
+
+	CHECK(thrownMessage([&] { encode(missing, AudioFormat::SFX, directory.path() / "out.wav"); }) == openErrorMsg(missing));
+	CHECK(thrownMessage([&] { decode(missing, directory.path() / "out.wav"); }) == openErrorMsg(missing));
+	CHECK(thrownMessage([&] { encode(input, AudioFormat::None, directory.path() / "out.wav"); }) == formatErrorMsg);
+
+	for( const auto engine : { IoEngine::Stream, IoEngine::Block, IoEngine::CopyFileRange } ) {
+		CHECK(thrownMessage([&] { decode(folder, directory.path() / "out.wav", engine); }) == readErrorMsg(folder));
+
+		FileError error;
+
+		encode(folder, AudioFormat::SFX, directory.path() / "out.wav", engine, error);
+		CHECK(error.code == CodecErrc::Read);
+	}
+
+	const auto output = directory.path() / "file" / "out.wav";
+	FileError error;
+	const auto conversion = encode(input, AudioFormat::SFX, output, IoEngine::Auto, error);
+
+	CHECK(error.code == CodecErrc::Write);
+	CHECK(thrownMessage([&] { encode(input, AudioFormat::SFX, output); }) == writeErrorMsg(conversion.outputPath));
+}
+
+/**
+ *	@brief A batch keeps the code of each failed file and goes on with the
+ *		   others.
+ */
+void testBatchCodes() {
+	TemporaryDirectory directory;
+	const auto input = directory.path() / "in";
+	const auto list = directory.path() / "list.txt";
+
+	writeFile(input / "a.wav", "payload");
+	fs::create_directories(input / "folder");
+	writeFile(list, (input / "a.wav").string() + "\n" + (input / "missing.wav").string() + "\n" + (input / "folder").string() + "\n");
+
+	BatchOptions options;
+
+	options.engine = IoEngine::Block;
+
+	const auto results = decodeAll(list, directory.path() / "out", options);
+
+	if( !CHECK(results.size() == 3) )
+		return;
+	CHECK(results.status(0) == FileStatus::Done);
+	CHECK(results.error(1).code == CodecErrc::Open);
+	CHECK(results.error(2).code == CodecErrc::Read);
+	CHECK(results.error(2).systemError == EISDIR);
+}
+
+int main() {
+	testCategory();
+	testMessages();
+	testThrowingApi();
+	testBatchCodes();
+	return finish("codecerror");
+}
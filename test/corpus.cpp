@@ -0,0 +1,180 @@
+/**
+ *	@file corpus.cpp
+ *	@brief Tests of the synthetic corpus generator of the benchmarks.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <map>
+#include <string>
+
+#include "check.h"
+#include "codec.h"
+#include "corpus.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	using Kind = SizeDistribution::Kind;
+
+	/**
+	 *	@brief Reads every file below a directory, keyed by relative path.
+	 */
+	map<string, string> readTree(const fs::path& root) {
+		map<string, string> files;
+
+		for( const auto& entry : fs::recursive_directory_iterator(root) ) {
+			if( entry.is_regular_file() )
+				files[entry.path().lexically_relative(root).generic_string()] = readFile(entry.path());
+		}
+		return files;
+	}
+}
+
+/**
+ *	@brief Size distributions parse with their suffixes, and malformed ones
+ *		   are refused.
+ */
+void testParse() {
+	const auto fixed = SizeDistribution::parse("fixed:64k");
+
+	CHECK(fixed && fixed->kind == Kind::Fixed && fixed->min == 65536 && fixed->max == 65536);
+
+	const auto uniform = SizeDistribution::parse("uniform:1K-2m");
+
+	CHECK(uniform && uniform->kind == Kind::Uniform && uniform->min == 1024 && uniform->max == 2 * 1024 * 1024);
+
+	const auto logUniform = SizeDistribution::parse("loguniform:1-1g");
+
+	CHECK(logUniform && logUniform->kind == Kind::LogUniform && logUniform->max == 1024 * 1024 * 1024);
+
+	CHECK(SizeDistribution::parse("uniform:0-0"));
+
+	for( const auto* malformed : { "", "fixed", "fixed:", "fixed:k", "fixed:12x", "fixed:-1", "uniform:1", "uniform:1-",
+		"uniform:-2", "uniform:5-3", "loguniform:0-10", "normal:1-2", "Fixed:1", "fixed:1234567890123" } ) {
+		if( !CHECK(!SizeDistribution::parse(malformed)) )
+			cerr << "  accepted \"" << malformed << "\"\n";
+	}
+}
+
+/**
+ *	@brief Samples stay within the bounds at both ends of the unit
+ *		   interval, and means sit between them.
+ */
+void testSample() {
+	for( const auto* description : { "fixed:100", "uniform:10-20", "uniform:7-7", "loguniform:1-1m", "loguniform:1000-1001" } ) {
+		const auto distribution = SizeDistribution::parse(description).value();
+
+		for( const double unit : { 0.0, 0.25, 0.5, 0.999, 1.0 - 0x1.0p-53 } ) {
+			const auto size = distribution.sample(unit);
+
+			if( !CHECK(size >= distribution.min && size <= distribution.max) )
+				cerr << "  " << description << " gave " << size << " at " << unit << '\n';
+		}
+		CHECK(distribution.mean() >= static_cast<double>(distribution.min));
+		CHECK(distribution.mean() <= static_cast<double>(distribution.max));
+	}
+	CHECK(SizeDistribution::parse("uniform:10-20")->sample(0.0) == 10);
+	CHECK(SizeDistribution::parse("uniform:10-20")->sample(1.0 - 0x1.0p-53) == 20);
+}
+
+/**
+ *	@brief The same spec writes the same bytes whatever the number of
+ *		   threads, in the documented layout, and the statistics describe
+ *		   what was written.
+ */
+void testGenerate() {
+	TemporaryDirectory directory;
+	CorpusSpec spec;
+
+	spec.files = 600;
+	spec.sizes = SizeDistribution::parse("uniform:0-3000").value();
+	spec.depth = 2;
+	spec.fanOut = 3;
+	spec.headerlessFraction = 0.1;
+	spec.truncatedFraction = 0.1;
+	spec.seed = 42;
+	spec.jobs = 1;
+
+	const auto stats = generateCorpus(directory.path() / "one", spec);
+
+	spec.jobs = 8;
+	generateCorpus(directory.path() / "many", spec);
+
+	const auto files = readTree(directory.path() / "one");
+
+	CHECK(files == readTree(directory.path() / "many"));
+	CHECK(files.size() == 600);
+	CHECK(stats.files == 600);
+	CHECK(stats.sfx + stats.vo + stats.headerless + stats.truncated == 600);
+	CHECK(stats.headerless > 0 && stats.truncated > 0 && stats.sfx > 0 && stats.vo > 0);
+	CHECK(files.count("d00/d00/f0000000.wav") == 1);
+	CHECK(files.count("d02/d02/f0000599.wav") == 1);
+
+	uintmax_t bytes = 0;
+	size_t sfx = 0, vo = 0;
+
+	for( const auto& [name, contents] : files ) {
+		bytes += contents.size();
+		sfx += formatOf(contents.data(), contents.size()) == AudioFormat::SFX;
+		vo += formatOf(contents.data(), contents.size()) == AudioFormat::VO;
+	}
+	CHECK(bytes == stats.bytes);
+	CHECK(sfx == stats.sfx);
+	CHECK(vo == stats.vo);
+
+	spec.seed = 43;
+	generateCorpus(directory.path() / "other", spec);
+	CHECK(readTree(directory.path() / "other") != files);
+}
+
+/**
+ *	@brief A depth of 0 puts every file in the root.
+ */
+void testFlat() {
+	TemporaryDirectory directory;
+	CorpusSpec spec;
+
+	spec.files = 12;
+	spec.sizes = SizeDistribution::parse("fixed:10").value();
+	spec.depth = 0;
+
+	const auto stats = generateCorpus(directory.path(), spec);
+
+	CHECK(stats.directories == 0);
+
+	size_t count = 0;
+
+	for( const auto& entry : fs::directory_iterator(directory.path()) )
+		count += entry.is_regular_file();
+	CHECK(count == 12);
+}
+
+int main() {
+	testParse();
+	testSample();
+	testGenerate();
+	testFlat();
+	return finish("corpus");
+}
@@ -0,0 +1,232 @@
+/**
+ *	@file decodedstream.cpp
+ *	@brief Tests of the random-access stream over decoded audio.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "check.h"
+#include "decodedstream.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief Makes bytes that differ from one position to the next, so a
+	 *		   read from the wrong offset shows.
+	 */
+	string pattern(size_t size) {
+		string bytes(size, '\0');
+
+		for( size_t i = 0; i < size; ++i )
+			bytes[i] = static_cast<char>((i * 131 + i / 251) & 0xff);
+		return bytes;
+	}
+
+	/**
+	 *	@brief Reads up to count bytes from the current position.
+	 */
+	string readSome(DecodedStream& stream, size_t count) {
+		string bytes(count, '\0');
+
+		stream.read(bytes.data(), static_cast<streamsize>(count));
+		bytes.resize(static_cast<size_t>(stream.gcount()));
+		return bytes;
+	}
+}
+
+/**
+ *	@brief The stream gives what decode() writes, read whole, bytewise or
+ *		   in large blocks.
+ */
+void testMatchesDecode() {
+	TemporaryDirectory directory;
+	const auto payload = pattern(decodedBufferSize * 3 + 123);
+
+	for( const auto format : { AudioFormat::SFX, AudioFormat::VO, AudioFormat::None } ) {
+		const auto path = directory.path() / "in.wav";
+
+		writeFile(path, (format == AudioFormat::None ? string() : headerOf(format)) + payload);
+
+		const auto decoded = decode(path, directory.path() / "out.wav");
+		const auto expected = readFile(decoded.outputPath);
+
+		{
+			DecodedStream stream(path);
+
+			CHECK(stream.format() == format);
+			CHECK(stream.size() == expected.size());
+			CHECK(string(istreambuf_iterator<char>(stream), {}) == expected);
+		}
+		{
+			DecodedStream stream(path);
+
+			CHECK(readSome(stream, decodedBufferSize * 2 + 7) + readSome(stream, expected.size()) == expected);
+			CHECK(stream.eof());
+		}
+	}
+}
+
+/**
+ *	@brief Seeks land on the right byte from the start, the current
+ *		   position and the end, on both sides of a buffer boundary.
+ */
+void testSeeks() {
+	TemporaryDirectory directory;
+	const auto path = directory.path() / "in.wav";
+	const auto payload = pattern(decodedBufferSize * 3 + 123);
+
+	writeFile(path, headerOf(AudioFormat::SFX) + payload);
+
+	DecodedStream stream(path);
+	const auto boundary = static_cast<streamoff>(decodedBufferSize);
+
+	for( const auto offset : { boundary - 1, boundary, boundary + 1, streamoff(0), boundary * 2 - 3, boundary - 5 } ) {
+		stream.seekg(offset);
+		CHECK(stream.tellg() == offset);
+		if( !CHECK(readSome(stream, 10) == payload.substr(static_cast<size_t>(offset), 10)) )
+			cerr << "  at " << offset << '\n';
+		CHECK(stream.tellg() == offset + 10);
+	}
+
+	// A read that starts in the buffer and ends past it
+	stream.seekg(boundary - 100);
+	CHECK(stream.get() == static_cast<unsigned char>(payload[decodedBufferSize - 100]));
+	CHECK(readSome(stream, 300) == payload.substr(decodedBufferSize - 99, 300));
+
+	stream.seekg(-20, ios::cur);
+	CHECK(stream.tellg() == boundary + 181);
+	CHECK(readSome(stream, 5) == payload.substr(decodedBufferSize + 181, 5));
+
+	stream.seekg(-7, ios::end);
+	CHECK(readSome(stream, 100) == payload.substr(payload.size() - 7));
+	CHECK(stream.eof());
+
+	stream.clear();
+	stream.seekg(0, ios::end);
+	CHECK(stream.tellg() == static_cast<streamoff>(payload.size()));
+	stream.seekg(-1, ios::beg);
+	CHECK(stream.fail());
+}
+
+/**
+ *	@brief A header cut short is not a header, so the file is presented
+ *		   whole, and an empty file gives nothing.
+ */
+void testShortFiles() {
+	TemporaryDirectory directory;
+	const auto header = headerOf(AudioFormat::VO);
+	const auto truncated = directory.path() / "truncated.wav";
+	const auto empty = directory.path() / "empty.wav";
+	const auto only = directory.path() / "header.wav";
+
+	writeFile(truncated, header.substr(0, header.size() - 1));
+	writeFile(empty, "");
+	writeFile(only, header);
+
+	DecodedStream stream(truncated);
+
+	CHECK(stream.format() == AudioFormat::None);
+	CHECK(string(istreambuf_iterator<char>(stream), {}) == header.substr(0, header.size() - 1));
+
+	DecodedStream emptyStream(empty);
+
+	CHECK(emptyStream.size() == 0);
+	CHECK(emptyStream.get() == char_traits<char>::eof());
+
+	DecodedStream onlyStream(only);
+
+	CHECK(onlyStream.format() == AudioFormat::VO);
+	CHECK(onlyStream.size() == 0);
+	CHECK(onlyStream.get() == char_traits<char>::eof());
+}
+
+/**
+ *	@brief Random reads of random sizes match the payload.
+ */
+void testRandomAccess() {
+	TemporaryDirectory directory;
+	const auto path = directory.path() / "in.wav";
+	const auto payload = pattern(decodedBufferSize * 4 + 1);
+
+	writeFile(path, headerOf(AudioFormat::SFX) + payload);
+
+	DecodedStream stream(path);
+	mt19937 random(1);
+	bool same = true;
+
+	for( int i = 0; i < 2000 && same; ++i ) {
+		const auto offset = random() % payload.size();
+		const auto count = random() % (decodedBufferSize * 2);
+
+		stream.clear();
+		stream.seekg(static_cast<streamoff>(offset));
+		same = readSome(stream, count) == payload.substr(offset, count);
+	}
+	CHECK(same);
+}
+
+/**
+ *	@brief A missing file throws the open error, and one that cannot be
+ *		   read throws the read error.
+ */
+void testUnreadableFiles() {
+	TemporaryDirectory directory;
+	const auto missing = directory.path() / "missing.wav";
+	string message;
+
+	try {
+		DecodedStream stream(missing);
+	}
+	catch( const runtime_error& ex ) {
+		message = ex.what();
+	}
+	CHECK(message == openErrorMsg(missing));
+
+	const auto folder = directory.path() / "folder";
+
+	fs::create_directories(folder);
+	message.clear();
+	try {
+		DecodedStream stream(folder);
+	}
+	catch( const runtime_error& ex ) {
+		message = ex.what();
+	}
+	CHECK(message == readErrorMsg(folder));
+}
+
+int main() {
+	testMatchesDecode();
+	testSeeks();
+	testShortFiles();
+	testRandomAccess();
+	testUnreadableFiles();
+	return finish("decodedstream");
+}
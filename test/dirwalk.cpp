@@ -0,0 +1,171 @@
+/**
+ *	@file dirwalk.cpp
+ *	@brief Tests of the parallel directory walker.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "check.h"
+#include "dirwalk.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	using Entries = vector<pair<fs::path, bool>>;
+
+	Entries walk(const fs::path& root, unsigned workers) {
+		Entries entries;
+
+		walkDirectory(root, [&](const fs::path& path, bool isDirectory) {
+			entries.emplace_back(path, isDirectory);
+		}, workers);
+		return entries;
+	}
+
+	Entries iterate(const fs::path& root) {
+		Entries entries;
+
+		for( const auto& entry : fs::recursive_directory_iterator(root) )
+			entries.emplace_back(entry.path(), entry.is_directory());
+		return entries;
+	}
+}
+
+/**
+ *	@brief The walk visits the same entries in the same order as
+ *		   recursive_directory_iterator, however many threads read ahead.
+ */
+void testMatchesIterator() {
+	TemporaryDirectory directory;
+	const auto root = directory.path() / "tree";
+
+	for( int a = 0; a < 6; ++a ) {
+		for( int b = 0; b < 6; ++b ) {
+			for( int f = 0; f < 4; ++f )
+				writeFile(root / ("a" + to_string(a)) / ("b" + to_string(b)) / ("f" + to_string(f)), "");
+		}
+		writeFile(root / ("a" + to_string(a)) / "file", "");
+	}
+	fs::create_directories(root / "empty");
+
+	const auto expected = iterate(root);
+
+	for( const unsigned workers : { 1u, 2u, 8u, 0u } ) {
+		if( !CHECK(walk(root, workers) == expected) )
+			cerr << "  with " << workers << " workers\n";
+	}
+}
+
+/**
+ *	@brief A symbolic link to a directory counts as a directory but is not
+ *		   followed, and one to a file or to nothing counts as a file.
+ */
+void testSymbolicLinks() {
+	TemporaryDirectory directory;
+	const auto root = directory.path() / "tree";
+
+	writeFile(root / "real" / "inside", "");
+	writeFile(root / "file", "");
+
+	error_code error;
+
+	fs::create_directory_symlink(root / "real", root / "link", error);
+	if( error )
+		return;
+	fs::create_symlink(root / "file", root / "filelink");
+	fs::create_symlink(root / "missing", root / "dangling");
+
+	bool linkSeen = false, fileLinkSeen = false, danglingSeen = false;
+
+	for( const auto& [path, isDirectory] : walk(root, 2) ) {
+		if( path == root / "link" )
+			linkSeen = isDirectory;
+		if( path == root / "filelink" )
+			fileLinkSeen = !isDirectory;
+		if( path == root / "dangling" )
+			danglingSeen = !isDirectory;
+		CHECK(path.parent_path() != root / "link");
+	}
+	CHECK(linkSeen);
+	CHECK(fileLinkSeen);
+	CHECK(danglingSeen);
+}
+
+/**
+ *	@brief A root that cannot be read throws filesystem_error, and an empty
+ *		   one visits nothing.
+ */
+void testRootErrors() {
+	TemporaryDirectory directory;
+	bool thrown = false;
+
+	try {
+		walk(directory.path() / "missing", 2);
+	}
+	catch( const fs::filesystem_error& ) {
+		thrown = true;
+	}
+	CHECK(thrown);
+	CHECK(walk(directory.path(), 2).empty());
+}
+
+/**
+ *	@brief An exception thrown by the visitor stops the walk and reaches
+ *		   the caller, with readahead threads still busy.
+ */
+void testVisitorException() {
+	TemporaryDirectory directory;
+	const auto root = directory.path() / "tree";
+
+	for( int a = 0; a < 50; ++a )
+		writeFile(root / ("a" + to_string(a)) / "f", "");
+
+	size_t visited = 0;
+	bool thrown = false;
+
+	try {
+		walkDirectory(root, [&](const fs::path&, bool) {
+			if( ++visited == 3 )
+				throw runtime_error("stop");
+		}, 4);
+	}
+	catch( const runtime_error& ) {
+		thrown = true;
+	}
+	CHECK(thrown);
+	CHECK(visited == 3);
+}
+
+int main() {
+	testMatchesIterator();
+	testSymbolicLinks();
+	testRootErrors();
+	testVisitorException();
+	return finish("dirwalk");
+}
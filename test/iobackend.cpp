@@ -0,0 +1,254 @@
+/**
+ *	@file iobackend.cpp
+ *	@brief Tests of the I/O engines that copy payloads and of the staged
+ *		   output files they write to.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "iobackend.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	const IoEngine engines[] = {
+		IoEngine::Auto,
+		IoEngine::Stream,
+		IoEngine::Block,
+		IoEngine::Mmap,
+		IoEngine::CopyFileRange,
+		IoEngine::Sendfile,
+		IoEngine::Uring,
+	};
+
+	/**
+	 *	@brief Makes bytes that differ from one position to the next, so a
+	 *		   misplaced block shows.
+	 */
+	string pattern(size_t size) {
+		string bytes(size, '\0');
+
+		for( size_t i = 0; i < size; ++i )
+			bytes[i] = static_cast<char>((i * 131 + i / 251) & 0xff);
+		return bytes;
+	}
+}
+
+/**
+ *	@brief Every engine writes the prefix followed by the input from the
+ *		   offset on, for empty, small, block-sized and multi-block inputs.
+ */
+void testEnginesCopyAlike() {
+	TemporaryDirectory directory;
+	const string prefix = "PREFIX";
+
+	for( const size_t size : { size_t(0), size_t(1), size_t(4095), size_t(1) << 20, (size_t(3) << 20) + 17 } ) {
+		const auto contents = pattern(size);
+		const auto input = directory.path() / ("in" + to_string(size));
+
+		writeFile(input, contents);
+
+		for( const auto offset : { size_t(0), size_t(5), size + 3 } ) {
+			const auto expected = offset < size ? contents.substr(offset) : string();
+
+			for( const auto engine : engines ) {
+				const auto destination = directory.path() / ("out" + to_string(size) + "_" + to_string(offset) + "_" + toString(engine));
+				FileError error;
+				StagedFile output(destination, error);
+
+				if( !CHECK(!error) )
+					continue;
+
+				const auto copied = transfer(input, offset, prefix, output, engine, error);
+
+				CHECK(!error);
+				CHECK(copied == expected.size());
+				output.commit(error);
+				CHECK(!error);
+				if( !CHECK(readFile(destination) == prefix + expected) )
+					cerr << "  engine " << toString(engine) << ", size " << size << ", offset " << offset << '\n';
+			}
+		}
+	}
+}
+
+/**
+ *	@brief A missing input fails with CodecErrc::Open, and the throwing
+ *		   overload names it.
+ */
+void testMissingInput() {
+	TemporaryDirectory directory;
+	const auto input = directory.path() / "missing";
+
+	for( const auto engine : engines ) {
+		FileError error;
+		StagedFile output(directory.path() / "out", error);
+
+		transfer(input, 0, {}, output, engine, error);
+		CHECK(error.code == CodecErrc::Open);
+	}
+
+	StagedFile output(directory.path() / "out");
+	string message;
+
+	try {
+		transfer(input, 0, {}, output);
+	}
+	catch( const runtime_error& ex ) {
+		message = ex.what();
+	}
+	CHECK(message == openErrorMsg(input));
+}
+
+/**
+ *	@brief Engine names convert both ways, and unknown names are rejected.
+ */
+void testEngineNames() {
+	for( const auto engine : engines )
+		CHECK(toIoEngine(toString(engine)) == engine);
+
+	CHECK(!toIoEngine(""));
+	CHECK(!toIoEngine("Block"));
+	CHECK(!toIoEngine("blocks"));
+}
+
+/**
+ *	@brief Auto never picks itself.
+ */
+void testSelectEngine() {
+	for( const auto size : { uintmax_t(0), uintmax_t(1) << 10, uintmax_t(1) << 30 } ) {
+		CHECK(selectEngine(size, true) != IoEngine::Auto);
+		CHECK(selectEngine(size, false) != IoEngine::Auto);
+	}
+}
+
+/**
+ *	@brief Lists the names in a directory, hidden staging files included.
+ */
+vector<string> namesIn(const fs::path& directory) {
+	vector<string> names;
+
+	for( const auto& entry : fs::directory_iterator(directory) )
+		names.push_back(entry.path().filename().string());
+	sort(names.begin(), names.end());
+	return names;
+}
+
+/**
+ *	@brief A staged file appears under its name only once committed, and
+ *		   leaves nothing behind when it is not.
+ */
+void testStagedFileVisibility() {
+	TemporaryDirectory directory;
+	const auto destination = directory.path() / "out.wav";
+
+	{
+		StagedFile output(destination);
+
+		writeFile(output.path(), "data");
+		CHECK(!fs::exists(destination));
+	}
+	CHECK(namesIn(directory.path()).empty());
+
+	{
+		StagedFile output(destination);
+
+		writeFile(output.path(), "data");
+		output.commit();
+	}
+	CHECK(readFile(destination) == "data");
+	CHECK(namesIn(directory.path()) == vector<string>{ "out.wav" });
+}
+
+/**
+ *	@brief Committing replaces a file already there, and missing parent
+ *		   directories are created.
+ */
+void testStagedFileReplacesAndCreatesParents() {
+	TemporaryDirectory directory;
+	const auto destination = directory.path() / "a" / "b" / "out.wav";
+
+	{
+		StagedFile output(destination);
+
+		writeFile(output.path(), "old");
+		output.commit();
+	}
+	{
+		StagedFile output(destination);
+
+		writeFile(output.path(), "new");
+		CHECK(readFile(destination) == "old");
+		output.commit();
+	}
+	CHECK(readFile(destination) == "new");
+	CHECK(namesIn(destination.parent_path()) == vector<string>{ "out.wav" });
+}
+
+/**
+ *	@brief A destination whose parent is a file cannot be staged.
+ */
+void testStagedFileFailure() {
+	TemporaryDirectory directory;
+	FileError error;
+
+	writeFile(directory.path() / "file", "x");
+
+	StagedFile output(directory.path() / "file" / "out.wav", error);
+
+	CHECK(error.code == CodecErrc::Write);
+}
+
+/**
+ *	@brief Staging paths are hidden, beside their destination, and distinct.
+ */
+void testStagingPath() {
+	const fs::path destination = "dir/out.wav";
+	const auto first = getStagingPath(destination);
+	const auto second = getStagingPath(destination);
+
+	CHECK(first.parent_path() == destination.parent_path());
+	CHECK(first.filename().string().rfind(".out.wav.", 0) == 0);
+	CHECK(first.extension() == ".tmp");
+	CHECK(first != second);
+}
+
+int main() {
+	testEnginesCopyAlike();
+	testMissingInput();
+	testEngineNames();
+	testSelectEngine();
+	testStagedFileVisibility();
+	testStagedFileReplacesAndCreatesParents();
+	testStagedFileFailure();
+	testStagingPath();
+	return finish("iobackend");
+}
@@ -0,0 +1,155 @@
+/**
+ *	@file listfile.cpp
+ *	@brief Tests of reading lists of files.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "listfile.h"
+
+#ifdef SITHCODEC_POSIX
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief Reads every line of a list.
+	 */
+	vector<string> linesOf(const fs::path& path) {
+		ListFile list(path);
+		vector<string> lines;
+		string_view line;
+
+		while( list.next(line) )
+			lines.emplace_back(line);
+		return lines;
+	}
+
+	/**
+	 *	@brief Writes a list and reads it back.
+	 */
+	vector<string> parse(const fs::path& path, string_view contents) {
+		writeFile(path, contents);
+		return linesOf(path);
+	}
+}
+
+/**
+ *	@brief Both line endings are accepted, blank lines are skipped, and the
+ *		   last line needs no ending.
+ */
+void testLineEndings() {
+	TemporaryDirectory directory;
+	const auto path = directory.path() / "list.txt";
+	const vector<string> expected{ "a.wav", "dir/b.wav", "c d.wav" };
+
+	CHECK(parse(path, "a.wav\ndir/b.wav\nc d.wav\n") == expected);
+	CHECK(parse(path, "a.wav\r\ndir/b.wav\r\nc d.wav\r\n") == expected);
+	CHECK(parse(path, "a.wav\ndir/b.wav\r\nc d.wav") == expected);
+	CHECK(parse(path, "\n\r\na.wav\n\n\r\ndir/b.wav\nc d.wav\r\n\n") == expected);
+	CHECK(parse(path, "a.wav\r") == vector<string>{ "a.wav" });
+}
+
+/**
+ *	@brief Lists with no paths give no lines.
+ */
+void testEmptyLists() {
+	TemporaryDirectory directory;
+	const auto path = directory.path() / "list.txt";
+
+	CHECK(parse(path, "").empty());
+	CHECK(parse(path, "\n").empty());
+	CHECK(parse(path, "\r\n\n\r\n").empty());
+}
+
+/**
+ *	@brief Lines are handed out whole, however long, and stay valid while
+ *		   the list is open.
+ */
+void testLongLines() {
+	TemporaryDirectory directory;
+	const auto path = directory.path() / "list.txt";
+	const string longLine(100000, 'x');
+
+	writeFile(path, longLine + "\nshort\n" + longLine);
+
+	ListFile list(path);
+	string_view first, second, third, end;
+
+	CHECK(list.next(first));
+	CHECK(list.next(second));
+	CHECK(list.next(third));
+	CHECK(!list.next(end));
+	CHECK(!list.next(end));
+	CHECK(first == longLine);
+	CHECK(second == "short");
+	CHECK(third == longLine);
+}
+
+/**
+ *	@brief A missing list throws the open error, and a list that cannot be
+ *		   mapped is read instead.
+ */
+void testSources() {
+	TemporaryDirectory directory;
+	const auto missing = directory.path() / "missing.txt";
+	string message;
+
+	try {
+		ListFile list(missing);
+	}
+	catch( const runtime_error& ex ) {
+		message = ex.what();
+	}
+	CHECK(message == openErrorMsg(missing));
+
+#ifdef SITHCODEC_POSIX
+	const auto pipe = directory.path() / "pipe";
+
+	if( ::mkfifo(pipe.c_str(), 0600) != 0 )
+		return;
+
+	thread writer([&] { writeFile(pipe, "a.wav\r\n\nb.wav"); });
+
+	CHECK(linesOf(pipe) == (vector<string>{ "a.wav", "b.wav" }));
+	writer.join();
+#endif
+}
+
+int main() {
+	testLineEndings();
+	testEmptyLists();
+	testLongLines();
+	testSources();
+	return finish("listfile");
+}
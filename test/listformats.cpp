@@ -0,0 +1,154 @@
+/**
+ *	@file listformats.cpp
+ *	@brief Tests of listing the formats of the files in a directory.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "check.h"
+#include "codec.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief Lists a directory into a string.
+	 */
+	string list(const fs::path& directory, ListFormat format, unsigned jobs) {
+		ostringstream output;
+		ListOptions options;
+
+		options.format = format;
+		options.jobs = jobs;
+		printFormats(directory, output, options);
+		return output.str();
+	}
+
+	/**
+	 *	@brief Gets the format a listing shows for a file, or nothing if it
+	 *		   cannot be read.
+	 */
+	const char* expectedFormat(const fs::path& path) {
+		const auto format = probeFormat(path);
+
+		return format ? getFormatName(format.value()) : nullptr;
+	}
+}
+
+/**
+ *	@brief Each layout lists every entry in walk order, whatever the number
+ *		   of threads, across many probing chunks.
+ */
+void testLayouts() {
+	TemporaryDirectory directory;
+	const auto root = directory.path() / "tree";
+
+	for( int i = 0; i < 700; ++i ) {
+		const auto format = i % 3 == 0 ? AudioFormat::SFX : i % 3 == 1 ? AudioFormat::VO : AudioFormat::None;
+
+		writeFile(root / ("d" + to_string(i % 4)) / ("f" + to_string(i) + ".wav"),
+			(format == AudioFormat::None ? string() : headerOf(format)) + "payload");
+	}
+	writeFile(root / "quote\"comma,.wav", headerOf(AudioFormat::SFX));
+
+	error_code error;
+
+	// A dangling link cannot be probed
+	fs::create_symlink(root / "missing", root / "dangling.wav", error);
+
+	string text = root.string() + "\n";
+	string csv = "path,type,format\n";
+	string json;
+
+	for( const auto& entry : fs::recursive_directory_iterator(root) ) {
+		const auto path = entry.path();
+		const bool isDirectory = entry.is_directory();
+		const auto format = isDirectory ? nullptr : expectedFormat(path);
+
+		if( isDirectory ) {
+			text += indentLevel1 + path.string() + "\n";
+			csv += "\"" + path.string() + "\",directory,\n";
+			json += "{\"path\":\"" + path.string() + "\",\"type\":\"directory\"}\n";
+			continue;
+		}
+
+		string quoted = path.string();
+
+		for( size_t pos = 0; (pos = quoted.find('"', pos)) != string::npos; pos += 2 )
+			quoted.insert(pos, 1, '"');
+
+		string escaped = path.string();
+
+		for( size_t pos = 0; (pos = escaped.find('"', pos)) != string::npos; pos += 2 )
+			escaped.insert(pos, 1, '\\');
+
+		text += indentLevel2 + path.filename().string() + " " + (format ? format : failMsg) + "\n";
+		csv += "\"" + quoted + "\",file," + (format ? format : "error") + "\n";
+		json += "{\"path\":\"" + escaped + "\",\"type\":\"file\",\"format\":" + (format ? "\"" + string(format) + "\"" : "null") + "}\n";
+	}
+
+	for( const unsigned jobs : { 1u, 16u } ) {
+		if( !CHECK(list(root, ListFormat::Text, jobs) == text) )
+			cerr << "  text with " << jobs << " jobs\n";
+		if( !CHECK(list(root, ListFormat::Csv, jobs) == csv) )
+			cerr << "  CSV with " << jobs << " jobs\n";
+		if( !CHECK(list(root, ListFormat::JsonLines, jobs) == json) )
+			cerr << "  JSON lines with " << jobs << " jobs\n";
+	}
+}
+
+/**
+ *	@brief Anything but a directory is refused with the open error.
+ */
+void testNotADirectory() {
+	TemporaryDirectory directory;
+	const auto file = directory.path() / "file.wav";
+	const auto missing = directory.path() / "missing";
+
+	writeFile(file, "");
+
+	for( const auto& path : { file, missing } ) {
+		string message;
+
+		try {
+			list(path, ListFormat::Text, 2);
+		}
+		catch( const runtime_error& ex ) {
+			message = ex.what();
+		}
+		CHECK(message == openErrorMsg(path));
+	}
+
+	CHECK(list(directory.path(), ListFormat::JsonLines, 2) == "{\"path\":\"" + file.string() + "\",\"type\":\"file\",\"format\":\"None\"}\n");
+}
+
+int main() {
+	testLayouts();
+	testNotADirectory();
+	return finish("listformats");
+}
@@ -0,0 +1,253 @@
+/**
+ *	@file manifest.cpp
+ *	@brief Tests of the manifest of converted files.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <chrono>
+#include <string>
+
+#include "check.h"
+#include "codec.h"
+#include "manifest.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief Moves the modification time of a file without changing it.
+	 */
+	void touch(const fs::path& path) {
+		fs::last_write_time(path, fs::last_write_time(path) + chrono::seconds(10));
+	}
+
+	/**
+	 *	@brief Finds a file out of date, then records it as converted.
+	 */
+	void convert(Manifest& manifest, const fs::path& input, const fs::path& output) {
+		CHECK(!manifest.upToDate(input, "decode", output));
+		manifest.record(input, "decode", output);
+	}
+}
+
+/**
+ *	@brief Records survive a save and load, and saving the loaded manifest
+ *		   writes the same bytes, escaped paths included.
+ */
+void testRoundTrip() {
+	TemporaryDirectory directory;
+	const auto path = directory.path() / "manifest";
+	const fs::path inputs[] = {
+		directory.path() / "plain.wav",
+		directory.path() / "tab\tand\nnewline.wav",
+		directory.path() / "back\\slash.wav",
+	};
+
+	{
+		Manifest manifest(path);
+
+		for( const auto& input : inputs ) {
+			writeFile(input, "input");
+			writeFile(input.string() + ".out", "output");
+			convert(manifest, input, input.string() + ".out");
+		}
+		manifest.save();
+	}
+
+	const auto saved = readFile(path);
+	Manifest manifest(path);
+
+	for( const auto& input : inputs )
+		CHECK(manifest.upToDate(input, "decode", input.string() + ".out"));
+
+	manifest.save();
+	CHECK(readFile(path) == saved);
+	CHECK(saved.rfind("SithCodec manifest 1\n", 0) == 0);
+}
+
+/**
+ *	@brief A manifest from another version is ignored, malformed lines are
+ *		   skipped, and a missing one starts empty.
+ */
+void testParsing() {
+	TemporaryDirectory directory;
+	const auto path = directory.path() / "manifest";
+	const auto input = directory.path() / "a.wav";
+	const auto output = directory.path() / "a.out";
+
+	writeFile(input, "input");
+	writeFile(output, "output");
+
+	{
+		Manifest manifest(path);
+
+		CHECK(!fs::exists(path));
+		convert(manifest, input, output);
+		manifest.save();
+	}
+
+	const auto saved = readFile(path);
+	const auto body = saved.substr(saved.find('\n') + 1);
+
+	writeFile(path, "SithCodec manifest 0\n" + body);
+	CHECK(!Manifest(path).upToDate(input, "decode", output));
+
+	writeFile(path, saved + "decode\tx\n\n" + "decode\t1\t2\t3\tzz\t4\t5\t6\tb\tc\n");
+	{
+		Manifest manifest(path);
+
+		CHECK(manifest.upToDate(input, "decode", output));
+		manifest.save();
+	}
+	CHECK(readFile(path) == saved);
+}
+
+/**
+ *	@brief A changed input or output, another conversion, or another output
+ *		   path makes a file out of date; another extension does not.
+ */
+void testUpToDate() {
+	TemporaryDirectory directory;
+	const auto input = directory.path() / "a.wav";
+	const auto output = directory.path() / "out" / "a.wav";
+	Manifest manifest(directory.path() / "manifest");
+
+	writeFile(input, "input");
+	writeFile(output, "output");
+	convert(manifest, input, output);
+
+	CHECK(manifest.upToDate(input, "decode", output));
+	CHECK(manifest.upToDate(input, "decode", directory.path() / "out" / "a.sfx"));
+	CHECK(!manifest.upToDate(input, "encode SFX", output));
+	CHECK(!manifest.upToDate(input, "decode", directory.path() / "other" / "a.wav"));
+
+	touch(output);
+	CHECK(!manifest.upToDate(input, "decode", output));
+	manifest.record(input, "decode", output);
+	CHECK(manifest.upToDate(input, "decode", output));
+
+	touch(input);
+	CHECK(!manifest.upToDate(input, "decode", output));
+
+	fs::remove(input);
+	CHECK(!manifest.upToDate(input, "decode", output));
+}
+
+/**
+ *	@brief record() only takes inputs that upToDate() found out of date,
+ *		   and outputs that exist.
+ */
+void testRecordNeedsCheck() {
+	TemporaryDirectory directory;
+	const auto input = directory.path() / "a.wav";
+	const auto output = directory.path() / "a.out";
+	Manifest manifest(directory.path() / "manifest");
+
+	writeFile(input, "input");
+	writeFile(output, "output");
+
+	manifest.record(input, "decode", output);
+	CHECK(!manifest.upToDate(input, "decode", output));
+
+	manifest.record(input, "decode", directory.path() / "missing");
+	CHECK(!manifest.upToDate(input, "decode", output));
+}
+
+/**
+ *	@brief With content hashes, a touched input is still up to date, but one
+ *		   rewritten at the same size is not.
+ */
+void testHashContents() {
+	TemporaryDirectory directory;
+	const auto input = directory.path() / "a.wav";
+	const auto output = directory.path() / "a.out";
+
+	writeFile(input, "input");
+	writeFile(output, "output");
+
+	Manifest hashing(directory.path() / "hashing", true), plain(directory.path() / "plain");
+
+	convert(hashing, input, output);
+	convert(plain, input, output);
+
+	touch(input);
+	CHECK(hashing.upToDate(input, "decode", output));
+	CHECK(!plain.upToDate(input, "decode", output));
+
+	writeFile(input, "INPUT");
+	CHECK(!hashing.upToDate(input, "decode", output));
+
+	CHECK(hashFile(input) != hashFile(output));
+	CHECK(hashFile(input).value_or(0) != 0);
+	CHECK(!hashFile(directory.path() / "missing"));
+}
+
+/**
+ *	@brief A second batch with the same manifest converts nothing, and a
+ *		   changed file is converted again.
+ */
+void testBatch() {
+	TemporaryDirectory directory;
+	const auto input = directory.path() / "in";
+	const auto output = directory.path() / "out";
+
+	for( int i = 0; i < 10; ++i )
+		writeFile(input / ("f" + to_string(i) + ".wav"), "payload " + to_string(i));
+
+	BatchOptions options;
+
+	options.manifest = directory.path() / "manifest";
+
+	const auto first = encodeAll(input, AudioFormat::SFX, output, options);
+
+	CHECK(first.count(FileStatus::Done) == 10);
+
+	const auto second = encodeAll(input, AudioFormat::SFX, output, options);
+
+	CHECK(second.count(FileStatus::UpToDate) == 10);
+
+	writeFile(input / "f3.wav", "changed payload");
+	touch(input / "f3.wav");
+
+	const auto third = encodeAll(input, AudioFormat::SFX, output, options);
+
+	CHECK(third.count(FileStatus::UpToDate) == 9);
+	CHECK(third.count(FileStatus::Done) == 1);
+	CHECK(readFile(output / "f3.wav") == headerOf(AudioFormat::SFX) + "changed payload");
+
+	const auto decoded = decodeAll(input, output, options);
+
+	CHECK(decoded.count(FileStatus::Done) == 10);
+}
+
+int main() {
+	testRoundTrip();
+	testParsing();
+	testUpToDate();
+	testRecordNeedsCheck();
+	testHashContents();
+	testBatch();
+	return finish("manifest");
+}
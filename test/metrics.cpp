@@ -0,0 +1,222 @@
+/**
+ *	@file metrics.cpp
+ *	@brief Tests of the Prometheus metrics export.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <chrono>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "check.h"
+#include "metrics.h"
+#include "operationtable.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief Parses the text exposition format, checking that every sample
+	 *		   follows the HELP and TYPE lines of its family.
+	 *
+	 *	@return samples keyed by name and labels, or nothing if malformed
+	 */
+	optional<map<string, double>> parseMetrics(const string& text) {
+		map<string, double> samples;
+		istringstream input(text);
+		string line, family;
+
+		while( getline(input, line) ) {
+			if( line.rfind("# HELP ", 0) == 0 ) {
+				family = line.substr(7, line.find(' ', 7) - 7);
+
+				string type;
+
+				if( !getline(input, type) || type.rfind("# TYPE " + family + ' ', 0) != 0 )
+					return nullopt;
+				continue;
+			}
+
+			const auto space = line.rfind(' ');
+
+			if( family.empty() || space == string::npos || line.compare(0, family.size(), family) != 0 )
+				return nullopt;
+
+			const auto key = line.substr(0, space);
+			const auto rest = key.substr(family.size());
+
+			// Summaries add _sum and _count; anything else is a label set
+			if( !rest.empty() && rest != "_sum" && rest != "_count" && (rest.front() != '{' || rest.back() != '}') )
+				return nullopt;
+
+			size_t parsed = 0;
+
+			try {
+				samples[key] = stod(line.substr(space + 1), &parsed);
+			}
+			catch( const logic_error& ) {
+				return nullopt;
+			}
+			if( parsed != line.size() - space - 1 || samples.count(key) != 1 )
+				return nullopt;
+		}
+		return samples;
+	}
+
+	/**
+	 *	@brief Records a converted file.
+	 */
+	void recordFile(BatchStats& stats, AudioFormat format, FileOutcome outcome, uint64_t nanoseconds) {
+		FileConversion conversion;
+
+		conversion.format = format;
+		conversion.bytesRead = 1000;
+		conversion.bytesWritten = 1018;
+		stats.recordFile({ "file.wav", {} }, outcome, conversion, nanoseconds);
+	}
+}
+
+/**
+ *	@brief Every family and sample is present and well formed, with the
+ *		   values of the statistics, whatever the stream's formatting.
+ */
+void testFormat() {
+	BatchStats stats;
+
+	stats.fileQueued();
+	stats.fileQueued();
+	stats.fileQueued();
+	stats.fileTaken();
+	stats.fileTaken();
+	recordFile(stats, AudioFormat::SFX, FileOutcome::Done, 2000000);
+	recordFile(stats, AudioFormat::VO, FileOutcome::Failed, 1500);
+	stats.addStageTime(BatchStage::Enumerate, 250000000);
+
+	ostringstream output;
+
+	output << fixed;
+	output.precision(2);
+	writeMetrics(stats, output);
+	CHECK(output.precision() == 2);
+
+	const auto samples = parseMetrics(output.str());
+
+	if( !CHECK(samples) ) {
+		cerr << output.str();
+		return;
+	}
+
+	const auto value = [&](const string& key) {
+		const auto found = samples->find(key);
+
+		return found == samples->end() ? -1.0 : found->second;
+	};
+
+	CHECK(samples->size() == 9 + 3 + 3 + 4 + 5 + 3);
+	CHECK(value("sithcodec_files_total{format=\"sfx\",outcome=\"done\"}") == 1);
+	CHECK(value("sithcodec_files_total{format=\"vo\",outcome=\"failed\"}") == 1);
+	CHECK(value("sithcodec_files_total{format=\"none\",outcome=\"up_to_date\"}") == 0);
+	CHECK(value("sithcodec_read_bytes_total{format=\"sfx\"}") == 1000);
+	CHECK(value("sithcodec_written_bytes_total{format=\"sfx\"}") == 1018);
+	CHECK(value("sithcodec_written_bytes_total{format=\"vo\"}") == 0);
+	CHECK(value("sithcodec_stage_seconds_total{stage=\"enumerate\"}") == 0.25);
+	CHECK(value("sithcodec_stage_seconds_total{stage=\"convert\"}") == 0.0020015);
+	CHECK(value("sithcodec_file_duration_seconds{quantile=\"0.5\"}") > 0);
+	CHECK(value("sithcodec_file_duration_seconds{quantile=\"0.99\"}") == 0.002);
+	CHECK(value("sithcodec_file_duration_seconds_sum") == 0.0020015);
+	CHECK(value("sithcodec_file_duration_seconds_count") == 2);
+	CHECK(value("sithcodec_queue_depth") == 1);
+	CHECK(value("sithcodec_active_workers") == 0);
+	CHECK(value("sithcodec_elapsed_seconds") == 0);
+}
+
+/**
+ *	@brief The file is written on creation, rewritten while the batch runs
+ *		   and holds the final values after finish(), with no staging files
+ *		   left behind.
+ */
+void testFile() {
+	TemporaryDirectory directory;
+	const auto path = directory.path() / "sithcodec.prom";
+	BatchStats stats;
+	MetricsFile file(path, stats, chrono::milliseconds(5));
+
+	CHECK(parseMetrics(readFile(path)).value_or(map<string, double>())["sithcodec_queue_depth"] == 0);
+
+	stats.fileQueued();
+
+	bool rewritten = false;
+
+	for( int i = 0; i < 400 && !rewritten; ++i ) {
+		this_thread::sleep_for(chrono::milliseconds(5));
+		rewritten = readFile(path).find("sithcodec_queue_depth 1\n") != string::npos;
+	}
+	CHECK(rewritten);
+
+	stats.fileQueued();
+	file.finish();
+	CHECK(readFile(path).find("sithcodec_queue_depth 2\n") != string::npos);
+
+	// Nothing is written after finish()
+	stats.fileQueued();
+	this_thread::sleep_for(chrono::milliseconds(30));
+	CHECK(readFile(path).find("sithcodec_queue_depth 2\n") != string::npos);
+
+	size_t entries = 0;
+
+	for( const auto& entry : fs::directory_iterator(directory.path()) )
+		entries += entry.path() != path;
+	CHECK(entries == 0);
+}
+
+/**
+ *	@brief A file that cannot be written fails when the object is created.
+ */
+void testUnwritable() {
+	TemporaryDirectory directory;
+	const auto blocker = directory.path() / "file";
+	BatchStats stats;
+	bool thrown = false;
+
+	writeFile(blocker, "");
+	try {
+		MetricsFile file(blocker / "sithcodec.prom", stats, chrono::milliseconds(5));
+	}
+	catch( const runtime_error& ) {
+		thrown = true;
+	}
+	CHECK(thrown);
+}
+
+int main() {
+	testFormat();
+	testFile();
+	testUnwritable();
+	return finish("metrics");
+}
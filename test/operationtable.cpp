@@ -0,0 +1,212 @@
+/**
+ *	@file operationtable.cpp
+ *	@brief Tests of the compact table of batch files.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "operationtable.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+/**
+ *	@brief Paths come back as added, across many storage segments, and
+ *		   files of a directory share it.
+ */
+void testPaths() {
+	OperationTable table;
+	vector<fs::path> paths;
+
+	for( int i = 0; i < 5000; ++i )
+		paths.push_back(fs::path("in") / ("d" + to_string(i / 100)) / ("f" + to_string(i) + ".wav"));
+	paths.push_back("bare.wav");
+	paths.push_back("/root.wav");
+	paths.push_back("in/d3/again.wav");
+
+	for( size_t i = 0; i < paths.size(); ++i )
+		CHECK(table.add(paths[i]) == i);
+
+	CHECK(table.size() == paths.size());
+	CHECK(!table.empty());
+	CHECK(table.directoryCount() == 52);
+
+	bool same = true;
+
+	for( size_t i = 0; i < paths.size(); ++i )
+		same = same && table.path(i) == paths[i];
+	CHECK(same);
+
+	CHECK(table.directory(0) == OperationTable::StringView(fs::path("in/d0/").native()));
+	CHECK(table.name(0) == OperationTable::StringView(fs::path("f0.wav").native()));
+	CHECK(table.directory(5000).empty());
+	CHECK(table.directory(5001) == OperationTable::StringView(fs::path("/").native()));
+	CHECK(table.directory(5002) == table.directory(300));
+
+	string text = "> ";
+
+	table.appendPath(1, text);
+	CHECK(text == "> " + paths[1].string());
+}
+
+/**
+ *	@brief Names near the length limit are stored whole, even where they
+ *		   would straddle two arena segments, and longer ones are refused.
+ */
+void testLongNames() {
+	OperationTable table;
+	const string longest(65535, 'n');
+	const string tooLong(65536, 'n');
+
+	for( int i = 0; i < 4; ++i )
+		table.add(fs::path("dir") / longest.substr(0, longest.size() - static_cast<size_t>(i)));
+
+	bool whole = true;
+
+	for( size_t i = 0; i < table.size(); ++i )
+		whole = whole && table.name(i).size() == 65535 - i && table.path(i) == fs::path("dir") / longest.substr(0, 65535 - i);
+	CHECK(whole);
+
+	for( const auto& path : { fs::path("dir") / tooLong, fs::path(tooLong) / "a.wav" } ) {
+		bool thrown = false;
+
+		try {
+			table.add(path);
+		}
+		catch( const length_error& ) {
+			thrown = true;
+		}
+		CHECK(thrown);
+	}
+	CHECK(table.size() == 4);
+}
+
+/**
+ *	@brief Status, error and size columns start cleared, are set one entry
+ *		   at a time, and are counted.
+ */
+void testColumns() {
+	OperationTable table;
+
+	for( int i = 0; i < 10; ++i )
+		table.add(fs::path("f" + to_string(i)));
+
+	CHECK(table.count(FileStatus::Pending) == 10);
+	CHECK(!table.error(3));
+	CHECK(table.inputSize(3) == 0);
+
+	table.setStatus(3, FileStatus::Failed);
+	table.setError(3, { CodecErrc::Write, 28 });
+	table.setInputSize(4, 1234);
+
+	CHECK(table.status(3) == FileStatus::Failed);
+	CHECK(table.error(3).code == CodecErrc::Write);
+	CHECK(table.error(3).systemError == 28);
+	CHECK(table.inputSize(4) == 1234);
+	CHECK(table.count(FileStatus::Failed) == 1);
+	CHECK(table.count(FileStatus::Pending) == 9);
+}
+
+/**
+ *	@brief A working copy carries its entry, and updating from it sets the
+ *		   status its outcome implies.
+ */
+void testOperations() {
+	OperationTable table;
+
+	table.add(fs::path("in/a.wav"));
+	table.add(fs::path("in/b.wav"));
+	table.add(fs::path("in/c.wav"));
+	table.setInputSize(1, 99);
+
+	auto done = table.operation(0);
+	auto failed = table.operation(1);
+	auto skipped = table.operation(2);
+
+	CHECK(failed.path == fs::path("in/b.wav"));
+	CHECK(failed.index == 1);
+	CHECK(failed.size == 99);
+	CHECK(!failed.skipped);
+
+	failed.error = { CodecErrc::Open, 2 };
+	skipped.skipped = true;
+	table.update(done);
+	table.update(failed);
+	table.update(skipped);
+
+	CHECK(table.status(0) == FileStatus::Done);
+	CHECK(table.status(1) == FileStatus::Failed);
+	CHECK(table.error(1).code == CodecErrc::Open);
+	CHECK(table.status(2) == FileStatus::UpToDate);
+	CHECK(table.operation(2).skipped);
+}
+
+/**
+ *	@brief Entries already added can be read and updated while one thread
+ *		   keeps adding.
+ */
+void testConcurrentReaders() {
+	OperationTable table;
+	atomic<size_t> added{ 0 };
+	const size_t count = 200000;
+
+	thread reader([&] {
+		size_t done = 0;
+
+		while( done < count ) {
+			const auto available = added.load(memory_order_acquire);
+
+			for( ; done < available; ++done ) {
+				auto operation = table.operation(done);
+
+				if( operation.path.filename() != "f" + to_string(done) )
+					operation.error = { CodecErrc::Other };
+				table.update(operation);
+			}
+		}
+	});
+
+	for( size_t i = 0; i < count; ++i ) {
+		table.add(fs::path("d" + to_string(i / 1000)) / ("f" + to_string(i)));
+		added.store(i + 1, memory_order_release);
+	}
+	reader.join();
+
+	CHECK(table.count(FileStatus::Done) == count);
+}
+
+int main() {
+	testPaths();
+	testLongNames();
+	testColumns();
+	testOperations();
+	testConcurrentReaders();
+	return finish("operationtable");
+}
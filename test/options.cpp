@@ -0,0 +1,91 @@
+/**
+ *	@file options.cpp
+ *	@brief Tests of parsing the numeric options of the benchmarks.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "check.h"
+#include "options.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief Determines whether parsing a count throws an exception of a
+	 *		   given type.
+	 */
+	template<typename T, typename Exception>
+	bool refuses(const string& str) {
+		try {
+			parseCount<T>(str);
+		}
+		catch( const Exception& ) {
+			return true;
+		}
+		catch( ... ) {
+		}
+		return false;
+	}
+}
+
+/**
+ *	@brief Whole decimal numbers are accepted up to the largest value of
+ *		   the type.
+ */
+void testCounts() {
+	CHECK(parseCount<unsigned>("0") == 0);
+	CHECK(parseCount<unsigned>("12") == 12);
+	CHECK(parseCount<unsigned>("007") == 7);
+	CHECK(parseCount<unsigned>("4294967295") == numeric_limits<uint32_t>::max());
+	CHECK(parseCount<uint64_t>("18446744073709551615") == numeric_limits<uint64_t>::max());
+	CHECK(parseCount<size_t>("1000000") == 1000000);
+}
+
+/**
+ *	@brief Signs, white space, stray characters and empty values are not
+ *		   counts, and numbers too large for the type are out of range.
+ */
+void testRefused() {
+	for( const auto* malformed : { "", "-1", "+1", " 1", "1 ", "1k", "12abc", "0x10", "1.5", "-", "1e3" } ) {
+		if( !CHECK((refuses<unsigned, invalid_argument>(malformed))) )
+			cerr << "  accepted \"" << malformed << "\"\n";
+	}
+
+	CHECK((refuses<unsigned, out_of_range>("4294967296")));
+	CHECK((refuses<uint64_t, out_of_range>("18446744073709551616")));
+	CHECK((refuses<unsigned char, out_of_range>("256")));
+	CHECK(parseCount<unsigned char>("255") == 255);
+}
+
+int main() {
+	testCounts();
+	testRefused();
+	return finish("options");
+}
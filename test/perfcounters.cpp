@@ -0,0 +1,175 @@
+/**
+ *	@file perfcounters.cpp
+ *	@brief Tests of the per-stage performance counters.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "perfcounters.h"
+#include "trace.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief One row of the counter table.
+	 */
+	struct Row {
+		string stage;
+		vector<string> columns;	///< calls, time and unit, then any counters and the IPC
+	};
+
+	/**
+	 *	@brief Writes the counters and splits the table into its heading and
+	 *		   rows.
+	 */
+	vector<Row> writeRows(string& heading) {
+		ostringstream output;
+
+		writeCounters(output);
+
+		istringstream input(output.str());
+		string line;
+		vector<Row> rows;
+
+		getline(input, heading);
+		getline(input, line);
+		while( getline(input, line) ) {
+			istringstream fields(line);
+			Row row;
+			string field;
+
+			fields >> row.stage;
+			while( fields >> field )
+				row.columns.push_back(field);
+			rows.push_back(row);
+		}
+		return rows;
+	}
+}
+
+/**
+ *	@brief The table is written whether or not the system permits
+ *		   counters, with the run first and stages merged by name across
+ *		   threads, slowest first.
+ */
+void testTable() {
+	// Counts from before the run are dropped
+	recordStage("stale", 5000000, {}, {});
+
+	startCounting();
+	CHECK(isCounting());
+
+	// Separate arrays, so only the text of the names matches
+	static const char first[] = "convert";
+	static const char second[] = "convert";
+
+	recordStage(first, 3000000, {}, { 10, 20, 30, 40, 50 });
+	thread other([] { recordStage(second, 4000000, { 5, 5, 5, 5, 5 }, { 15, 25, 35, 45, 55 }); });
+
+	other.join();
+	recordStage("walk", 1000000, {}, {});
+	// A count that went backwards is taken as none
+	recordStage("walk", 1000000, { 9, 9, 9, 9, 9 }, { 1, 1, 1, 1, 1 });
+	{
+		TraceSpan span("span");
+	}
+
+	string heading;
+	const auto rows = writeRows(heading);
+
+	CHECK(!isCounting());
+	CHECK(heading == "Performance counters" || heading == "Performance counters, user mode only"
+		|| heading == "Performance counters not permitted, times only");
+
+	const bool permitted = heading != "Performance counters not permitted, times only";
+
+	if( !CHECK(rows.size() == 4) )
+		return;
+	CHECK(rows[0].stage == "run" && rows[0].columns[0] == "1");
+	CHECK(rows[1].stage == "convert" && rows[1].columns[0] == "2" && rows[1].columns[1] == "7.000");
+	CHECK(rows[2].stage == "walk" && rows[2].columns[0] == "2" && rows[2].columns[1] == "2.000");
+	CHECK(rows[3].stage == "span" && rows[3].columns[0] == "1");
+
+	for( const auto& row : rows ) {
+		if( !CHECK(row.columns.size() == (permitted ? 3 + perfCounterCount + 1 : 3)) )
+			cerr << "  " << row.stage << " has " << row.columns.size() << " columns\n";
+	}
+
+	if( permitted && rows[1].columns.size() == 3 + perfCounterCount + 1 ) {
+		const vector<string> merged = { "20", "40", "60", "80", "100" };
+
+		for( size_t i = 0; i < perfCounterCount; ++i ) {
+			CHECK(rows[1].columns[3 + i] == merged[i] || rows[1].columns[3 + i] == "-");
+			CHECK(rows[2].columns[3 + i] == "0" || rows[2].columns[3 + i] == "-");
+		}
+		CHECK(rows[1].columns.back() == "2.00" || rows[1].columns.back() == "-");
+		CHECK(rows[2].columns.back() == "-");
+	}
+}
+
+/**
+ *	@brief Nothing is kept from one run to the next, and writing leaves
+ *		   the stream's formatting as it was.
+ */
+void testRestart() {
+	startCounting();
+	recordStage("old", 1000, {}, {});
+	startCounting();
+	recordStage("new", 1000, {}, {});
+
+	ostringstream output;
+
+	output.precision(4);
+	writeCounters(output);
+
+	const auto text = output.str();
+
+	CHECK(text.find(" old ") == string::npos);
+	CHECK(text.find(" new ") != string::npos);
+	CHECK(output.precision() == 4);
+	CHECK(!(output.flags() & (ios::fixed | ios::left | ios::right)));
+
+	// Reading works outside a run, and overwrites every value
+	PerfValues values;
+
+	values.fill(numeric_limits<uint64_t>::max());
+	readThreadCounters(values);
+	for( const auto value : values )
+		CHECK(value != numeric_limits<uint64_t>::max());
+}
+
+int main() {
+	testTable();
+	testRestart();
+	return finish("perfcounters");
+}
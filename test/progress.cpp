@@ -0,0 +1,276 @@
+/**
+ *	@file progress.cpp
+ *	@brief Tests of the progress report.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <chrono>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "operationtable.h"
+#include "progress.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief Records a finished file of a given input size.
+	 */
+	void finishFile(BatchStats& stats, uintmax_t size) {
+		FileOperation operation{ "file.wav", {} };
+
+		operation.size = size;
+		stats.fileTaken();
+		stats.recordFile(operation, FileOutcome::Done, {}, 1000);
+	}
+
+	/**
+	 *	@brief Splits text into lines.
+	 */
+	vector<string> linesOf(const string& text) {
+		istringstream input(text);
+		vector<string> lines;
+		string line;
+
+		while( getline(input, line) )
+			lines.push_back(line);
+		return lines;
+	}
+
+	/**
+	 *	@brief Determines whether any line matches a pattern.
+	 */
+	bool anyMatch(const vector<string>& lines, const regex& pattern) {
+		for( const auto& line : lines )
+			if( regex_match(line, pattern) )
+				return true;
+		return false;
+	}
+
+	/**
+	 *	@brief Reports every millisecond for a while, again until a line
+	 *		   matches or a few seconds have passed.
+	 *
+	 *	@return lines of the last attempt
+	 */
+	vector<string> reportUntil(const BatchStats& stats, const regex& pattern) {
+		vector<string> lines;
+
+		for( int attempt = 0; attempt < 30; ++attempt ) {
+			ostringstream output;
+
+			// Destroyed without a final report; the stream is only read after
+			{
+				ProgressReport report(output, stats, ProgressStyle::Lines, chrono::milliseconds(1));
+
+				this_thread::sleep_for(chrono::milliseconds(100));
+			}
+
+			lines = linesOf(output.str());
+			if( anyMatch(lines, pattern) )
+				break;
+		}
+		return lines;
+	}
+}
+/**
+ *	@brief Only the standard streams can be terminals.
+ */
+void testStyle() {
+	ostringstream output;
+
+	CHECK(progressStyleFor(output) == ProgressStyle::Lines);
+}
+
+/**
+ *	@brief The final report averages the whole batch and gives no time
+ *		   left, and one before the batch starts is all zeros.
+ */
+void testFinal() {
+	BatchStats stats;
+	ostringstream output;
+
+	{
+		ProgressReport report(output, stats, ProgressStyle::Lines, chrono::hours(1));
+
+		report.finish();
+	}
+	CHECK(output.str() == "[0:00:00] 0/0+ files, 0.0 MB / 0.0 MB+, 0.0 MB/s (0 files/s)\n");
+
+	stats.begin();
+	stats.fileQueued(2500000000);
+	stats.fileQueued(500000000);
+	stats.enumerationFinished();
+	finishFile(stats, 2500000000);
+	stats.end();
+
+	output.str("");
+	ProgressReport(output, stats, ProgressStyle::Lines, chrono::hours(1)).finish();
+	CHECK(regex_match(output.str(), regex(R"(\[0:00:00\] 1/2 files, 2\.5 GB / 3\.0 GB, \d+\.\d MB/s \(\d+ files/s\)\n)")));
+}
+
+/**
+ *	@brief While running, the time left comes from bytes when sizes are
+ *		   known and from files otherwise, and totals are shown as lower
+ *		   bounds until enumeration ends.
+ */
+void testTimeLeft() {
+	const regex line(R"(\[\d+:\d\d:\d\d\] \d+/\d+\+? files, \d+\.\d [MG]B / \d+\.\d [MG]B\+?, \d+\.\d MB/s \(\d+ files/s\).*)");
+
+	{
+		BatchStats stats;
+
+		stats.begin();
+		for( int i = 0; i < 10; ++i )
+			stats.fileQueued(1000000);
+
+		const auto lines = reportUntil(stats, regex(R"(.*10\+ files.*)"));
+
+		CHECK(anyMatch(lines, regex(R"(\[0:00:0\d\] 0/10\+ files, 0\.0 MB / 10\.0 MB\+, 0\.0 MB/s \(0 files/s\))")));
+		for( const auto& text : lines )
+			CHECK(regex_match(text, line) && text.find("left") == string::npos);
+	}
+	{
+		BatchStats stats;
+
+		stats.begin();
+		for( int i = 0; i < 10; ++i )
+			stats.fileQueued(1000000);
+		stats.enumerationFinished();
+
+		// A rate only shows once something finished between two samples
+		thread worker([&stats] {
+			for( int i = 0; i < 5; ++i ) {
+				this_thread::sleep_for(chrono::milliseconds(20));
+				finishFile(stats, 1000000);
+			}
+		});
+
+		const auto lines = reportUntil(stats, regex(R"(.* 5/10 files.*, \d+:\d\d:\d\d left)"));
+
+		worker.join();
+		CHECK(anyMatch(lines, regex(R"(\[0:00:0\d\] 5/10 files, 5\.0 MB / 10\.0 MB, \d+\.\d MB/s \(\d+ files/s\), \d+:\d\d:\d\d left)")));
+	}
+	{
+		// Without sizes only the files predict the time left
+		BatchStats stats;
+
+		stats.begin();
+		for( int i = 0; i < 4; ++i )
+			stats.fileQueued();
+		stats.enumerationFinished();
+
+		const auto lines = reportUntil(stats, regex(R"(.*, time left unknown)"));
+
+		CHECK(anyMatch(lines, regex(R"(\[0:00:0\d\] 0/4 files, 0\.0 MB / 0\.0 MB, 0\.0 MB/s \(0 files/s\), time left unknown)")));
+		finishFile(stats, 0);
+
+		const auto after = reportUntil(stats, regex(R"(.* 1/4 files.*, \d+:\d\d:\d\d left)"));
+
+		CHECK(anyMatch(after, regex(R"(.* 1/4 files.*, \d+:\d\d:\d\d left)")));
+	}
+}
+
+/**
+ *	@brief A stalled batch ends up with an unknown time left rather than
+ *		   one that grows without bound.
+ */
+void testStall() {
+	BatchStats stats;
+
+	stats.begin();
+	stats.fileQueued(1000000000000);
+	stats.fileQueued(1000000000000);
+	stats.enumerationFinished();
+	this_thread::sleep_for(chrono::milliseconds(2));
+	finishFile(stats, 1000000000000);
+
+	const auto lines = reportUntil(stats, regex(R"(.*, time left unknown)"));
+
+	CHECK(anyMatch(lines, regex(R"(.*, time left unknown)")));
+	for( const auto& line : lines ) {
+		const auto hours = line.rfind(", ");
+
+		if( line.find(" left", hours) != string::npos && line.find("unknown", hours) == string::npos )
+			CHECK(stoull(line.substr(hours + 2)) <= 1000);
+	}
+}
+
+/**
+ *	@brief The status line is redrawn in place, padded over a longer
+ *		   previous line, and ends with a newline when finished.
+ */
+void testStatusLine() {
+	BatchStats stats;
+	ostringstream output;
+
+	stats.begin();
+	stats.fileQueued(123456789);
+	{
+		ProgressReport report(output, stats, ProgressStyle::StatusLine, chrono::milliseconds(1));
+
+		this_thread::sleep_for(chrono::milliseconds(20));
+		stats.enumerationFinished();
+		report.finish();
+	}
+
+	const auto text = output.str();
+
+	CHECK(text.size() > 2 && text.front() == '\r' && text.back() == '\n');
+	CHECK(text.find('\n') == text.size() - 1);
+
+	// Every redraw is at least as wide as the one before
+	size_t width = 0;
+	bool covered = true;
+	string drawn;
+
+	for( const char ch : text ) {
+		if( ch != '\r' && ch != '\n' ) {
+			drawn += ch;
+			continue;
+		}
+		if( drawn.empty() )
+			continue;
+		covered = covered && drawn.size() >= width;
+		width = drawn.size();
+		drawn.clear();
+	}
+	CHECK(covered);
+	CHECK(text.find("0/1 files, 0.0 MB / 123.5 MB, 0.0 MB/s (0 files/s)") != string::npos);
+}
+
+int main() {
+	testStyle();
+	testFinal();
+	testTimeLeft();
+	testStall();
+	testStatusLine();
+	return finish("progress");
+}
@@ -0,0 +1,116 @@
+/**
+ *	@file relativepath.cpp
+ *	@brief Tests of the lexical getRelativePath().
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <string>
+#include <utility>
+
+#include "check.h"
+#include "codec.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+/**
+ *	@brief Checks one case, printing the paths when it fails.
+ */
+void checkRelative(const fs::path& path, const fs::path& directory, const fs::path& expected) {
+	const auto relativePath = getRelativePath(path, directory);
+
+	if( !CHECK(relativePath == expected) )
+		cerr << "  getRelativePath(" << path << ", " << directory << ") gave " << relativePath << ", expected " << expected << '\n';
+}
+
+/**
+ *	@brief Spellings of the same relative paths all give the same result.
+ */
+void testRelativeSpellings() {
+	checkRelative("in/a/b.wav", "in", "a/b.wav");
+	checkRelative("in/a/b.wav", "in/", "a/b.wav");
+	checkRelative("./in/a/b.wav", "in", "a/b.wav");
+	checkRelative("in/a/b.wav", "./in/.", "a/b.wav");
+	checkRelative("in//a///b.wav", "in", "a/b.wav");
+	checkRelative("in/x/../a/b.wav", "in", "a/b.wav");
+	checkRelative("in/a.wav", "in", "a.wav");
+	checkRelative("in", "in", ".");
+}
+
+/**
+ *	@brief Absolute paths, and a mix of absolute and relative ones, which
+ *		   is the one case that consults the current directory.
+ */
+void testAbsoluteAndMixed() {
+	checkRelative("/data/in/a/b.wav", "/data/in", "a/b.wav");
+	checkRelative("/data/in/a/b.wav", "/data/in/", "a/b.wav");
+	checkRelative("/data/./in/../in/a.wav", "/data/in", "a.wav");
+
+	const auto current = fs::current_path();
+
+	checkRelative(current / "in" / "a.wav", "in", "a.wav");
+	checkRelative("in/a.wav", current / "in", "a.wav");
+}
+
+/**
+ *	@brief Paths outside the directory climb out of it, as
+ *		   std::filesystem::relative() does.
+ */
+void testOutside() {
+	checkRelative("other/a.wav", "in", "../other/a.wav");
+	checkRelative("/data/other/a.wav", "/data/in", "../other/a.wav");
+	checkRelative("in2/a.wav", "in", "../in2/a.wav");
+}
+
+/**
+ *	@brief On an existing tree without symbolic links, the result matches
+ *		   std::filesystem::relative(), which the lexical version replaced.
+ */
+void testMatchesFilesystem() {
+	TemporaryDirectory directory;
+	const auto root = directory.path();
+
+	writeFile(root / "in" / "a" / "b.wav", "");
+	writeFile(root / "in" / "c.wav", "");
+	writeFile(root / "other" / "d.wav", "");
+
+	const pair<fs::path, fs::path> cases[] = {
+		{ root / "in" / "a" / "b.wav", root / "in" },
+		{ root / "in" / "c.wav", root / "in" / "" },
+		{ root / "in" / "a" / ".." / "c.wav", root / "in" },
+		{ root / "other" / "d.wav", root / "in" },
+		{ root / "in" / "a" / "b.wav", root / "in" / "a" },
+	};
+
+	for( const auto& [path, base] : cases )
+		checkRelative(path, base, fs::relative(path, base));
+}
+
+int main() {
+	testRelativeSpellings();
+	testAbsoluteAndMixed();
+	testOutside();
+	testMatchesFilesystem();
+	return finish("relativepath");
+}
@@ -0,0 +1,162 @@
+/**
+ *	@file results.cpp
+ *	@brief Tests of the results and baselines of the throughput benchmark.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "results.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief Makes a result of a given throughput in files per second.
+	 */
+	BenchmarkResult resultOf(const string& name, size_t files, double seconds) {
+		BenchmarkResult result;
+
+		result.name = name;
+		result.files = files;
+		result.bytes = files * 1000;
+		result.seconds = seconds;
+		return result;
+	}
+}
+
+/**
+ *	@brief Written results read back as a baseline of files per second,
+ *		   one case per line, leaving the stream's formatting alone.
+ */
+void testRoundTrip() {
+	TemporaryDirectory directory;
+	const auto path = directory.path() / "results.json";
+	const vector<BenchmarkResult> results = { resultOf("encode/small/Block", 1000, 0.5), resultOf("list/mixed", 3, 0.25),
+		resultOf("idle", 0, 0) };
+	ostringstream output;
+
+	output.precision(2);
+	writeResults(results, output);
+	CHECK(output.precision() == 2);
+	CHECK(!(output.flags() & ios::fixed));
+
+	const auto text = output.str();
+
+	CHECK(text.rfind("{\n  \"schema\": 1,\n  \"results\": [\n", 0) == 0);
+	CHECK(text.find("    {\"name\": \"list/mixed\", \"files\": 3, \"bytes\": 3000, \"seconds\": 0.250000, "
+		"\"mb_per_s\": 0.012, \"files_per_s\": 12.000, \"errors\": 0},\n") != string::npos);
+	CHECK(text.find("\"errors\": 0}\n  ]\n}\n") != string::npos);
+
+	writeFile(path, text);
+
+	const auto baseline = readBaseline(path);
+
+	CHECK(baseline.size() == 3);
+	CHECK(baseline.count("encode/small/Block") && baseline.at("encode/small/Block") == 2000);
+	CHECK(baseline.count("list/mixed") && baseline.at("list/mixed") == 12);
+	CHECK(baseline.count("idle") && baseline.at("idle") == 0);
+}
+
+/**
+ *	@brief Lines that are not cases, or are cut short, are skipped, and a
+ *		   missing file throws the open error.
+ */
+void testMalformedBaseline() {
+	TemporaryDirectory directory;
+	const auto path = directory.path() / "baseline.json";
+
+	writeFile(path,
+		"{\"name\": \"good\", \"files_per_s\": 10.5}\n"
+		"{\"name\": \"no rate\"}\n"
+		"{\"files_per_s\": 3}\n"
+		"{\"name\": \"unterminated, \"files_per_s\": x}\n"
+		"{\"name\": \"bad rate\", \"files_per_s\": fast}\n"
+		"\n");
+
+	const auto baseline = readBaseline(path);
+
+	CHECK(baseline.size() == 1);
+	CHECK(baseline.count("good") && baseline.at("good") == 10.5);
+
+	const auto missing = directory.path() / "missing.json";
+	string message;
+
+	try {
+		readBaseline(missing);
+	}
+	catch( const runtime_error& ex ) {
+		message = ex.what();
+	}
+	CHECK(message == openErrorMsg(missing));
+}
+
+/**
+ *	@brief Only a slowdown beyond the threshold is a regression, and cases
+ *		   without a usable baseline are left out.
+ */
+void testCompare() {
+	const vector<BenchmarkResult> results = {
+		resultOf("faster", 120, 1),
+		resultOf("within", 91, 1),
+		resultOf("boundary", 90, 1),
+		resultOf("slower", 80, 1),
+		resultOf("new", 10, 1),
+		resultOf("unmeasured", 10, 1),
+	};
+	const map<string, double> baseline = { { "faster", 100 }, { "within", 100 }, { "boundary", 100 }, { "slower", 100 },
+		{ "unmeasured", 0 } };
+	ostringstream log;
+
+	CHECK(compareResults(results, baseline, 10, log) == 1);
+
+	const auto text = log.str();
+
+	CHECK(text.find("Compared with baseline (threshold 10.0%):\n") != string::npos);
+	CHECK(text.find("+20.0%\n") != string::npos);
+	CHECK(text.find("-10.0%\n") != string::npos);
+	CHECK(text.find("-20.0%  REGRESSION\n") != string::npos);
+	CHECK(text.find("new") == string::npos);
+	CHECK(text.find("unmeasured") == string::npos);
+	CHECK(text.find("1 regression\n") != string::npos);
+	CHECK(!(log.flags() & (ios::fixed | ios::showpos | ios::left)));
+
+	ostringstream strict;
+
+	CHECK(compareResults(results, baseline, 0, strict) == 3);
+	CHECK(strict.str().find("3 regressions\n") != string::npos);
+}
+
+int main() {
+	testRoundTrip();
+	testMalformedBaseline();
+	testCompare();
+	return finish("results");
+}
@@ -0,0 +1,121 @@
+/**
+ *	@file syscalls.cpp
+ *	@brief Tests of counting the system calls of the metadata benchmark.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+
+#include "check.h"
+#include "syscalls.h"
+
+#ifdef SITHCODEC_LINUX
+#include <csignal>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+#ifdef SITHCODEC_LINUX
+	/**
+	 *	@brief Makes system calls that no library caches.
+	 */
+	void makeCalls(int count) {
+		for( int i = 0; i < count; ++i )
+			::syscall(SYS_getppid);
+	}
+
+	volatile sig_atomic_t signalled = 0;
+#endif
+}
+
+#ifdef SITHCODEC_LINUX
+/**
+ *	@brief The calls of the function are counted, with those of threads
+ *		   it starts, and little else.
+ */
+void testCounts() {
+	const auto idle = countSyscalls([] {});
+
+	if( !idle ) {
+		cerr << "syscalls: tracing not permitted, skipped\n";
+		return;
+	}
+
+	const auto some = countSyscalls([] { makeCalls(1000); });
+
+	CHECK(some && some.value() >= idle.value() + 1000 && some.value() <= idle.value() + 1010);
+
+	const auto threaded = countSyscalls([] {
+		thread other([] { makeCalls(500); });
+
+		other.join();
+	});
+
+	CHECK(threaded && threaded.value() >= idle.value() + 500);
+
+	// A signal the function handles is passed on rather than swallowed
+	const auto handled = countSyscalls([] {
+		::signal(SIGUSR1, [](int) { signalled = 1; });
+		::raise(SIGUSR1);
+		if( !signalled )
+			throw runtime_error("signal lost");
+	});
+
+	CHECK(handled.has_value());
+}
+
+/**
+ *	@brief A function that fails gives no count, and the caller's state
+ *		   is left alone.
+ */
+void testFailures() {
+	if( !countSyscalls([] {}) )
+		return;
+
+	CHECK(!countSyscalls([] { throw runtime_error("failed"); }));
+	CHECK(!countSyscalls([] { ::_exit(3); }));
+	CHECK(!countSyscalls([] { ::raise(SIGKILL); }));
+
+	int value = 1;
+
+	CHECK(countSyscalls([&value] { value = 2; }));
+	CHECK(value == 1);
+}
+#endif
+
+int main() {
+#ifdef SITHCODEC_LINUX
+	testCounts();
+	testFailures();
+#else
+	CHECK(!countSyscalls([] {}));
+#endif
+	return finish("syscalls");
+}
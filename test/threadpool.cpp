@@ -0,0 +1,166 @@
+/**
+ *	@file threadpool.cpp
+ *	@brief Tests of the work-stealing ThreadPool and of the order of
+ *		   parallel batch results.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "codec.h"
+#include "threadpool.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+/**
+ *	@brief Every task runs exactly once, including tasks submitted from
+ *		   inside other tasks.
+ */
+void testRunsEveryTask() {
+	ThreadPool pool(4);
+	atomic<int> count{ 0 };
+
+	CHECK(pool.size() == 4);
+
+	for( int i = 0; i < 100; ++i ) {
+		pool.submit([&] {
+			++count;
+			for( int j = 0; j < 10; ++j )
+				pool.submit([&] { ++count; });
+		});
+	}
+	pool.wait();
+
+	CHECK(count == 1100);
+}
+
+/**
+ *	@brief wait() rethrows the first exception that escaped a task, once,
+ *		   and the pool stays usable.
+ */
+void testRethrowsTaskError() {
+	ThreadPool pool(2);
+	bool thrown = false;
+
+	pool.submit([] { throw runtime_error("task failed"); });
+	try {
+		pool.wait();
+	}
+	catch( const runtime_error& ex ) {
+		thrown = string(ex.what()) == "task failed";
+	}
+	CHECK(thrown);
+
+	atomic<int> count{ 0 };
+
+	pool.submit([&] { ++count; });
+	pool.wait();
+	CHECK(count == 1);
+}
+
+/**
+ *	@brief parallelFor visits each index once, inline or on a pool.
+ */
+void testParallelFor() {
+	for( const unsigned workers : { 1u, 3u } ) {
+		vector<atomic<int>> visits(1000);
+
+		parallelFor(visits.size(), workers, [&](size_t i) { ++visits[i]; });
+
+		bool once = true;
+
+		for( const auto& visit : visits )
+			once = once && visit == 1;
+		CHECK(once);
+	}
+
+	parallelFor(0, 2, [](size_t) { CHECK(false); });
+}
+
+/**
+ *	@brief A parallel batch returns its files in the order loadOperations
+ *		   gives them, whatever order they finish in.
+ */
+void testBatchOrder() {
+	TemporaryDirectory directory;
+	const auto input = directory.path() / "in";
+
+	for( int i = 0; i < 200; ++i )
+		writeFile(input / ("d" + to_string(i % 7)) / ("f" + to_string(i) + ".wav"), string(static_cast<size_t>(i * 37 % 4096), 'x'));
+
+	const auto expected = loadOperations(input);
+	BatchOptions options;
+
+	options.jobs = 8;
+
+	const auto results = encodeAll(input, AudioFormat::SFX, directory.path() / "out", options);
+
+	if( !CHECK(results.size() == expected.size()) )
+		return;
+	for( size_t i = 0; i < results.size(); ++i ) {
+		CHECK(results.path(i) == expected.path(i));
+		CHECK(results.status(i) == FileStatus::Done);
+	}
+}
+
+/**
+ *	@brief Random strings drawn from several threads at once stay distinct.
+ */
+void testRandomStringsAcrossThreads() {
+	mutex guard;
+	set<string> strings;
+	vector<thread> threads;
+
+	for( int t = 0; t < 4; ++t ) {
+		threads.emplace_back([&] {
+			for( int i = 0; i < 250; ++i ) {
+				auto str = getRandomString("abcdefghijklmnopqrstuvwxyz", 16);
+				lock_guard lock(guard);
+
+				strings.insert(move(str));
+			}
+		});
+	}
+	for( auto& thread : threads )
+		thread.join();
+
+	CHECK(strings.size() == 1000);
+}
+
+int main() {
+	testRunsEveryTask();
+	testRethrowsTaskError();
+	testParallelFor();
+	testBatchOrder();
+	testRandomStringsAcrossThreads();
+	return finish("threadpool");
+}
@@ -0,0 +1,201 @@
+/**
+ *	@file trace.cpp
+ *	@brief Tests of the Chrome trace output.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "trace.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief Writes the trace into a string.
+	 */
+	string traceText() {
+		ostringstream output;
+
+		writeTrace(output);
+		return output.str();
+	}
+
+	/**
+	 *	@brief Counts the occurrences of a piece of text.
+	 */
+	size_t count(const string& text, const string& piece) {
+		size_t found = 0;
+
+		for( size_t pos = 0; (pos = text.find(piece, pos)) != string::npos; pos += piece.size() )
+			++found;
+		return found;
+	}
+
+	/**
+	 *	@brief Determines whether brackets balance and every string closes,
+	 *		   which is as much of the JSON grammar as the writer can get wrong.
+	 */
+	bool balanced(const string& text) {
+		vector<char> open;
+		bool inString = false;
+
+		for( size_t i = 0; i < text.size(); ++i ) {
+			const char ch = text[i];
+
+			if( inString ) {
+				if( ch == '\\' )
+					++i;
+				else if( ch == '"' )
+					inString = false;
+				else if( static_cast<unsigned char>(ch) < 0x20 )
+					return false;
+				continue;
+			}
+
+			if( ch == '"' )
+				inString = true;
+			else if( ch == '{' || ch == '[' )
+				open.push_back(ch == '{' ? '}' : ']');
+			else if( ch == '}' || ch == ']' ) {
+				if( open.empty() || open.back() != ch )
+					return false;
+				open.pop_back();
+			}
+		}
+		return !inString && open.empty();
+	}
+}
+
+/**
+ *	@brief Spans appear with their names, escaped files and thread names,
+ *		   and those of other threads under their own thread.
+ */
+void testSpans() {
+	startTrace();
+	CHECK(isTracing());
+	{
+		TraceSpan span("outer");
+		const fs::path path = "dir/\"quoted\"\\\tname.wav";
+		TraceSpan file("read", path);
+	}
+
+	thread other([] { TraceSpan span("worker"); });
+
+	other.join();
+
+	const auto text = traceText();
+
+	CHECK(!isTracing());
+	CHECK(text.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", 0) == 0);
+	CHECK(text.size() >= 4 && text.compare(text.size() - 4, 4, "\n]}\n") == 0);
+	CHECK(balanced(text));
+	CHECK(count(text, "\"ph\":\"X\"") == 3);
+	CHECK(count(text, "\"name\":\"outer\"") == 1);
+	CHECK(count(text, "\"name\":\"worker\"") == 1);
+	CHECK(count(text, "\"args\":{\"file\":\"dir/\\\"quoted\\\"\\\\\\u0009name.wav\"}") == 1);
+	CHECK(count(text, "\"ph\":\"M\"") == 2);
+	CHECK(count(text, "\"args\":{\"name\":\"main\"}") == 1);
+	CHECK(count(text, "\"args\":{\"name\":\"thread ") == 1);
+
+	// The worker's span is on a thread of its own
+	const auto outer = text.find("\"name\":\"outer\"");
+	const auto worker = text.find("\"name\":\"worker\"");
+	const auto tidOf = [&](size_t pos) {
+		const auto tid = text.find("\"tid\":", pos) + 6;
+
+		return text.substr(tid, text.find(',', tid) - tid);
+	};
+
+	CHECK(outer != string::npos && worker != string::npos && tidOf(outer) != tidOf(worker));
+}
+
+/**
+ *	@brief Asynchronous spans are written as begin and end events sharing
+ *		   an id, in the order they were recorded.
+ */
+void testAsyncSpans() {
+	startTrace();
+
+	const auto start = traceClock();
+
+	recordAsyncSpan("submit", "a.wav", start, start + 1500);
+	recordAsyncSpan("submit", "b.wav", start + 10, start + 20);
+
+	const auto text = traceText();
+
+	CHECK(balanced(text));
+	CHECK(count(text, "\"ph\":\"b\",\"id\":1,") == 1);
+	CHECK(count(text, "\"ph\":\"e\",\"id\":1,") == 1);
+	CHECK(count(text, "\"ph\":\"b\",\"id\":2,") == 1);
+	CHECK(count(text, "\"ph\":\"e\",\"id\":2,") == 1);
+	CHECK(count(text, "\"cat\":\"file\"") == 4);
+	CHECK(text.find("\"file\":\"a.wav\"") < text.find("\"file\":\"b.wav\""));
+	CHECK(text.find("\"ph\":\"b\",\"id\":1,") < text.find("\"ph\":\"e\",\"id\":1,"));
+}
+
+/**
+ *	@brief Nothing is kept once the trace is written, and starting again
+ *		   drops what an earlier trace recorded.
+ */
+void testGenerations() {
+	startTrace();
+	traceText();
+	CHECK(!isTracing());
+	{
+		TraceSpan span("late");
+	}
+	recordAsyncSpan("late", "late.wav", traceClock(), traceClock());
+
+	const auto empty = traceText();
+
+	CHECK(empty == "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n]}\n");
+
+	// Spans of a trace that was never written are dropped by the next one
+	startTrace();
+	{
+		TraceSpan span("abandoned");
+	}
+	startTrace();
+	{
+		TraceSpan span("kept");
+	}
+
+	const auto text = traceText();
+
+	CHECK(count(text, "abandoned") == 0);
+	CHECK(count(text, "\"name\":\"kept\"") == 1);
+}
+
+int main() {
+	testSpans();
+	testAsyncSpans();
+	testGenerations();
+	return finish("trace");
+}
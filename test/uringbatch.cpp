@@ -0,0 +1,140 @@
+/**
+ *	@file uringbatch.cpp
+ *	@brief Tests of the io_uring batch engine against the synchronous one.
+ *
+ *	@copyright GNU General Public License
+ *	@parblock
+ *		Copyright (C) 2022 Brendan Brassil
+ *
+ *		This file is part of %SithCodec.
+ *
+ *		%SithCodec is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		%SithCodec is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with %SithCodec. If not, see <https://www.gnu.org/licenses/>.
+ *	@endparblock
+ */
+
+#include <map>
+#include <string>
+
+#include "check.h"
+#include "codec.h"
+#include "uringbatch.h"
+
+namespace fs = std::filesystem;
+using namespace std;
+using namespace SithCodec;
+using namespace SithCodec::Test;
+
+namespace {
+	/**
+	 *	@brief Reads every file below a directory, keyed by relative path.
+	 */
+	map<string, string> readTree(const fs::path& root) {
+		map<string, string> files;
+
+		for( const auto& entry : fs::recursive_directory_iterator(root) ) {
+			if( entry.is_regular_file() )
+				files[entry.path().lexically_relative(root).generic_string()] = readFile(entry.path());
+		}
+		return files;
+	}
+
+	/**
+	 *	@brief Writes a tree with the shapes the engines must treat alike:
+	 *		   both headers, no header, a header cut short, an empty file,
+	 *		   and payloads spanning several io_uring chunks.
+	 */
+	void writeInputs(const fs::path& root) {
+		const auto sfx = headerOf(AudioFormat::SFX);
+		const auto vo = headerOf(AudioFormat::VO);
+
+		writeFile(root / "sfx.wav", sfx + "sfx payload");
+		writeFile(root / "vo.wav", vo + "vo payload");
+		writeFile(root / "plain.wav", "RIFF plain payload");
+		writeFile(root / "short.wav", sfx.substr(0, sfx.size() / 2));
+		writeFile(root / "empty.wav", "");
+		writeFile(root / "d" / "large.wav", sfx + string(uringChunkSize * 2 + 123, 'L'));
+		writeFile(root / "d" / "chunk.wav", string(uringChunkSize, 'C'));
+		for( int i = 0; i < 20; ++i )
+			writeFile(root / "d" / "e" / ("f" + to_string(i) + ".wav"), string(static_cast<size_t>(i * 97), static_cast<char>('a' + i)));
+	}
+}
+
+/**
+ *	@brief Encoding and decoding with io_uring writes the same outputs and
+ *		   statuses as the block engine, even with fewer slots than files.
+ */
+void testMatchesBlockEngine() {
+	TemporaryDirectory directory;
+	const auto input = directory.path() / "in";
+
+	writeInputs(input);
+
+	BatchOptions block, uring;
+
+	block.engine = IoEngine::Block;
+	uring.engine = IoEngine::Uring;
+	uring.queueDepth = 2;
+
+	for( const bool encoding : { true, false } ) {
+		const auto name = string(encoding ? "encode" : "decode");
+		const auto blockOutput = directory.path() / (name + "-block");
+		const auto uringOutput = directory.path() / (name + "-uring");
+		const auto blockResults = encoding ? encodeAll(input, AudioFormat::VO, blockOutput, block) : decodeAll(input, blockOutput, block);
+		const auto uringResults = encoding ? encodeAll(input, AudioFormat::VO, uringOutput, uring) : decodeAll(input, uringOutput, uring);
+
+		CHECK(blockResults.count(FileStatus::Done) == blockResults.size());
+		CHECK(uringResults.count(FileStatus::Done) == uringResults.size());
+		if( !CHECK(readTree(uringOutput) == readTree(blockOutput)) )
+			cerr << "  " << name << " outputs differ\n";
+		CHECK(readTree(uringOutput).size() == blockResults.size());
+	}
+}
+
+/**
+ *	@brief A failing output fails only its own file, and leaves no staging
+ *		   file behind.
+ */
+void testFailureIsPerFile() {
+	TemporaryDirectory directory;
+	const auto input = directory.path() / "in";
+	const auto output = directory.path() / "out";
+
+	writeFile(input / "a.wav", "a");
+	writeFile(input / "b.wav", "b");
+	// A directory where the output of a.wav should go cannot be replaced
+	fs::create_directories(output / "a.wav");
+
+	BatchOptions options;
+
+	options.engine = IoEngine::Uring;
+
+	const auto results = encodeAll(input, AudioFormat::SFX, output, options);
+
+	CHECK(results.count(FileStatus::Done) == 1);
+	CHECK(results.count(FileStatus::Failed) == 1);
+	for( size_t i = 0; i < results.size(); ++i ) {
+		if( results.status(i) == FileStatus::Failed )
+			CHECK(results.error(i).code == CodecErrc::Write);
+	}
+	for( const auto& entry : fs::directory_iterator(output) )
+		CHECK(entry.path().extension() != ".tmp");
+}
+
+int main() {
+#ifdef SITHCODEC_URING
+	testMatchesBlockEngine();
+	testFailureIsPerFile();
+#endif
+	return finish("uringbatch");
+}